@@ -2,6 +2,7 @@
 #include "Vertex.h"
 #include <glad/glad.h>
 
+// vertices and indices point into the Arena the shape was generated in, see ShapeGenerator
 struct ShapeData
 {
 	ShapeData() :
@@ -19,10 +20,4 @@ struct ShapeData
 	{
 		return numIndices * sizeof(GLushort);
 	}
-	void cleanup()
-	{
-		delete[] vertices;
-		delete[] indices;
-		numVertices = numIndices = 0;
-	}
 };
\ No newline at end of file
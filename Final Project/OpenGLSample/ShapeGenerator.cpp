@@ -19,12 +19,12 @@ glm::vec3 randomColor()
 }
 
 
-ShapeData ShapeGenerator::makePlaneVerts(uint dimensions)
+ShapeData ShapeGenerator::makePlaneVerts(Arena& arena, uint dimensions)
 {
 	ShapeData ret;
 	ret.numVertices = dimensions * dimensions;
 	int half = dimensions / 2;
-	ret.vertices = new Vertex[ret.numVertices];
+	ret.vertices = arena.allocateArray<Vertex>(ret.numVertices);
 	for (int i = 0; i < dimensions; i++)
 	{
 		for (int j = 0; j < dimensions; j++)
@@ -40,11 +40,11 @@ ShapeData ShapeGenerator::makePlaneVerts(uint dimensions)
 	return ret;
 }
 
-ShapeData ShapeGenerator::makePlaneIndices(uint dimensions)
+ShapeData ShapeGenerator::makePlaneIndices(Arena& arena, uint dimensions)
 {
 	ShapeData ret;
 	ret.numIndices = (dimensions - 1) * (dimensions - 1) * 2 * 3; // 2 triangles per square, 3 indices per triangle
-	ret.indices = new unsigned short[ret.numIndices];
+	ret.indices = arena.allocateArray<unsigned short>(ret.numIndices);
 	int runner = 0;
 	for (int row = 0; row < dimensions - 1; row++)
 	{
@@ -64,19 +64,19 @@ ShapeData ShapeGenerator::makePlaneIndices(uint dimensions)
 }
 
 
-ShapeData ShapeGenerator::makePlane(uint dimensions)
+ShapeData ShapeGenerator::makePlane(Arena& arena, uint dimensions)
 {
-	ShapeData ret = makePlaneVerts(dimensions);
-	ShapeData ret2 = makePlaneIndices(dimensions);
+	ShapeData ret = makePlaneVerts(arena, dimensions);
+	ShapeData ret2 = makePlaneIndices(arena, dimensions);
 	ret.numIndices = ret2.numIndices;
 	ret.indices = ret2.indices;
 	return ret;
 }
 
-ShapeData ShapeGenerator::makeSphere(uint tesselation)
+ShapeData ShapeGenerator::makeSphere(Arena& arena, uint tesselation)
 {
-	ShapeData ret = makePlaneVerts(tesselation);
-	ShapeData ret2 = makePlaneIndices(tesselation);
+	ShapeData ret = makePlaneVerts(arena, tesselation);
+	ShapeData ret2 = makePlaneIndices(arena, tesselation);
 	ret.indices = ret2.indices;
 	ret.numIndices = ret2.numIndices;
 
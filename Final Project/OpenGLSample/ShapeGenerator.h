@@ -1,16 +1,18 @@
 #pragma once
 #include "ShapeData.h"
+#include "arena.h"
 typedef unsigned int uint;
 
 class ShapeGenerator
 {
-	static ShapeData makePlaneVerts(uint dimensions);
-	static ShapeData makePlaneIndices(uint dimensions);
+	static ShapeData makePlaneVerts(Arena& arena, uint dimensions);
+	static ShapeData makePlaneIndices(Arena& arena, uint dimensions);
 
 	
 public:
 
-	static ShapeData makePlane(uint dimensions = 10);
-	static ShapeData makeSphere(uint tesselation = 20);
+	// the arrays are allocated from the arena, they live until it is rewound
+	static ShapeData makePlane(Arena& arena, uint dimensions = 10);
+	static ShapeData makeSphere(Arena& arena, uint tesselation = 20);
 	
 };
@@ -12,12 +12,44 @@
 #include <vector>
 
 #include "shader.h"
+#include "shaderReloader.h"
+#include "shaderPermutations.h"
+#include "lighting.h"
+#include "lightClusters.h"
+#include "deferredShading.h"
+#include "depthPrepass.h"
+#include "gpuTimers.h"
+#include "meshDraw.h"
+#include "transformTable.h"
+#include "frustumCulling.h"
+#include "bvh.h"
+#include "softwareOcclusion.h"
+#include "occlusionQueries.h"
 #include "camera.h"
 
 #include "cylinder.h"
+#include "textureStreamer.h"
+#include "ktx2Loader.h"
+#include "mipGenerator.h"
+#include "renderLayers.h"
+#include "drawOrder.h"
+#include "drawList.h"
+#include "sceneFile.h"
+#include "jobSystem.h"
+#include "arena.h"
+#include "vertextBufferObject.h"
+#include "resourceTracker.h"
+#include "framePacer.h"
+#include "cameraBlock.h"
 
 
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
 
 
 
@@ -34,6 +66,7 @@ struct GLShape
 	GLuint vao;
 	GLuint vbo;
 	GLuint Vertices;
+	LocalBounds bounds; // local space, computed when the mesh is built
 };
 
 struct GLTorus
@@ -42,6 +75,7 @@ struct GLTorus
 	GLuint vbo;
 	GLuint uvbo;
 	GLuint Vertices;
+	LocalBounds bounds; // local space, computed when the mesh is built
 };
 
 void CreateRectangle(GLShape& shape);
@@ -49,32 +83,30 @@ void CreateCubeNoTop(GLShape& shape);
 void CreatePyramid(GLShape& shape);
 void CreateOpenPyramid(GLShape& shape);
 void CreateTorus(GLTorus& torus);
+LocalBounds CylinderBounds(const static_meshes_3D::Cylinder& cylinder);
+MeshDraw CylinderMesh(const static_meshes_3D::Cylinder& cylinder);
+MeshDraw CreateShapeDataMesh(const ShapeData& data, GLShape& shape);
+
+// the meshes of a scene and the GL objects behind them, deleted together
+struct SceneMeshes
+{
+	std::vector<MeshDraw> draws; // per scene mesh
+	std::vector<LocalBounds> bounds; // per scene mesh, local space
+	std::vector<GLuint> vertexArrays;
+	std::vector<GLuint> buffers;
+	std::vector<std::unique_ptr<static_meshes_3D::Cylinder>> cylinders;
+};
+void CreateSceneMeshes(const Scene& scene, SceneMeshes& meshes);
+void DeleteSceneMeshes(SceneMeshes& meshes);
 
 void setCoords(double r, double c, int rSeg, int cSeg, int i, int j, GLfloat* vertices, GLfloat* uv);
-int createObject(double r, double c, int rSeg, int cSeg, GLfloat** vertices, GLfloat** uv);
+int createObject(double r, double c, int rSeg, int cSeg, Arena& arena, GLfloat** vertices, GLfloat** uv);
 
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
-
-// Shapes
-GLShape gCenterCube;
-GLShape gLeftCube;
-GLShape gRightCube;
-GLShape gRectangle;
-GLShape gPlane;
-GLShape gBottomPyramid;
-GLShape gTopOpenPyramid;
-GLTorus gTorus;
-
-// plane
-GLuint planeNumIndices;
-GLuint planeIndexByteOffset;
-
-// sphere
-GLuint sphereNumIndices;
-GLuint sphereIndexByteOffset;
+const size_t TEXTURE_UPLOAD_BUDGET_BYTES = 4 * 1024 * 1024; // per frame, for streamed mip levels
 
 // camera
 Camera camera(glm::vec3(1.5f, 3.0f, 6.0f));
@@ -94,11 +126,105 @@ const uint NUM_VERTICES_PER_TRI = 3;
 const uint NUM_FLOATS_PER_VERTICE = 9;
 const uint VERTEX_BYTE_SIZE = NUM_FLOATS_PER_VERTICE * sizeof(float);
 
+// from this many objects frustum culling walks the BVH instead of testing every object
+const size_t BVH_CULLING_MIN_OBJECTS = 1024;
+// meshes drawing at least this many vertices are tested with GPU occlusion queries (--gpu-occlusion), a box is 36
+const GLsizei GPU_OCCLUSION_MIN_VERTICES = 20000;
+
 // projection matrix
 glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 
-int main()
+int main(int argc, char* argv[])
 {
+	// the thread that starts the job system is the one its main thread jobs (GL work) run on
+	JobSystem& jobSystem = JobSystem::instance();
+
+	// command line tools
+	// ------------------
+	// --bake <image> <out.dds> [--linear] : bakes a mip chain for TextureStreamer and exits
+	// --bake-scene <in.scene> <out.scn>   : compiles a text scene to the binary form and exits
+	// --scene <file>                      : scene to show, text or compiled (scenes/desk.scene by default)
+	// --bench-mips <image>                : times CPU mip generation against glGenerateMipmap and exits
+	// --bench-bvh [max objects]           : times BVH build, refit, edits and queries from 10k objects up and exits
+	// --bench-jobs                        : checks nested waits and dependencies, times job scheduling and parallelFor scaling and exits (non-zero on failure)
+	// --test-vbo-growth                   : checks VBO data growing across arena blocks and exits (non-zero on failure)
+	// --lights <count>                    : scatters extra small point lights over the scene (clustered lighting)
+	// --deferred                          : renders with the deferred path instead of forward shading
+	// --depth-prepass                     : lays down depth first, forward shading then only runs for visible pixels
+	// --gpu-timers                        : prints the GPU time of every render pass every few seconds
+	// --occlusion-culling                 : skips objects hidden behind the large occluders, tested on the CPU
+	// --gpu-occlusion                     : tests the expensive meshes with occlusion queries, drawn under conditional rendering
+	// --frames-in-flight <n>              : frames the CPU may queue ahead of the GPU (2 by default), fewer means less input latency
+	// --resource-report                   : prints the GL objects and CPU memory still held at exit (M prints it any time)
+	// --no-late-latch                     : writes the camera at the start of the frame rather than right before the draws
+	const char* benchMipsPath = nullptr;
+	int extraLightCount = 0;
+	bool deferredRendering = false;
+	bool depthPrepassEnabled = false;
+	bool gpuTimersEnabled = false;
+	bool occlusionCullingEnabled = false;
+	bool gpuOcclusionEnabled = false;
+	bool resourceReportEnabled = false;
+	bool lateLatch = true;
+	int maxFramesInFlight = 2;
+	const char* scenePath = "scenes/desk.scene";
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bake") == 0 && i + 2 < argc)
+		{
+			const bool linear = i + 3 < argc && strcmp(argv[i + 3], "--linear") == 0;
+			return bakeMipChain(argv[i + 1], argv[i + 2], !linear) ? 0 : -1;
+		}
+		if (strcmp(argv[i], "--bake-scene") == 0 && i + 2 < argc) {
+			return compileScene(argv[i + 1], argv[i + 2]) ? 0 : -1;
+		}
+		if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+			scenePath = argv[++i];
+		}
+		if (strcmp(argv[i], "--bench-bvh") == 0)
+		{
+			const long maxObjects = i + 1 < argc ? std::atol(argv[i + 1]) : 0;
+			benchmarkBvh(maxObjects > 0 ? (size_t)maxObjects : 1000000);
+			return 0;
+		}
+		if (strcmp(argv[i], "--bench-jobs") == 0) {
+			return benchmarkJobs() ? 0 : -1;
+		}
+		if (strcmp(argv[i], "--test-vbo-growth") == 0) {
+			return testRawDataGrowth() ? 0 : -1;
+		}
+		if (strcmp(argv[i], "--bench-mips") == 0 && i + 1 < argc) {
+			benchMipsPath = argv[++i];
+		}
+		if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+			extraLightCount = std::max(std::atoi(argv[++i]), 0);
+		}
+		if (strcmp(argv[i], "--deferred") == 0) {
+			deferredRendering = true;
+		}
+		if (strcmp(argv[i], "--depth-prepass") == 0) {
+			depthPrepassEnabled = true;
+		}
+		if (strcmp(argv[i], "--gpu-timers") == 0) {
+			gpuTimersEnabled = true;
+		}
+		if (strcmp(argv[i], "--occlusion-culling") == 0) {
+			occlusionCullingEnabled = true;
+		}
+		if (strcmp(argv[i], "--gpu-occlusion") == 0) {
+			gpuOcclusionEnabled = true;
+		}
+		if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+			maxFramesInFlight = std::max(std::atoi(argv[++i]), 1);
+		}
+		if (strcmp(argv[i], "--resource-report") == 0) {
+			resourceReportEnabled = true;
+		}
+		if (strcmp(argv[i], "--no-late-latch") == 0) {
+			lateLatch = false;
+		}
+	}
+
 	// glfw: initialize and configure
 	// ------------------------------
 	glfwInit();
@@ -135,215 +261,241 @@ int main()
 		return -1;
 	}
 
+	if (benchMipsPath != nullptr)
+	{
+		benchmarkMipGeneration(benchMipsPath, 10);
+		glfwTerminate();
+		return 0;
+	}
+
 	// configure global opengl state
 	// -----------------------------
 	glEnable(GL_DEPTH_TEST);
 
-	// build and compile our shader zprogram
-	// ------------------------------------
+	// the scene: which meshes, materials, objects and lights, from its file; the meshes are generated here
+	// ----------------------------------------------------------------------------------------------------
+	Scene scene;
+	if (!loadScene(scenePath, scene))
+	{
+		glfwTerminate();
+		return -1;
+	}
+	SceneMeshes sceneMeshes;
+	CreateSceneMeshes(scene, sceneMeshes);
+	std::cout << "Mesh arena: " << Arena::threadArena().highWater() / 1024 << " KB at most, " << Arena::threadArena().blockAllocations() << " heap blocks" << std::endl;
+
+	// load textures in the background, they are uploaded smallest mip first while we render
+	TextureStreamer textureStreamer;
+	std::vector<unsigned int> materialTextures;
+	for (const SceneMaterial& material : scene.materials) {
+		materialTextures.push_back(textureStreamer.load(material.texture));
+	}
 
-	Shader lightingShader("shaderfiles/6.multiple_lights.vs", "shaderfiles/6.multiple_lights.fs");
-	Shader lightCubeShader("shaderfiles/6.light_cube.vs", "shaderfiles/6.light_cube.fs");
-	Shader torusShader("shaderfiles/TransformVertexShader.vertexshader", "shaderfiles/TextureFragmentShader.fragmentshader");
+	// recompile shaders when their files change, without restarting or stalling the render loop
+	// ------------------------------------------------------------------------------------------
+	std::unique_ptr<ShaderReloader> shaderReloader(new ShaderReloader(window, "shaderfiles"));
 
-	// positions of the point lights
-	glm::vec3 pointLightPositions[] = {
-		glm::vec3(0.8f,  2.8f,  2.0f),
-		glm::vec3(0.0f, -5.0f, 2.0f),
-		glm::vec3(-4.2f,  0.0f, 2.0f),
-		glm::vec3(5.0f,  1.0f, 3.0f)
-	};
+	// object transforms, the scene is static so models, normal matrices and bounds are computed once
+	// -----------------------------------------------------------------------------------------------
+	TransformTable transforms;
+	for (const SceneObject& object : scene.objects) {
+		transforms.add(object.model, sceneMeshes.bounds[object.mesh]);
+	}
+	transforms.update();
 
-	// set up vertex data (and buffer(s)) and configure vertex attributes
-// ------------------------------------------------------------------
-	float cylinderVertices[] = {
-		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-		 0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f, 1.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-
-		-0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-		-0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-		-0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f, 1.0f,
-		 0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-		 0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-
-		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f
+	// spatial index over the objects, frustum culling goes through it once a flat test of every object costs more
+	std::vector<Aabb> objectBoxes;
+	for (size_t object = 0; object < transforms.size(); object++) {
+		objectBoxes.push_back({ transforms[object].boundsMin, transforms[object].boundsMax });
+	}
+	Bvh sceneBvh;
+	sceneBvh.build(objectBoxes);
+	std::vector<uint32_t> bvhVisible;
+
+	// what a frame draws. Each layer is drawn over the ones before it, in its own slice of the depth range
+	// ----------------------------------------------------------------------------------------------------
+	RenderLayers renderLayers;
+	for (const SceneLayer& layer : scene.layers) {
+		renderLayers.addLayer(layer.name, layer.depthShare);
+	}
+	struct SceneDraw
+	{
+		size_t object; // index into transforms
+		int layer; // from renderLayers
+		unsigned int texture;
+		MeshDraw mesh;
+		bool translucent = false; // blended, drawn after the opaque draws and kept out of the depth pre-pass
+		size_t depthMesh = ~(size_t)0; // the mesh in the depth pre-pass, none if it could not take it
+		size_t occlusionQuery = ~(size_t)0; // ID in occlusionQueries, expensive meshes only
 	};
+	// one per object, in the scene's order (grouped by layer, material and mesh)
+	std::vector<SceneDraw> sceneDraws;
+	for (size_t object = 0; object < scene.objects.size(); object++)
+	{
+		const SceneObject& sceneObject = scene.objects[object];
+		SceneDraw draw = { object, (int)sceneObject.layer, materialTextures[sceneObject.material], sceneMeshes.draws[sceneObject.mesh] };
+		draw.translucent = (scene.materials[sceneObject.material].flags & SCENE_TRANSLUCENT) != 0;
+		sceneDraws.push_back(draw);
+	}
+	DrawList drawList; // the frame's draws as packets, built across the worker threads
+	std::vector<char> objectVisible; // per object in transforms, from frustum culling
+
+	// lights of the scene
+	// -------------------
+	SceneLights sceneLights;
+	sceneLights.dirLight = scene.dirLight;
+	sceneLights.pointLights = scene.pointLights;
+	// the flashlight follows the camera
+	sceneLights.spotLight = scene.spotLight;
+	sceneLights.spotLight.position = camera.Position;
+	sceneLights.spotLight.direction = camera.Front;
+	sceneLights.spotLightOn = scene.hasSpotLight;
+
+	// small coloured lights, a short range each so that every cluster only sees a few of them
+	std::mt19937 lightRandom(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (int i = 0; i < extraLightCount; i++)
+	{
+		const glm::vec3 position(-6.0f + 12.0f * unit(lightRandom), -1.0f + 5.0f * unit(lightRandom), -3.0f + 8.0f * unit(lightRandom));
+		const glm::vec3 color(unit(lightRandom), unit(lightRandom), unit(lightRandom));
+		sceneLights.pointLights.push_back({ position, 1.0f, 0.7f, 20.0f, glm::vec3(0.0f), color * 0.4f, color * 0.2f });
+	}
 
-	unsigned int cylinderVBO, cylinderVAO;
-	//unsigned int VBO2, VAO2;
-
-	glGenVertexArrays(1, &cylinderVAO);
-	glGenBuffers(1, &cylinderVBO);
-	glBindVertexArray(cylinderVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, cylinderVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cylinderVertices), cylinderVertices, GL_STATIC_DRAW);
-
-
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	// texture coord attribute
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-	// cup handle cube's VAO and VBO
-	unsigned int cubeVBO, cubeVAO;
-
-	glGenVertexArrays(1, &cubeVAO);
-	glGenBuffers(1, &cubeVBO);
-
-	glBindVertexArray(cubeVAO);
-	// position attribute for cube
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	// texture attribute for cube
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	// normal attribute for cube
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-
-	// position attribute for cube
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	// texture attribute for cube
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	// normal attribute for cube
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	// lightCube's VAO and VBO
-	unsigned int lightCubeVAO;
-	glGenVertexArrays(1, &lightCubeVAO);
-	glBindVertexArray(lightCubeVAO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-	// note that we update the lamp's position attribute's stride to reflect the updated buffer data
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	// Create cubes
-	CreateCubeNoTop(gLeftCube);
-	CreateCubeNoTop(gRightCube);
-	CreateCubeNoTop(gCenterCube);
-	
-	// Create rectangle
-	CreateRectangle(gRectangle);
-
-	// Create pyramid - bottom of glass
-	CreatePyramid(gBottomPyramid);
-
-	// Create open pyramid - top of glass
-	CreateOpenPyramid(gTopOpenPyramid);
-
-	// Create torus
-	CreateTorus(gTorus);
-
-// creates plane object
-	ShapeData plane = ShapeGenerator::makePlane(30);
-
-	unsigned int planeVBO{}, planeVAO;
-	glGenVertexArrays(1, &planeVAO);
-	glGenBuffers(1, &planeVBO);
-
-	glBindVertexArray(planeVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-	glBufferData(GL_ARRAY_BUFFER, plane.vertexBufferSize() + plane.indexBufferSize(), 0, GL_STATIC_DRAW);
-
-	GLsizeiptr currentOffset = 0;
-
-	glBufferSubData(GL_ARRAY_BUFFER, currentOffset, plane.vertexBufferSize(), plane.vertices);
-	currentOffset += plane.vertexBufferSize();
-
-	planeIndexByteOffset = currentOffset;
-
-	glBufferSubData(GL_ARRAY_BUFFER, currentOffset, plane.indexBufferSize(), plane.indices);
+	// past what one draw can take in uniforms, point lights are binned into view space clusters every frame
+	// (the deferred lighting pass always reads them from the clusters)
+	const bool clusteredLighting = deferredRendering || sceneLights.pointLights.size() > MAX_POINT_LIGHTS_PER_DRAW;
+	std::unique_ptr<LightClusters> lightClusters;
+	if (clusteredLighting) {
+		lightClusters.reset(new LightClusters());
+	}
+	int framebufferWidth = SCR_WIDTH;
+	int framebufferHeight = SCR_HEIGHT;
+
+	// the lighting shader is specialised per object: only the lights that reach it are compiled in
+	// ---------------------------------------------------------------------------------------------
+	ShaderPermutations lightingPermutations("shaderfiles/6.multiple_lights.vs", "shaderfiles/6.multiple_lights.fs", lightingPermutationDefines(), RESOURCE_SITE, shaderReloader.get());
+	// the deferred path only forward shades translucent draws
+	const bool forwardDraws = !deferredRendering || std::any_of(sceneDraws.begin(), sceneDraws.end(), [](const SceneDraw& draw) { return draw.translucent; });
+	if (forwardDraws)
+	{
+		const uint32_t allPointLights = clusteredLighting ? LIGHTING_CLUSTERED : (uint32_t)sceneLights.pointLights.size();
+		lightingPermutations.precompile({ allPointLights, allPointLights | LIGHTING_SPOT_LIGHT });
+	}
+	std::unique_ptr<DeferredShading> deferredShading;
+	if (deferredRendering) {
+		deferredShading.reset(new DeferredShading(shaderReloader.get()));
+	}
 
-	planeNumIndices = plane.numIndices;
+	// the pre-pass draws the same meshes from their own position-only copy
+	std::unique_ptr<DepthPrepass> depthPrepass;
+	if (depthPrepassEnabled && deferredRendering) {
+		std::cout << "The depth pre-pass is for forward shading, the deferred path already shades each pixel once" << std::endl;
+	}
+	else if (depthPrepassEnabled)
+	{
+		depthPrepass.reset(new DepthPrepass(shaderReloader.get()));
+		for (SceneDraw& draw : sceneDraws) {
+			draw.depthMesh = depthPrepass->addMesh(draw.mesh);
+		}
+		depthPrepass->finish();
+	}
 
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)(sizeof(float) * 3));
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)(sizeof(float) * 6));
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, planeVBO);
-
-// creates sphere object
-	ShapeData sphere = ShapeGenerator::makeSphere();
-
-	unsigned int sphereVBO{}, sphereVAO;
-	glGenVertexArrays(1, &sphereVAO);
-	glGenBuffers(1, &sphereVBO);
-	glBindVertexArray(sphereVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
-	glBufferData(GL_ARRAY_BUFFER, sphere.vertexBufferSize() + sphere.indexBufferSize(), 0, GL_STATIC_DRAW);
-	currentOffset = 0;
-	glBufferSubData(GL_ARRAY_BUFFER, currentOffset, sphere.vertexBufferSize(), sphere.vertices);
-	currentOffset += sphere.vertexBufferSize();
-	sphereIndexByteOffset = currentOffset;
-	glBufferSubData(GL_ARRAY_BUFFER, currentOffset, sphere.indexBufferSize(), sphere.indices);
-	sphereNumIndices = sphere.numIndices;
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)(sizeof(float) * 3));
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)(sizeof(float) * 6));
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereVBO);
+	// the scene's occluders (the table, the block and the cubes) hide what is behind them, on the CPU;
+	// everything is compared in the depth slice of its layer, so the backdrop never hides the objects drawn over it
+	std::unique_ptr<SoftwareOcclusion> softwareOcclusion;
+	if (occlusionCullingEnabled)
+	{
+		softwareOcclusion.reset(new SoftwareOcclusion());
+		for (const SceneDraw& draw : sceneDraws)
+		{
+			double nearDepth = 0.0, farDepth = 1.0;
+			renderLayers.depthRange(draw.layer, nearDepth, farDepth);
+			softwareOcclusion->setDepthRange(draw.object, (float)nearDepth, (float)farDepth);
+			if (scene.objects[draw.object].flags & SCENE_OCCLUDER) {
+				softwareOcclusion->addOccluder(draw.mesh, draw.object);
+			}
+		}
+	}
 
-	// load textures using utility function
-	unsigned int marbleMap = loadTexture("images/marble.jpg");
-	unsigned int woodMap = loadTexture("images/new-wood.jpg");
-	unsigned int woodGrainMap = loadTexture("images/Wood-grain.jpg");
-	unsigned int greenSwirl = loadTexture("images/green_swirl.jpg");
-	unsigned int blackTextureMap = loadTexture("images/container2_specular.jpg");
+	// meshes that cost far more than a box (the torus) are tested with an occlusion query first and drawn conditionally
+	std::unique_ptr<OcclusionQueries> occlusionQueries;
+	if (gpuOcclusionEnabled)
+	{
+		occlusionQueries.reset(new OcclusionQueries(shaderReloader.get()));
+		for (SceneDraw& draw : sceneDraws)
+		{
+			const GLsizei vertexCount = meshVertexCount(draw.mesh);
+			if (vertexCount >= GPU_OCCLUSION_MIN_VERTICES) {
+				draw.occlusionQuery = occlusionQueries->add(vertexCount);
+			}
+		}
+	}
 
-	// tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
-	// -------------------------------------------------------------------------------------------
-	lightingShader.use();
-	lightingShader.setInt("material.diffuse", 0);
-	lightingShader.setInt("material.specular", 1);
+	// GPU time per pass
+	std::unique_ptr<GpuTimers> gpuTimers;
+	int prepassTimer = -1, shadingTimer = -1, lightingTimer = -1, translucentTimer = -1;
+	if (gpuTimersEnabled)
+	{
+		gpuTimers.reset(new GpuTimers());
+		// only the passes this run has, the others would report 0 ms
+		if (depthPrepass) {
+			prepassTimer = gpuTimers->addPass("depth pre-pass");
+		}
+		shadingTimer = gpuTimers->addPass(deferredShading ? "G-buffer" : "shading");
+		if (deferredShading)
+		{
+			lightingTimer = gpuTimers->addPass("deferred lighting");
+			if (forwardDraws) {
+				translucentTimer = gpuTimers->addPass("translucent");
+			}
+		}
+	}
 
+	// the CPU stays at most maxFramesInFlight frames ahead, rather than as far as the driver lets it
+	std::unique_ptr<FramePacer> framePacer(new FramePacer(maxFramesInFlight));
+	// what the draws see of the camera, written right before them
+	std::unique_ptr<CameraBlock> cameraBlock(new CameraBlock(maxFramesInFlight));
+	unsigned int frameIndex = 0;
+	std::vector<int> selectedPointLights;
+
+	// makes the lighting variant a packet picked current and sets its uniforms, only what changed is set
+	auto useLighting = [&](const DrawPacket& packet) {
+		if (deferredShading && !sceneDraws[packet.draw].translucent)
+		{
+			// lit later, once per pixel
+			deferredShading->useGeometry(transforms[sceneDraws[packet.draw].object], false);
+			return;
+		}
 
+		ShaderPermutations::Variant& variant = lightingPermutations.get(packet.lightingFeatures);
+		variant.shader.use();
+		if (variant.lastFrame != frameIndex)
+		{
+			setFrameLighting(variant.shader, sceneLights, packet.lightingFeatures);
+			CameraBlock::bind(variant.shader);
+			if (clusteredLighting) {
+				lightClusters->bind(variant.shader);
+			}
+			variant.lastFrame = frameIndex;
+		}
+		if (!clusteredLighting && variant.stateKey != packet.pointLightKey)
+		{
+			selectedPointLights.assign(packet.pointLights, packet.pointLights + packet.pointLightCount);
+			setPointLights(variant.shader, sceneLights, selectedPointLights);
+			variant.stateKey = packet.pointLightKey;
+		}
+		variant.shader.setMat4("model", packet.model);
+		variant.shader.setMat3("normalMatrix", packet.normalMatrix);
+	};
 
 	// render loop
 	// -----------
 	while (!glfwWindowShouldClose(window))
 	{
+		// wait for the GPU to catch up before sampling input, so the input is as fresh as it can be when drawn
+		framePacer->beginFrame();
+		cameraBlock->beginFrame();
+
 		// per-frame time logic
 		// --------------------
 		float currentFrame = glfwGetTime();
@@ -354,334 +506,279 @@ int main()
 		// -----
 		processInput(window);
 
+		// stream in more texture detail
+		// -----------------------------
+		textureStreamer.update(TEXTURE_UPLOAD_BUDGET_BYTES);
+
+		// GL work other threads handed over (shaders that were edited are swapped in here)
+		// ---------------------------------------------------------------------------------
+		jobSystem.runMainThreadJobs();
+
 		// render
 		// ------
+		if (gpuTimers) {
+			gpuTimers->beginFrame();
+		}
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 
-		lightingShader.use();
-		lightingShader.setVec3("viewPos", camera.Position);
-		lightingShader.setFloat("material.shininess", 32.0f);
-
-		// directional light
-		lightingShader.setVec3("dirLight.direction", 2.5f, 0.0f, 0.0f);
-		lightingShader.setVec3("dirLight.ambient", 0.10f, 0.10f, 0.10f);
-		lightingShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-		lightingShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-		// key light
-		lightingShader.setVec3("pointLights[0].position", pointLightPositions[0]);
-		lightingShader.setVec3("pointLights[0].ambient", 0.5f, 0.5f, 0.5f);
-		lightingShader.setVec3("pointLights[0].diffuse", 0.5f, 0.5f, 0.5f);
-		lightingShader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-		lightingShader.setFloat("pointLights[0].constant", 1.0f);
-		lightingShader.setFloat("pointLights[0].linear", 0.09);
-		lightingShader.setFloat("pointLights[0].quadratic", 0.032);
-		// fill light
-		lightingShader.setVec3("pointLights[1].position", pointLightPositions[1]);
-		lightingShader.setVec3("pointLights[1].ambient", 0.7f, 0.7f, 0.7f);
-		lightingShader.setVec3("pointLights[1].diffuse", 0.1f, 0.1f, 0.1f);
-		lightingShader.setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-		lightingShader.setFloat("pointLights[1].constant", 1.0f);
-		lightingShader.setFloat("pointLights[1].linear", 0.09);
-		lightingShader.setFloat("pointLights[1].quadratic", 0.032);
-		// point light 3
-		lightingShader.setVec3("pointLights[2].position", pointLightPositions[2]);
-		lightingShader.setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-		lightingShader.setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-		lightingShader.setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-		lightingShader.setFloat("pointLights[2].constant", 1.0f);
-		lightingShader.setFloat("pointLights[2].linear", 0.09);
-		lightingShader.setFloat("pointLights[2].quadratic", 0.032);
-		// point light 4
-		lightingShader.setVec3("pointLights[3].position", pointLightPositions[3]);
-		lightingShader.setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-		lightingShader.setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-		lightingShader.setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-		lightingShader.setFloat("pointLights[3].constant", 1.0f);
-		lightingShader.setFloat("pointLights[3].linear", 0.09);
-		lightingShader.setFloat("pointLights[3].quadratic", 0.032);
-		// spotLight
-		lightingShader.setVec3("spotLight.position", camera.Position);
-		lightingShader.setVec3("spotLight.direction", camera.Front);
-		lightingShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-		lightingShader.setVec3("spotLight.diffuse", 0.7f, 0.7f, 0.7f);
-		lightingShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-		lightingShader.setFloat("spotLight.constant", 1.0f);
-		lightingShader.setFloat("spotLight.linear", 0.09);
-		lightingShader.setFloat("spotLight.quadratic", 0.032);
-		lightingShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-		lightingShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
-
-		// view/projection transformations
-		glm::mat4 view = camera.GetViewMatrix();
-		lightingShader.setMat4("projection", projection);
-		lightingShader.setMat4("view", view);
-
-		// world transformation
-		glm::mat4 model = glm::mat4(1.0f);
-		lightingShader.setMat4("model", model);
-
-		glm::mat4 scale;
-		glm::mat4 rotation;
-		glm::mat4 translation;
-		glm::mat4 projection;
-		GLint modelLoc;
-		GLint viewLoc;
-		GLint projLoc;
-
-// setup to draw plane
-		glBindTexture(GL_TEXTURE_2D, woodMap);
-		glBindVertexArray(planeVAO);
-		model = glm::scale(model, glm::vec3(0.5f, 0.5f, 0.5f));
-		model = glm::translate(model, glm::vec3(0.0f, -1.0f, 0.0f));
-		model = glm::rotate(model, glm::radians(70.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		lightingShader.setMat4("model", model);
-
-		// draw plane
-		glDrawElements(GL_TRIANGLES, planeNumIndices, GL_UNSIGNED_SHORT, (void*)planeIndexByteOffset);
-
-// rectangle
-
-		model = model = glm::mat4(1.0f);
-		model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-		model = glm::translate(model, glm::vec3(0.0f, 4.5f, 0.0f));
-		model = glm::rotate(model, glm::radians(70.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		lightingShader.setMat4("model", model);
-
-		// Set the shader to be used
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, woodGrainMap);
-
-		// Activate the VBOs contained within the mesh's VAO
-		glBindVertexArray(gRectangle.vao);
-
-		// Draws the rectangle
-		glDrawArrays(GL_TRIANGLES, 0, gRectangle.Vertices);
-
-		glClear(GL_DEPTH_BUFFER_BIT);
-		
-// left cube
-		// Model Matrix - steps 1-4
-		model = model = glm::mat4(1.0f);
-		model = glm::scale(model, glm::vec3(1.2f, 1.2f, 1.2f));
-		model = glm::translate(model, glm::vec3(-2.2f, 3.9f, 0.0f));
-		model = glm::rotate(model, glm::radians(70.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-
-		// Set the shader to be used
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, woodMap);
-
-		// Activate the VBOs contained within the mesh's VAO
-		glBindVertexArray(gLeftCube.vao);
-
-		lightingShader.setMat4("model", model);
-
-		// Draws the left cube
-		glDrawArrays(GL_TRIANGLES, 0, gLeftCube.Vertices);
-
-// middle cube
-	   // Model Matrix - steps 1-4
-		model = model = glm::mat4(1.0f);
-		model = glm::scale(model, glm::vec3(1.2f, 1.2f, 1.2f));
-		model = glm::translate(model, glm::vec3(0.1f, 3.9f, 0.0f));
-		model = glm::rotate(model, glm::radians(70.0f), glm::vec3(1.0f, 0.0f, 0.0f)); //90.0 1 0 0 makes it sit flat, 120.0 makes it tilt forward
-
-		// Set the shader to be used
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, woodMap);
-
-		// Activate the VBOs contained within the mesh's VAO
-		glBindVertexArray(gCenterCube.vao);
-
-		lightingShader.setMat4("model", model);
-
-		// Draws the middle cube
-		glDrawArrays(GL_TRIANGLES, 0, gCenterCube.Vertices);
-
-// right cube
-		// Model Matrix - steps 1-4
-		model = model = glm::mat4(1.0f);
-		model = glm::scale(model, glm::vec3(1.2f, 1.2f, 1.2f));
-		model = glm::translate(model, glm::vec3(2.2f, 3.9f, 0.0f));
-		model = glm::rotate(model, glm::radians(70.0f), glm::vec3(1.0f, 0.0f, 0.0f)); //90.0 1 0 0 makes it sit flat, 120.0 makes it tilt forward
-
-		// Set the shader to be used
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, woodMap);
-
-		// Activate the VBOs contained within the mesh's VAO
-		glBindVertexArray(gRightCube.vao);
-
-		lightingShader.setMat4("model", model);
-
-		// Draws the right cube
-		glDrawArrays(GL_TRIANGLES, 0, gRightCube.Vertices);
-
-
-// setup to draw sphere
-		glBindTexture(GL_TEXTURE_2D, marbleMap);
-		glBindVertexArray(sphereVAO);
-		model = model = glm::mat4(1.0f);
-		model = glm::rotate(model, glm::radians(70.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		model = glm::translate(model, glm::vec3(-5.2f, 1.0f, 0.0f));
-		model = glm::scale(model, glm::vec3(1.5f));
-		lightingShader.setMat4("model", model);
-
-		// draw sphere
-		glDrawElements(GL_TRIANGLES, sphereNumIndices, GL_UNSIGNED_SHORT, (void*)sphereIndexByteOffset);
-		
-// cylinder - head
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, blackTextureMap);
-		glBindVertexArray(cylinderVAO);
-		model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first	
-		model = glm::rotate(model, glm::radians(70.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 5.0f));
-		model = glm::scale(model, glm::vec3(0.9f));
-		lightingShader.setMat4("model", model);
-
-
-		static_meshes_3D::Cylinder C(2, 30, .3, true, true, true);
-		C.render();
-
-// cylinder - left ear
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, blackTextureMap);
-		glBindVertexArray(cylinderVAO);
-		model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first	
-		model = glm::rotate(model, glm::radians(70.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		model = glm::translate(model, glm::vec3(-2.5f, 0.0f, 3.0f));
-		//model = glm::scale(model, glm::vec3(0.5f));
-		lightingShader.setMat4("model", model);
-
-
-		static_meshes_3D::Cylinder Cl(1, 30, .3, true, true, true);
-		Cl.render();
-
-// cylinder - right ear
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, blackTextureMap);
-		glBindVertexArray(cylinderVAO);
-		model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first	
-		model = glm::rotate(model, glm::radians(70.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		model = glm::translate(model, glm::vec3(0.6f, 0.0f, 3.0f));
-		lightingShader.setMat4("model", model);
+		// the flashlight follows the camera
+		frameIndex++;
+		sceneLights.spotLight.position = camera.Position;
+		sceneLights.spotLight.direction = camera.Front;
+		if (!lateLatch) {
+			cameraBlock->latch(camera.GetViewMatrix(), projection, camera.Position, sceneLights.spotLight);
+		}
+
+		// objects that moved get new normal matrices and bounds
+		transforms.update();
+
+		// bin the point lights for this frame's view, on the worker threads while this one culls and builds the draw list
+		JobCounter lightsUploaded;
+		if (clusteredLighting)
+		{
+			glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+			lightClusters->setProjection(projection, 0.1f, 100.0f);
+			lightClusters->update(sceneLights.pointLights, camera.GetViewMatrix(), lightsUploaded);
+		}
+
+		// the deferred path renders the scene into its G-buffer first
+		if (deferredShading) {
+			deferredShading->beginFrame(framebufferWidth, framebufferHeight, projection);
+		}
+
+		// objects entirely outside the view frustum are not drawn
+		const glm::mat4 view = camera.GetViewMatrix();
+		const Frustum frustum = frustumFromMatrix(projection * view);
+		size_t visibleObjects = 0;
+		if (transforms.size() < BVH_CULLING_MIN_OBJECTS) {
+			visibleObjects = cullBoxes(frustum, transforms.worldBoxes(), transforms.size(), objectVisible);
+		}
+		else
+		{
+			sceneBvh.queryFrustum(frustum, bvhVisible);
+			objectVisible.assign(transforms.size(), 0);
+			for (uint32_t object : bvhVisible) {
+				objectVisible[object] = 1;
+			}
+			visibleObjects = bvhVisible.size();
+		}
+		if (frameIndex % 256 == 0) {
+			std::cout << "Frustum culling: " << visibleObjects << " visible, " << transforms.size() - visibleObjects << " culled" << std::endl;
+		}
+		if (softwareOcclusion)
+		{
+			softwareOcclusion->render(projection * view, transforms);
+			const size_t hiddenObjects = softwareOcclusion->cull(transforms, objectVisible);
+			if (frameIndex % 256 == 0) {
+				std::cout << "Occlusion culling: " << hiddenObjects << " hidden, " << softwareOcclusion->lastRenderMilliseconds() << " ms" << std::endl;
+			}
+		}
+		if (occlusionQueries) {
+			occlusionQueries->beginFrame(camera.Position);
+		}
+
+		// what every draw needs (sort key, lighting variant and lights, matrices) is worked out across the worker
+		// threads, this thread then only issues GL calls. Opaque draws come front to back so that early-Z skips
+		// hidden fragments, translucent ones back to front after them
+		const std::vector<const DrawPacket*>& drawPackets = drawList.build(sceneDraws.size(), [&](size_t index, DrawPacket& packet) {
+			const SceneDraw& draw = sceneDraws[index];
+			const ObjectTransform& object = transforms[draw.object];
+			if (!objectVisible[draw.object])
+			{
+				packet.sortKey = NOT_DRAWN;
+				return;
+			}
+			const float viewDepth = -(view * glm::vec4(object.center, 1.0f)).z;
+			packet.sortKey = drawSortKey(draw.layer, draw.translucent, viewDepth, 100.0f);
+			packet.model = object.model;
+			packet.normalMatrix = object.normalMatrix;
+			packet.lightingFeatures = 0;
+			packet.pointLightKey = 0;
+			packet.pointLightCount = 0;
+			// the deferred path lights opaque draws per pixel, only translucent ones pick their lights here
+			if (deferredShading && !draw.translucent) {
+				return;
+			}
+			if (clusteredLighting) {
+				packet.lightingFeatures = selectClusteredLighting(sceneLights, object.center, object.radius, false);
+			}
+			else
+			{
+				thread_local std::vector<int> pointLights;
+				packet.lightingFeatures = selectLighting(sceneLights, object.center, object.radius, false, pointLights);
+				packet.pointLightKey = pointLightSelectionKey(pointLights);
+				packet.pointLightCount = (int)pointLights.size();
+				std::copy(pointLights.begin(), pointLights.end(), packet.pointLights);
+			}
+		});
+		if (frameIndex % 256 == 0) {
+			std::cout << "Draw list: " << drawPackets.size() << " draws, " << drawList.lastBuildMilliseconds() << " ms" << std::endl;
+		}
+
+		// the light clusters have to be on the GPU before the first draw; their upload runs on this thread, here or in the waits above
+		if (clusteredLighting)
+		{
+			jobSystem.wait(lightsUploaded);
+			if (frameIndex % 256 == 0) {
+				std::cout << "Clustered lighting: " << sceneLights.pointLights.size() << " lights, " << lightClusters->lightReferenceCount() << " cluster references, " << lightClusters->lastUpdateMilliseconds() << " ms" << std::endl;
+			}
+		}
 
+		// late latch: mouse movement that came in while the frame was prepared still makes it into the draws.
+		// Culling, sorting and light binning above used the camera of the frame start, a frame of mouse movement
+		// at most behind this one: objects can pop in a frame late at the screen edges and occluder silhouettes
+		if (lateLatch)
+		{
+			glfwPollEvents();
+			sceneLights.spotLight.position = camera.Position;
+			sceneLights.spotLight.direction = camera.Front;
+			cameraBlock->latch(camera.GetViewMatrix(), projection, camera.Position, sceneLights.spotLight);
+		}
 
-		static_meshes_3D::Cylinder Cr(1, 30, .3, true, true, true);
-		Cr.render();
-
-// Cylinder - Base of glass
-
-		// cylinder - right ear
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, greenSwirl);
-		glBindVertexArray(cylinderVAO);
-		model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first	
-		model = glm::rotate(model, glm::radians(70.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		model = glm::translate(model, glm::vec3(5.0f, 0.0f, 0.0f));
-		lightingShader.setMat4("model", model);
-
-
-		static_meshes_3D::Cylinder CBase(0.8, 30, 0.1, true, true, true);
-		CBase.render();
-
-// Pyramid - bottom glass
-		model = model = glm::mat4(1.0f);
-		model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-		model = glm::translate(model, glm::vec3(5.1f, 0.3f, 0.5f));
-		model = glm::rotate(model, glm::radians(270.0f), glm::vec3(0.5f, 1.0f, 0.0f));
-		lightingShader.setMat4("model", model);
-
-		// Set the shader to be used
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, greenSwirl);
-
-		// Activate the VBOs contained within the mesh's VAO
-		glBindVertexArray(gBottomPyramid.vao);
-
-		// Draws the rectangle
-		glDrawArrays(GL_TRIANGLES, 0, gBottomPyramid.Vertices);
-
-// cylinder - stem of glass 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, greenSwirl);
-		glBindVertexArray(cylinderVAO);
-		model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first	
-		model = glm::rotate(model, glm::radians(70.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		model = glm::translate(model, glm::vec3(5.0f, 1.0f, 0.0f));
-		lightingShader.setMat4("model", model);
-
-
-		static_meshes_3D::Cylinder CStem(0.2, 30, 2, true, true, true);
-		CStem.render();
-
-// Open Pyramid - top of glass
-		model = model = glm::mat4(1.0f);
-		model = glm::scale(model, glm::vec3(2.0f, 2.0f, 2.0f));
-		model = glm::translate(model, glm::vec3(2.5f, 0.3f, 0.85f));
-		model = glm::rotate(model, glm::radians(260.0f), glm::vec3(0.5f, 1.0f, 0.0f));
-		lightingShader.setMat4("model", model);
-
-		// Set the shader to be used
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, greenSwirl);
-
-		// Activate the VBOs contained within the mesh's VAO
-		glBindVertexArray(gTopOpenPyramid.vao);
-
-		// Draws the pyramid
-		glDrawArrays(GL_TRIANGLES, 0, gTopOpenPyramid.Vertices);
-
-		glClear(GL_DEPTH_BUFFER_BIT);
+		// the depth buffer stays valid for the whole frame, layers only move each other's depth range
+		if (depthPrepass)
+		{
+			if (gpuTimers) gpuTimers->begin(prepassTimer);
+			depthPrepass->begin();
+			int layer = -1;
+			for (const DrawPacket* packet : drawPackets)
+			{
+				const SceneDraw& draw = sceneDraws[packet->draw];
+				if (draw.translucent) {
+					break;
+				}
+				if (occlusionQueries && occlusionQueries->isHidden(draw.occlusionQuery)) {
+					continue;
+				}
+				if (draw.layer != layer) {
+					renderLayers.begin(layer = draw.layer);
+				}
+				depthPrepass->draw(draw.depthMesh, packet->model);
+			}
+			depthPrepass->end();
+			if (gpuTimers) gpuTimers->end();
+		}
 
-// Torus
-		model = model = glm::mat4(1.0f);
-		model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));
-		model = glm::translate(model, glm::vec3(25.0f, 5.0f, 13.0f));
-		model = glm::rotate(model, glm::radians(150.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		lightingShader.setMat4("model", model);
-
-		// Set the shader to be used
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, greenSwirl);
-
-		// Activate the VBOs contained within the mesh's VAO
-		glBindVertexArray(gTorus.vao);
+		// draws the packets in [begin, end), blending the translucent ones
+		auto drawPacketRange = [&](size_t begin, size_t end) {
+			int layer = -1;
+			bool blending = false;
+			bool equalDepth = depthPrepass != nullptr;
+			for (size_t i = begin; i < end; i++)
+			{
+				const DrawPacket* packet = drawPackets[i];
+				const SceneDraw& draw = sceneDraws[packet->draw];
+				if (draw.layer != layer) {
+					renderLayers.begin(layer = draw.layer);
+				}
+				if (draw.translucent && !blending)
+				{
+					glEnable(GL_BLEND);
+					glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+					glDepthMask(GL_FALSE);
+					blending = true;
+				}
+				// only what the pre-pass laid down matches with GL_EQUAL; the rest (translucent draws, meshes it could not
+				// read back) is depth tested as without it, opaque ones writing their depth
+				const bool prepassed = depthPrepass && !draw.translucent && draw.depthMesh != ~(size_t)0;
+				if (depthPrepass && prepassed != equalDepth)
+				{
+					glDepthFunc(prepassed ? GL_EQUAL : GL_LESS);
+					if (!draw.translucent) {
+						glDepthMask(prepassed ? GL_FALSE : GL_TRUE);
+					}
+					equalDepth = prepassed;
+				}
+				// the box test comes after what was drawn before it in this frame; hidden meshes are not submitted
+				const bool queried = occlusionQueries && draw.occlusionQuery != ~(size_t)0;
+				if (queried && !occlusionQueries->beginDraw(draw.occlusionQuery, transforms[draw.object].boundsMin, transforms[draw.object].boundsMax)) {
+					continue;
+				}
+				useLighting(*packet);
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, draw.texture);
+				drawMesh(draw.mesh);
+				if (queried) {
+					occlusionQueries->endDraw();
+				}
+			}
+			if (blending)
+			{
+				glDisable(GL_BLEND);
+				glDepthMask(GL_TRUE);
+			}
+			RenderLayers::end();
+		};
+
+		// the G-buffer keeps one surface per pixel, translucent draws (sorted last) would blend into its normals and depth
+		size_t opaqueEnd = drawPackets.size();
+		if (deferredShading)
+		{
+			opaqueEnd = std::find_if(drawPackets.begin(), drawPackets.end(), [&](const DrawPacket* packet) {
+				return sceneDraws[packet->draw].translucent;
+			}) - drawPackets.begin();
+		}
 
-		// Draws the torus
-		glDrawArrays(GL_TRIANGLES, 0, gTorus.Vertices);
+		if (gpuTimers) gpuTimers->begin(shadingTimer);
+		drawPacketRange(0, opaqueEnd);
+		if (gpuTimers) gpuTimers->end();
+		if (depthPrepass) {
+			DepthPrepass::restoreDepthState();
+		}
+
+		// light the G-buffer, then blend the translucent draws over it, forward shaded and hidden by the G-buffer's depth
+		if (deferredShading)
+		{
+			if (gpuTimers) gpuTimers->begin(lightingTimer);
+			deferredShading->shade(sceneLights, *lightClusters);
+			if (gpuTimers) gpuTimers->end();
+			if (opaqueEnd < drawPackets.size())
+			{
+				if (gpuTimers) gpuTimers->begin(translucentTimer);
+				deferredShading->blitDepth();
+				drawPacketRange(opaqueEnd, drawPackets.size());
+				if (gpuTimers) gpuTimers->end();
+			}
+		}
+
+		if (gpuTimers && frameIndex % 256 == 0) {
+			gpuTimers->report();
+		}
+		if (occlusionQueries && frameIndex % 256 == 0) {
+			occlusionQueries->report();
+		}
+		if (frameIndex % 256 == 0) {
+			framePacer->report();
+		}
 
-		glClear(GL_DEPTH_BUFFER_BIT);
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
 		glfwSwapBuffers(window);
+		cameraBlock->endFrame();
+		framePacer->endFrame();
 		glfwPollEvents();
 	}
 
 	// optional: de-allocate all resources once they've outlived their purpose:
 	// ------------------------------------------------------------------------
-	glDeleteVertexArrays(1, &cubeVAO);
-	glDeleteBuffers(1, &cubeVBO);
-	glDeleteVertexArrays(1, &planeVAO);
-	glDeleteBuffers(1, &planeVBO);
-	glDeleteVertexArrays(1, &gRectangle.vao);
-	glDeleteBuffers(1, &gRectangle.vbo);
-	glDeleteVertexArrays(1, &gCenterCube.vao);
-	glDeleteBuffers(1, &gCenterCube.vbo);
-	glDeleteVertexArrays(1, &gLeftCube.vao);
-	glDeleteBuffers(1, &gLeftCube.vbo);
-	glDeleteVertexArrays(1, &gRightCube.vao);
-	glDeleteBuffers(1, &gRightCube.vbo);
-	glDeleteVertexArrays(1, &sphereVAO);
-	glDeleteBuffers(1, &sphereVBO);
-	glDeleteVertexArrays(1, &gBottomPyramid.vao);
-	glDeleteBuffers(1, &gBottomPyramid.vbo);
-	glDeleteVertexArrays(1, &gTopOpenPyramid.vao);
-	glDeleteBuffers(1, &gTopOpenPyramid.vbo);
-	glDeleteVertexArrays(1, &gTorus.vao);
-	glDeleteBuffers(1, &gTorus.vbo);
+	DeleteSceneMeshes(sceneMeshes);
+
+	// these need the context, and the reloader owns a window, so they go before GLFW does
+	framePacer.reset();
+	cameraBlock.reset();
+	gpuTimers.reset();
+	occlusionQueries.reset();
+	depthPrepass.reset();
+	deferredShading.reset();
+	lightClusters.reset();
+	shaderReloader.reset();
+
+	// whatever is still listed lives until the context goes, or leaks
+	if (resourceReportEnabled) {
+		printResourceReport();
+	}
 
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
@@ -723,6 +820,13 @@ void processInput(GLFWwindow* window)
 		}
 	}
 
+	// print the GL objects and CPU memory held, once per press
+	static bool reportKeyDown = false;
+	const bool reportKey = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+	if (reportKey && !reportKeyDown) {
+		printResourceReport();
+	}
+	reportKeyDown = reportKey;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -762,8 +866,14 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 
 unsigned int loadTexture(char const* path)
 {
+	// KTX2 files are uploaded straight from a memory mapping, with their own mip chain
+	const std::string pathString(path);
+	if (pathString.size() > 5 && pathString.compare(pathString.size() - 5, 5, ".ktx2") == 0) {
+		return loadKTX2(path);
+	}
+
 	unsigned int textureID;
-	glGenTextures(1, &textureID);
+	trackedGenTextures(1, &textureID);
 
 	int width, height, nrComponents;
 	stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis
@@ -778,16 +888,26 @@ unsigned int loadTexture(char const* path)
 		else if (nrComponents == 4)
 			format = GL_RGBA;
 
+		// build the mip chain on the CPU (gamma-correct for colour images) instead of glGenerateMipmap
+		MipImage base;
+		base.width = width;
+		base.height = height;
+		base.channels = nrComponents;
+		base.pixels.assign(data, data + (size_t)width * height * nrComponents);
+		stbi_image_free(data);
+		const auto levels = generateMipChain(std::move(base), nrComponents >= 3);
+
 		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (size_t level = 0; level < levels.size(); level++) {
+			trackedTexImage2D(GL_TEXTURE_2D, (GLint)level, format, levels[level].width, levels[level].height, 0, format, GL_UNSIGNED_BYTE, levels[level].pixels.data());
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-
-		stbi_image_free(data);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	}
 	else
 	{
@@ -867,14 +987,15 @@ void CreateRectangle(GLShape& shape)
 	const GLuint floatsPerTexture = 2; // Texture
 
 	shape.Vertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerTexture));
+	shape.bounds = boundsOfVertices(verts, shape.Vertices, floatsPerVertex + floatsPerNormal + floatsPerTexture);
 
-	glGenVertexArrays(1, &shape.vao);
-	glGenBuffers(1, &shape.vbo);
+	trackedGenVertexArrays(1, &shape.vao);
+	trackedGenBuffers(1, &shape.vbo);
 
 	glBindVertexArray(shape.vao);
 
 	glBindBuffer(GL_ARRAY_BUFFER, shape.vbo);  // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);  // Sends vertex or coordinate data to the GPU
+	trackedBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);  // Sends vertex or coordinate data to the GPU
 
 	// Strides between vertex coordinates is 6 (x, y, r, g, b, a). A tightly packed stride is 0.
 	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerTexture); // number of floats before each
@@ -947,14 +1068,15 @@ void CreateCubeNoTop(GLShape& shape)
 	const GLuint floatsPerTexture = 2; // Texture
 
 	shape.Vertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerColor + floatsPerTexture));
+	shape.bounds = boundsOfVertices(verts, shape.Vertices, floatsPerVertex + floatsPerColor + floatsPerTexture);
 
-	glGenVertexArrays(1, &shape.vao);
-	glGenBuffers(1, &shape.vbo);
+	trackedGenVertexArrays(1, &shape.vao);
+	trackedGenBuffers(1, &shape.vbo);
 
 	glBindVertexArray(shape.vao);
 
 	glBindBuffer(GL_ARRAY_BUFFER, shape.vbo);  // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);  // Sends vertex or coordinate data to the GPU
+	trackedBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);  // Sends vertex or coordinate data to the GPU
 
 	// Strides between vertex coordinates is 6 (x, y, r, g, b, a). A tightly packed stride is 0.
 	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerColor + floatsPerTexture); // number of floats before each
@@ -1015,14 +1137,15 @@ void CreatePyramid(GLShape& shape)
 	const GLuint floatsPerTexture = 2; // Texture
 
 	shape.Vertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerColor + floatsPerTexture));
+	shape.bounds = boundsOfVertices(verts, shape.Vertices, floatsPerVertex + floatsPerColor + floatsPerTexture);
 
-	glGenVertexArrays(1, &shape.vao);
-	glGenBuffers(1, &shape.vbo);
+	trackedGenVertexArrays(1, &shape.vao);
+	trackedGenBuffers(1, &shape.vbo);
 
 	glBindVertexArray(shape.vao);
 
 	glBindBuffer(GL_ARRAY_BUFFER, shape.vbo);  // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);  // Sends vertex or coordinate data to the GPU
+	trackedBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);  // Sends vertex or coordinate data to the GPU
 
 	// Strides between vertex coordinates is 6 (x, y, r, g, b, a). A tightly packed stride is 0.
 	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerColor + floatsPerTexture); // number of floats before each
@@ -1074,14 +1197,15 @@ void CreateOpenPyramid(GLShape& shape)
 	const GLuint floatsPerTexture = 2; // Texture
 
 	shape.Vertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerColor + floatsPerTexture));
+	shape.bounds = boundsOfVertices(verts, shape.Vertices, floatsPerVertex + floatsPerColor + floatsPerTexture);
 
-	glGenVertexArrays(1, &shape.vao);
-	glGenBuffers(1, &shape.vbo);
+	trackedGenVertexArrays(1, &shape.vao);
+	trackedGenBuffers(1, &shape.vbo);
 
 	glBindVertexArray(shape.vao);
 
 	glBindBuffer(GL_ARRAY_BUFFER, shape.vbo);  // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);  // Sends vertex or coordinate data to the GPU
+	trackedBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);  // Sends vertex or coordinate data to the GPU
 
 	// Strides between vertex coordinates is 6 (x, y, r, g, b, a). A tightly packed stride is 0.
 	GLint stride = sizeof(float) * (floatsPerVertex + floatsPerColor + floatsPerTexture); // number of floats before each
@@ -1118,11 +1242,11 @@ void setCoords(double r, double c, int rSeg, int cSeg, int i, int j,
 	uv[1] = j / (double)cSeg;
 }
 
-int createObject(double r, double c, int rSeg, int cSeg, GLfloat** vertices,
+int createObject(double r, double c, int rSeg, int cSeg, Arena& arena, GLfloat** vertices,
 	GLfloat** uv) {
 	int count = rSeg * cSeg * 6;
-	*vertices = (GLfloat*)malloc(count * 3 * sizeof(GLfloat));
-	*uv = (GLfloat*)malloc(count * 2 * sizeof(GLfloat));
+	*vertices = arena.allocateArray<GLfloat>(count * 3);
+	*uv = arena.allocateArray<GLfloat>(count * 2);
 
 	for (int x = 0; x < cSeg; x++) { // through stripes
 		for (int y = 0; y < rSeg; y++) { // through squares on stripe
@@ -1144,24 +1268,26 @@ int createObject(double r, double c, int rSeg, int cSeg, GLfloat** vertices,
 
 void CreateTorus(GLTorus& torus)
 {
+	ArenaScope arenaScope(Arena::threadArena());
 	GLfloat* g_vertex_buffer_data;
 	GLfloat* g_uv_buffer_data;
-	int torusVertices = createObject(.5, 3.0, 180, 180, &g_vertex_buffer_data,
+	int torusVertices = createObject(.5, 3.0, 180, 180, Arena::threadArena(), &g_vertex_buffer_data,
 		&g_uv_buffer_data);
 
 	torus.Vertices = torusVertices;
+	torus.bounds = boundsOfVertices(g_vertex_buffer_data, torusVertices, 3);
 
-	glGenVertexArrays(1, &torus.vao);
-	glGenBuffers(1, &torus.vbo);
+	trackedGenVertexArrays(1, &torus.vao);
+	trackedGenBuffers(1, &torus.vbo);
 
 	glBindVertexArray(torus.vao);
 
 	glBindBuffer(GL_ARRAY_BUFFER, torus.vbo);  // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, torusVertices * 3 * sizeof(GLfloat), g_vertex_buffer_data, GL_STATIC_DRAW);
+	trackedBufferData(GL_ARRAY_BUFFER, torusVertices * 3 * sizeof(GLfloat), g_vertex_buffer_data, GL_STATIC_DRAW);
 
-	glGenBuffers(1, &torus.uvbo);
+	trackedGenBuffers(1, &torus.uvbo);
 	glBindBuffer(GL_ARRAY_BUFFER, torus.uvbo);
-	glBufferData(GL_ARRAY_BUFFER, torusVertices * 2 * sizeof(GLfloat),
+	trackedBufferData(GL_ARRAY_BUFFER, torusVertices * 2 * sizeof(GLfloat),
 		g_uv_buffer_data, GL_STATIC_DRAW);
 
 
@@ -1187,4 +1313,118 @@ void CreateTorus(GLTorus& torus)
 		(void*)0                          // array buffer offset
 	);
 
-}
\ No newline at end of file
+}
+
+// cylinders are centered on their local origin, along the y axis
+LocalBounds CylinderBounds(const static_meshes_3D::Cylinder& cylinder)
+{
+	const float radius = cylinder.getRadius();
+	const float halfHeight = cylinder.getHeight() * 0.5f;
+	return boundsOfBox(glm::vec3(-radius, -halfHeight, -radius), glm::vec3(radius, halfHeight, radius));
+}
+
+MeshDraw CylinderMesh(const static_meshes_3D::Cylinder& cylinder)
+{
+	// as Cylinder::render() draws it: the side as one strip, then a fan for each cover
+	const int side = cylinder.getNumVerticesSide();
+	const int cover = cylinder.getNumVerticesTopBottom();
+	MeshDraw mesh;
+	mesh.vertexArray = cylinder.getVertexArray();
+	mesh.ranges.push_back({ GL_TRIANGLE_STRIP, 0, side });
+	mesh.ranges.push_back({ GL_TRIANGLE_FAN, side, cover });
+	mesh.ranges.push_back({ GL_TRIANGLE_FAN, side + cover, cover });
+	return mesh;
+}
+
+// plane and sphere: interleaved vertices followed by 16-bit indices, in one buffer
+MeshDraw CreateShapeDataMesh(const ShapeData& data, GLShape& shape)
+{
+	trackedGenVertexArrays(1, &shape.vao);
+	trackedGenBuffers(1, &shape.vbo);
+	glBindVertexArray(shape.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, shape.vbo);
+	trackedBufferData(GL_ARRAY_BUFFER, data.vertexBufferSize() + data.indexBufferSize(), 0, GL_STATIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, data.vertexBufferSize(), data.vertices);
+	glBufferSubData(GL_ARRAY_BUFFER, data.vertexBufferSize(), data.indexBufferSize(), data.indices);
+	shape.Vertices = data.numVertices;
+	shape.bounds = boundsOfVertices(&data.vertices[0].position.x, data.numVertices, NUM_FLOATS_PER_VERTICE);
+
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)(sizeof(float) * 3));
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)(sizeof(float) * 6));
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shape.vbo);
+	return elementsMesh(shape.vao, GL_TRIANGLES, data.numIndices, GL_UNSIGNED_SHORT, (size_t)data.vertexBufferSize());
+}
+
+void CreateSceneMeshes(const Scene& scene, SceneMeshes& meshes)
+{
+	for (const SceneMesh& sceneMesh : scene.meshes)
+	{
+		GLShape shape = {};
+		MeshDraw draw;
+		switch (sceneMesh.shape)
+		{
+		case SCENE_PLANE:
+		case SCENE_SPHERE:
+		{
+			const uint divisions = sceneMesh.params[0] > 0.0f ? (uint)sceneMesh.params[0] : (sceneMesh.shape == SCENE_PLANE ? 10 : 20);
+			ArenaScope arenaScope(Arena::threadArena());
+			ShapeData data = sceneMesh.shape == SCENE_PLANE ? ShapeGenerator::makePlane(Arena::threadArena(), divisions) : ShapeGenerator::makeSphere(Arena::threadArena(), divisions);
+			draw = CreateShapeDataMesh(data, shape);
+			break;
+		}
+		case SCENE_TORUS:
+		{
+			GLTorus torus = {};
+			CreateTorus(torus);
+			meshes.buffers.push_back(torus.uvbo);
+			shape = { torus.vao, torus.vbo, torus.Vertices, torus.bounds };
+			draw = arraysMesh(shape.vao, GL_TRIANGLES, 0, shape.Vertices);
+			break;
+		}
+		case SCENE_CYLINDER:
+		{
+			static_meshes_3D::Cylinder* cylinder = new static_meshes_3D::Cylinder(sceneMesh.params[0], (int)sceneMesh.params[1], sceneMesh.params[2], true, true, true);
+			meshes.cylinders.emplace_back(cylinder);
+			meshes.draws.push_back(CylinderMesh(*cylinder));
+			meshes.bounds.push_back(CylinderBounds(*cylinder));
+			continue;
+		}
+		case SCENE_CUBE_NO_TOP:
+			CreateCubeNoTop(shape);
+			draw = arraysMesh(shape.vao, GL_TRIANGLES, 0, shape.Vertices);
+			break;
+		case SCENE_RECTANGLE:
+			CreateRectangle(shape);
+			draw = arraysMesh(shape.vao, GL_TRIANGLES, 0, shape.Vertices);
+			break;
+		case SCENE_PYRAMID:
+			CreatePyramid(shape);
+			draw = arraysMesh(shape.vao, GL_TRIANGLES, 0, shape.Vertices);
+			break;
+		case SCENE_OPEN_PYRAMID:
+			CreateOpenPyramid(shape);
+			draw = arraysMesh(shape.vao, GL_TRIANGLES, 0, shape.Vertices);
+			break;
+		default:
+			// unknown shape in a compiled scene: nothing is drawn for it, mesh indices stay valid
+			std::cout << "ERROR::SCENE: unknown mesh shape " << sceneMesh.shape << std::endl;
+			break;
+		}
+		meshes.vertexArrays.push_back(shape.vao);
+		meshes.buffers.push_back(shape.vbo);
+		meshes.draws.push_back(draw);
+		meshes.bounds.push_back(shape.bounds);
+	}
+}
+
+void DeleteSceneMeshes(SceneMeshes& meshes)
+{
+	trackedDeleteVertexArrays((GLsizei)meshes.vertexArrays.size(), meshes.vertexArrays.data());
+	trackedDeleteBuffers((GLsizei)meshes.buffers.size(), meshes.buffers.data());
+	meshes.cylinders.clear();
+	meshes = SceneMeshes();
+}
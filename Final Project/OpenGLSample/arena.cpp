@@ -0,0 +1,151 @@
+// STL
+#include <cstdint>
+#include <cstdlib>
+
+// Project
+#include "arena.h"
+#include "resourceTracker.h"
+
+namespace {
+
+	// First block of every thread's arena; the largest procedural mesh (the torus, ~3.9 MB) fits in it
+	const size_t THREAD_ARENA_BLOCK_SIZE = 4 << 20;
+}
+
+Arena::Arena(size_t blockSize)
+	: _blockSize(blockSize)
+{
+}
+
+Arena::~Arena()
+{
+	freeRetired();
+	for (const Block& block : _blocks)
+	{
+		free(block.data);
+		trackCpuMemory("arena blocks", -(ptrdiff_t)block.size);
+	}
+}
+
+Arena& Arena::threadArena()
+{
+	thread_local Arena arena(THREAD_ARENA_BLOCK_SIZE);
+	return arena;
+}
+
+void* Arena::allocate(size_t sizeBytes, size_t alignment)
+{
+	while (true)
+	{
+		if (_current < _blocks.size())
+		{
+			const Block& block = _blocks[_current];
+			const uintptr_t address = (uintptr_t)(block.data + _used);
+			const size_t offset = _used + (size_t)(((address + alignment - 1) & ~(uintptr_t)(alignment - 1)) - address);
+			if (offset + sizeBytes <= block.size)
+			{
+				_used = offset + sizeBytes;
+				if (block.start + _used > _highWater) {
+					_highWater = block.start + _used;
+				}
+				return block.data + offset;
+			}
+		}
+
+		// the current block is full: on to the next one, if it is kept from before and large enough
+		if (_current + 1 < _blocks.size() && _blocks[_current + 1].size >= sizeBytes + alignment) {
+			_current++;
+		}
+		else {
+			addBlock(sizeBytes + alignment);
+		}
+		_used = 0;
+	}
+}
+
+bool Arena::growLast(void* allocation, size_t sizeBytes, size_t newSizeBytes)
+{
+	if (_current >= _blocks.size()) {
+		return false;
+	}
+
+	const Block& block = _blocks[_current];
+	unsigned char* data = static_cast<unsigned char*>(allocation);
+	if (data < block.data || data + sizeBytes != block.data + _used) {
+		return false; // not the newest allocation, or not in the current block
+	}
+	const size_t offset = (size_t)(data - block.data);
+	if (offset + newSizeBytes > block.size) {
+		return false;
+	}
+
+	_used = offset + newSizeBytes;
+	if (block.start + _used > _highWater) {
+		_highWater = block.start + _used;
+	}
+	return true;
+}
+
+size_t Arena::mark() const
+{
+	return _current < _blocks.size() ? _blocks[_current].start + _used : 0;
+}
+
+void Arena::rewind(size_t position)
+{
+	if (position == 0) {
+		freeRetired();
+	}
+	if (position == 0 && _blocks.size() > 1)
+	{
+		// empty again: one block large enough for all the chained ones, so the next time fits in it. The chained
+		// ones are kept until the next time, what was just released may still be copied out of them
+		size_t total = 0;
+		for (const Block& block : _blocks) {
+			total += block.size;
+		}
+		_retired.swap(_blocks);
+		_blockSize = total;
+		addBlock(total);
+	}
+
+	_current = 0;
+	while (_current + 1 < _blocks.size() && _blocks[_current + 1].start <= position) {
+		_current++;
+	}
+	_used = _current < _blocks.size() ? position - _blocks[_current].start : 0;
+}
+
+size_t Arena::highWater() const
+{
+	return _highWater;
+}
+
+size_t Arena::blockAllocations() const
+{
+	return _blockAllocations;
+}
+
+void Arena::addBlock(size_t minSize)
+{
+	// blocks after the current one are too small for this allocation: they are skipped rather than freed (a rewind
+	// may have just released data in them that is still being read), the merge once the arena is empty gets rid of them
+	Block block;
+	block.size = minSize > _blockSize ? minSize : _blockSize;
+	block.data = static_cast<unsigned char*>(malloc(block.size));
+	trackCpuMemory("arena blocks", (ptrdiff_t)block.size);
+	block.start = _blocks.empty() ? 0 : _blocks.back().start + _blocks.back().size;
+	_blocks.push_back(block);
+	_current = _blocks.size() - 1;
+	_blockAllocations++;
+}
+
+void Arena::freeRetired()
+{
+	for (const Block& block : _retired)
+	{
+		free(block.data);
+		trackCpuMemory("arena blocks", -(ptrdiff_t)block.size);
+	}
+	_retired.clear();
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+// STL
+#include <cstddef>
+#include <vector>
+
+/**
+  Linear (bump) allocator for short-lived CPU data, like the vertices of a mesh being built before
+  they are uploaded. Allocating moves a cursor, nothing is freed one by one: the arena is rewound
+  to a mark, which releases everything allocated after it (see ArenaScope).
+  Memory comes in large blocks. When a block is full another one is chained; once the arena is
+  empty again the blocks are merged into one large enough for all of them, so the same work done
+  again allocates nothing from the heap.
+  Not thread-safe: every thread has its own, threadArena().
+*/
+class Arena
+{
+public:
+	/** \brief Creates an arena, without allocating yet.
+	*   \param blockSize Size of the first block, in bytes
+	*/
+	explicit Arena(size_t blockSize);
+	~Arena();
+
+	//* \brief Gets the arena of the calling thread.
+	static Arena& threadArena();
+
+	/** \brief Allocates memory, uninitialised, valid until the arena is rewound past it.
+	*   \param sizeBytes Size, in bytes
+	*   \param alignment Alignment, in bytes (a power of two)
+	*   \return Pointer to the memory.
+	*/
+	void* allocate(size_t sizeBytes, size_t alignment = alignof(std::max_align_t));
+
+	/** \brief Allocates an array, uninitialised (meant for plain data like vertices and indices).
+	*   \param count Number of elements
+	*   \return Pointer to the first element.
+	*/
+	template<typename T>
+	T* allocateArray(size_t count)
+	{
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	/** \brief Grows the newest allocation in place, if its block has room for it.
+	*   \param allocation   Pointer from allocate(), nothing may have been allocated after it
+	*   \param sizeBytes    Its current size, in bytes
+	*   \param newSizeBytes Size wanted, in bytes
+	*   \return True if it grew (the data did not move), false if nothing changed.
+	*/
+	bool growLast(void* allocation, size_t sizeBytes, size_t newSizeBytes);
+
+	/** \brief Gets the current position, to rewind to later.
+	*   \return Position, grows with every allocation.
+	*/
+	size_t mark() const;
+
+	/** \brief Releases everything allocated after a mark. No block is freed before the arena is emptied again,
+	*   so released data can still be copied out right after a rewind.
+	*   \param position Position from mark()
+	*/
+	void rewind(size_t position);
+
+	/** \brief Gets the most bytes that were in use at once. */
+	size_t highWater() const;
+
+	/** \brief Gets how many blocks were allocated from the heap so far. */
+	size_t blockAllocations() const;
+
+private:
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	struct Block
+	{
+		unsigned char* data;
+		size_t size;
+		size_t start; //!< Position of the block's first byte
+	};
+
+	void addBlock(size_t minSize);
+	void freeRetired();
+
+	std::vector<Block> _blocks; //! Positions grow along the blocks
+	std::vector<Block> _retired; //! Merged away, freed the next time the arena is emptied
+	size_t _current = 0; //! Block allocations come from
+	size_t _used = 0; //! Bytes used in the current block
+	size_t _blockSize; //! Size of the next block
+	size_t _highWater = 0;
+	size_t _blockAllocations = 0;
+};
+
+/**
+  Rewinds an arena to where it was when the scope started: everything allocated meanwhile is released.
+*/
+class ArenaScope
+{
+public:
+	explicit ArenaScope(Arena& arena) : _arena(arena), _mark(arena.mark()) {}
+	~ArenaScope() { _arena.rewind(_mark); }
+
+private:
+	ArenaScope(const ArenaScope&) = delete;
+	ArenaScope& operator=(const ArenaScope&) = delete;
+
+	Arena& _arena;
+	size_t _mark;
+};
@@ -0,0 +1,47 @@
+// STL
+#include <algorithm>
+#include <cmath>
+
+// Project
+#include "bounds.h"
+
+LocalBounds boundsOfVertices(const float* vertices, size_t vertexCount, size_t floatsPerVertex)
+{
+	LocalBounds bounds;
+	if (vertexCount == 0) {
+		return bounds;
+	}
+
+	bounds.min = bounds.max = glm::vec3(vertices[0], vertices[1], vertices[2]);
+	for (size_t i = 1; i < vertexCount; i++)
+	{
+		const float* position = vertices + i * floatsPerVertex;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			bounds.min[axis] = std::min(bounds.min[axis], position[axis]);
+			bounds.max[axis] = std::max(bounds.max[axis], position[axis]);
+		}
+	}
+
+	// the sphere is around the box center, but only as large as the farthest vertex needs
+	bounds.center = (bounds.min + bounds.max) * 0.5f;
+	float radiusSquared = 0.0f;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const float* position = vertices + i * floatsPerVertex;
+		const glm::vec3 offset = glm::vec3(position[0], position[1], position[2]) - bounds.center;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+	bounds.radius = std::sqrt(radiusSquared);
+	return bounds;
+}
+
+LocalBounds boundsOfBox(const glm::vec3& min, const glm::vec3& max)
+{
+	LocalBounds bounds;
+	bounds.min = min;
+	bounds.max = max;
+	bounds.center = (min + max) * 0.5f;
+	bounds.radius = glm::length(max - bounds.center);
+	return bounds;
+}
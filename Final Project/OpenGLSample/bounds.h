@@ -0,0 +1,40 @@
+#pragma once
+
+// STL
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+/**
+  Bounds of a mesh in its local space, computed once when the mesh is built: an axis aligned
+  box and a bounding sphere around the box's center.
+*/
+struct LocalBounds
+{
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 max = glm::vec3(0.0f);
+	glm::vec3 center = glm::vec3(0.0f); //!< Sphere center, the center of the box
+	float radius = 0.0f;
+};
+
+/** \brief Computes the bounds of interleaved vertices.
+*   \param vertices        Vertex data, the position is the first 3 floats of every vertex
+*   \param vertexCount     Number of vertices
+*   \param floatsPerVertex Distance between two vertices in floats
+*/
+LocalBounds boundsOfVertices(const float* vertices, size_t vertexCount, size_t floatsPerVertex);
+
+/** \brief Computes the bounds of a box, for meshes whose extent is known from their parameters.
+*   \param min Lowest corner
+*   \param max Highest corner
+*/
+LocalBounds boundsOfBox(const glm::vec3& min, const glm::vec3& max);
+
+/**
+  Axis aligned box in world space.
+*/
+struct Aabb
+{
+	glm::vec3 min;
+	glm::vec3 max;
+};
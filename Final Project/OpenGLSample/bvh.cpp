@@ -0,0 +1,651 @@
+// STL
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// Project
+#include "bvh.h"
+
+static_assert(sizeof(glm::vec3) == 12, "Bvh nodes are laid out for 12 byte vectors");
+
+const uint32_t Bvh::NONE;
+const uint32_t Bvh::LEAF;
+
+namespace {
+
+	// Candidate split planes per axis in the SAH build
+	const int SAH_BINS = 16;
+
+	Aabb emptyBox()
+	{
+		const float huge = std::numeric_limits<float>::max();
+		return { glm::vec3(huge), glm::vec3(-huge) };
+	}
+
+	void grow(Aabb& box, const Aabb& other)
+	{
+		box.min = glm::min(box.min, other.min);
+		box.max = glm::max(box.max, other.max);
+	}
+
+	// half the surface area, the SAH only compares areas
+	float area(const glm::vec3& min, const glm::vec3& max)
+	{
+		const glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	float area(const Aabb& box)
+	{
+		return area(box.min, box.max);
+	}
+
+	// distance along the ray to where it enters the box, or a negative value if it misses
+	float rayEntry(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance)
+	{
+		const glm::vec3 t0 = (min - origin) * inverseDirection;
+		const glm::vec3 t1 = (max - origin) * inverseDirection;
+		const glm::vec3 entries = glm::min(t0, t1);
+		const glm::vec3 exits = glm::max(t0, t1);
+		const float enter = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+		const float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+		return enter <= exit ? enter : -1.0f;
+	}
+
+	float distanceSquared(const glm::vec3& min, const glm::vec3& max, const glm::vec3& point)
+	{
+		const glm::vec3 outside = glm::max(glm::max(min - point, point - max), glm::vec3(0.0f));
+		return glm::dot(outside, outside);
+	}
+
+	double millisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+void Bvh::build(const std::vector<Aabb>& boxes)
+{
+	_nodes.clear();
+	_parents.clear();
+	_freeNodes.clear();
+	_leafOfItem.assign(boxes.size(), NONE);
+	_itemCount = boxes.size();
+	_root = NONE;
+	_depthFirst = true;
+	if (boxes.empty()) {
+		return;
+	}
+
+	std::vector<BuildItem> items(boxes.size());
+	for (size_t i = 0; i < boxes.size(); i++) {
+		items[i] = { boxes[i], (boxes[i].min + boxes[i].max) * 0.5f, (uint32_t)i };
+	}
+	_nodes.reserve(2 * boxes.size() - 1);
+	_parents.reserve(2 * boxes.size() - 1);
+	_root = buildRange(items, 0, items.size(), NONE);
+}
+
+uint32_t Bvh::buildRange(std::vector<BuildItem>& items, size_t begin, size_t end, uint32_t parent)
+{
+	const uint32_t node = allocateNode();
+	_parents[node] = parent;
+
+	Aabb bounds = emptyBox(), centroidBounds = emptyBox();
+	for (size_t i = begin; i < end; i++)
+	{
+		grow(bounds, items[i].box);
+		grow(centroidBounds, { items[i].centroid, items[i].centroid });
+	}
+	_nodes[node].min = bounds.min;
+	_nodes[node].max = bounds.max;
+
+	if (end - begin == 1)
+	{
+		_nodes[node].left = items[begin].item;
+		_nodes[node].right = LEAF;
+		_leafOfItem[items[begin].item] = node;
+		return node;
+	}
+
+	// binned SAH: sort the centroids into bins along each axis and cost every plane between two bins
+	int bestAxis = -1, bestSplit = 0;
+	float bestCost = std::numeric_limits<float>::max();
+	const glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (extent[axis] <= 0.0f) {
+			continue;
+		}
+		Aabb binBoxes[SAH_BINS];
+		size_t binCounts[SAH_BINS] = {};
+		std::fill(binBoxes, binBoxes + SAH_BINS, emptyBox());
+		const float scale = SAH_BINS / extent[axis];
+		for (size_t i = begin; i < end; i++)
+		{
+			const int bin = std::min((int)((items[i].centroid[axis] - centroidBounds.min[axis]) * scale), SAH_BINS - 1);
+			grow(binBoxes[bin], items[i].box);
+			binCounts[bin]++;
+		}
+
+		// areas and counts left of every plane, then sweep from the right
+		float leftAreas[SAH_BINS - 1];
+		size_t leftCounts[SAH_BINS - 1];
+		Aabb sweep = emptyBox();
+		size_t count = 0;
+		for (int plane = 0; plane < SAH_BINS - 1; plane++)
+		{
+			grow(sweep, binBoxes[plane]);
+			count += binCounts[plane];
+			leftAreas[plane] = area(sweep);
+			leftCounts[plane] = count;
+		}
+		sweep = emptyBox();
+		count = 0;
+		for (int plane = SAH_BINS - 2; plane >= 0; plane--)
+		{
+			grow(sweep, binBoxes[plane + 1]);
+			count += binCounts[plane + 1];
+			if (leftCounts[plane] == 0 || count == 0) {
+				continue;
+			}
+			const float cost = leftAreas[plane] * leftCounts[plane] + area(sweep) * count;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = plane;
+			}
+		}
+	}
+
+	size_t middle = begin + (end - begin) / 2;
+	if (bestAxis >= 0)
+	{
+		const float scale = SAH_BINS / extent[bestAxis];
+		const float minimum = centroidBounds.min[bestAxis];
+		middle = std::partition(items.begin() + begin, items.begin() + end, [=](const BuildItem& item) {
+			return std::min((int)((item.centroid[bestAxis] - minimum) * scale), SAH_BINS - 1) <= bestSplit;
+		}) - items.begin();
+	}
+	// all centroids in one spot: any split is as good as another
+	if (middle == begin || middle == end) {
+		middle = begin + (end - begin) / 2;
+	}
+
+	// the left child directly follows its parent
+	const uint32_t left = buildRange(items, begin, middle, node);
+	const uint32_t right = buildRange(items, middle, end, node);
+	_nodes[node].left = left;
+	_nodes[node].right = right;
+	return node;
+}
+
+uint32_t Bvh::allocateNode()
+{
+	if (!_freeNodes.empty())
+	{
+		const uint32_t node = _freeNodes.back();
+		_freeNodes.pop_back();
+		return node;
+	}
+	_nodes.push_back(Node());
+	_parents.push_back(NONE);
+	return (uint32_t)_nodes.size() - 1;
+}
+
+void Bvh::freeNode(uint32_t node)
+{
+	_freeNodes.push_back(node);
+}
+
+void Bvh::refitAncestors(uint32_t node)
+{
+	for (; node != NONE; node = _parents[node])
+	{
+		const Node& left = _nodes[_nodes[node].left];
+		const Node& right = _nodes[_nodes[node].right];
+		_nodes[node].min = glm::min(left.min, right.min);
+		_nodes[node].max = glm::max(left.max, right.max);
+	}
+}
+
+void Bvh::insert(uint32_t item, const Aabb& box)
+{
+	if (item >= _leafOfItem.size()) {
+		_leafOfItem.resize(item + 1, NONE);
+	}
+	const uint32_t leaf = allocateNode();
+	_nodes[leaf].min = box.min;
+	_nodes[leaf].max = box.max;
+	_nodes[leaf].left = item;
+	_nodes[leaf].right = LEAF;
+	_parents[leaf] = NONE;
+	_leafOfItem[item] = leaf;
+	_itemCount++;
+	_depthFirst = false;
+	if (_root == NONE)
+	{
+		_root = leaf;
+		return;
+	}
+
+	// walk down towards the sibling that costs the least: pairing with a node grows its area, and
+	// every ancestor on the way grows as well ("inherited" cost)
+	uint32_t sibling = _root;
+	while (_nodes[sibling].right != LEAF)
+	{
+		const Node& node = _nodes[sibling];
+		const float nodeArea = area(node.min, node.max);
+		const float combinedArea = area(glm::min(node.min, box.min), glm::max(node.max, box.max));
+		const float pairCost = 2.0f * combinedArea;
+		const float inherited = 2.0f * (combinedArea - nodeArea);
+
+		float childCosts[2];
+		for (int side = 0; side < 2; side++)
+		{
+			const Node& child = _nodes[side == 0 ? node.left : node.right];
+			const float grown = area(glm::min(child.min, box.min), glm::max(child.max, box.max));
+			childCosts[side] = (child.right == LEAF ? grown : grown - area(child.min, child.max)) + inherited;
+		}
+		if (pairCost < childCosts[0] && pairCost < childCosts[1]) {
+			break;
+		}
+		sibling = childCosts[0] < childCosts[1] ? node.left : node.right;
+	}
+
+	const uint32_t oldParent = _parents[sibling];
+	const uint32_t parent = allocateNode();
+	_parents[parent] = oldParent;
+	_nodes[parent].left = sibling;
+	_nodes[parent].right = leaf;
+	_parents[sibling] = parent;
+	_parents[leaf] = parent;
+	if (oldParent == NONE) {
+		_root = parent;
+	}
+	else if (_nodes[oldParent].left == sibling) {
+		_nodes[oldParent].left = parent;
+	}
+	else {
+		_nodes[oldParent].right = parent;
+	}
+	refitAncestors(parent);
+}
+
+void Bvh::remove(uint32_t item)
+{
+	if (item >= _leafOfItem.size() || _leafOfItem[item] == NONE) {
+		return;
+	}
+	const uint32_t leaf = _leafOfItem[item];
+	_leafOfItem[item] = NONE;
+	_itemCount--;
+	_depthFirst = false;
+	freeNode(leaf);
+	if (leaf == _root)
+	{
+		_root = NONE;
+		return;
+	}
+
+	// the sibling takes the parent's place
+	const uint32_t parent = _parents[leaf];
+	const uint32_t grandParent = _parents[parent];
+	const uint32_t sibling = _nodes[parent].left == leaf ? _nodes[parent].right : _nodes[parent].left;
+	freeNode(parent);
+	_parents[sibling] = grandParent;
+	if (grandParent == NONE)
+	{
+		_root = sibling;
+		return;
+	}
+	if (_nodes[grandParent].left == parent) {
+		_nodes[grandParent].left = sibling;
+	}
+	else {
+		_nodes[grandParent].right = sibling;
+	}
+	refitAncestors(grandParent);
+}
+
+void Bvh::setBox(uint32_t item, const Aabb& box)
+{
+	Node& leaf = _nodes[_leafOfItem[item]];
+	leaf.min = box.min;
+	leaf.max = box.max;
+}
+
+void Bvh::refit()
+{
+	if (_root == NONE) {
+		return;
+	}
+
+	// straight from build() children follow their parents, one backwards sweep does it
+	if (_depthFirst)
+	{
+		for (size_t node = _nodes.size(); node-- > 0;)
+		{
+			Node& inner = _nodes[node];
+			if (inner.right != LEAF)
+			{
+				inner.min = glm::min(_nodes[inner.left].min, _nodes[inner.right].min);
+				inner.max = glm::max(_nodes[inner.left].max, _nodes[inner.right].max);
+			}
+		}
+		return;
+	}
+
+	// otherwise children first, in post-order
+	std::vector<uint32_t> stack;
+	std::vector<char> childrenDone(_nodes.size(), 0);
+	stack.push_back(_root);
+	while (!stack.empty())
+	{
+		const uint32_t node = stack.back();
+		Node& inner = _nodes[node];
+		if (inner.right == LEAF)
+		{
+			stack.pop_back();
+			continue;
+		}
+		if (!childrenDone[node])
+		{
+			childrenDone[node] = 1;
+			stack.push_back(inner.left);
+			stack.push_back(inner.right);
+			continue;
+		}
+		inner.min = glm::min(_nodes[inner.left].min, _nodes[inner.right].min);
+		inner.max = glm::max(_nodes[inner.left].max, _nodes[inner.right].max);
+		stack.pop_back();
+	}
+}
+
+void Bvh::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& items) const
+{
+	items.clear();
+	if (_root == NONE) {
+		return;
+	}
+
+	// every entry carries the planes its box is not yet known to be inside of, once there are
+	// none left the whole subtree is visible and is collected without testing
+	const unsigned int ALL_PLANES = (1u << 6) - 1;
+	struct Entry
+	{
+		uint32_t node;
+		unsigned int planes;
+	};
+	std::vector<Entry> stack;
+	stack.reserve(64);
+	stack.push_back({ _root, ALL_PLANES });
+	while (!stack.empty())
+	{
+		Entry entry = stack.back();
+		stack.pop_back();
+		const Node& node = _nodes[entry.node];
+
+		const glm::vec3 center = (node.min + node.max) * 0.5f;
+		const glm::vec3 extent = (node.max - node.min) * 0.5f;
+		bool outside = false;
+		for (int plane = 0; plane < 6 && !outside; plane++)
+		{
+			if (!(entry.planes & (1u << plane))) {
+				continue;
+			}
+			const glm::vec4& p = frustum.planes[plane];
+			const float distance = center.x * p.x + center.y * p.y + center.z * p.z + p.w;
+			const float reach = extent.x * std::abs(p.x) + extent.y * std::abs(p.y) + extent.z * std::abs(p.z);
+			if (distance + reach < 0.0f) {
+				outside = true;
+			}
+			else if (distance - reach >= 0.0f) {
+				entry.planes &= ~(1u << plane);
+			}
+		}
+		if (outside) {
+			continue;
+		}
+
+		if (node.right == LEAF)
+		{
+			items.push_back(node.left);
+			continue;
+		}
+		stack.push_back({ node.left, entry.planes });
+		stack.push_back({ node.right, entry.planes });
+	}
+}
+
+uint32_t Bvh::queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const
+{
+	distance = maxDistance;
+	if (_root == NONE) {
+		return NONE;
+	}
+
+	// a zero component gives an infinite inverse, which the slab test handles
+	const glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	uint32_t hit = NONE;
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	if (rayEntry(_nodes[_root].min, _nodes[_root].max, origin, inverseDirection, maxDistance) >= 0.0f) {
+		stack.push_back(_root);
+	}
+	while (!stack.empty())
+	{
+		const Node& node = _nodes[stack.back()];
+		stack.pop_back();
+		if (node.right == LEAF)
+		{
+			const float entry = rayEntry(node.min, node.max, origin, inverseDirection, distance);
+			if (entry >= 0.0f && (entry < distance || hit == NONE))
+			{
+				distance = entry;
+				hit = node.left;
+			}
+			continue;
+		}
+
+		// the nearer child goes on top, boxes past the best hit so far are skipped
+		const float left = rayEntry(_nodes[node.left].min, _nodes[node.left].max, origin, inverseDirection, distance);
+		const float right = rayEntry(_nodes[node.right].min, _nodes[node.right].max, origin, inverseDirection, distance);
+		if (left >= 0.0f && right >= 0.0f)
+		{
+			stack.push_back(left < right ? node.right : node.left);
+			stack.push_back(left < right ? node.left : node.right);
+		}
+		else if (left >= 0.0f) {
+			stack.push_back(node.left);
+		}
+		else if (right >= 0.0f) {
+			stack.push_back(node.right);
+		}
+	}
+	return hit;
+}
+
+uint32_t Bvh::queryNearest(const glm::vec3& point, float maxDistance, float& distance) const
+{
+	distance = maxDistance;
+	if (_root == NONE) {
+		return NONE;
+	}
+
+	uint32_t nearest = NONE;
+	float bestSquared = maxDistance * maxDistance;
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(_root);
+	while (!stack.empty())
+	{
+		const Node& node = _nodes[stack.back()];
+		stack.pop_back();
+		if (distanceSquared(node.min, node.max, point) > bestSquared) {
+			continue;
+		}
+		if (node.right == LEAF)
+		{
+			bestSquared = distanceSquared(node.min, node.max, point);
+			nearest = node.left;
+			continue;
+		}
+
+		const Node& left = _nodes[node.left];
+		const Node& right = _nodes[node.right];
+		const bool leftFirst = distanceSquared(left.min, left.max, point) < distanceSquared(right.min, right.max, point);
+		stack.push_back(leftFirst ? node.right : node.left);
+		stack.push_back(leftFirst ? node.left : node.right);
+	}
+	if (nearest != NONE) {
+		distance = std::sqrt(bestSquared);
+	}
+	return nearest;
+}
+
+size_t Bvh::size() const
+{
+	return _itemCount;
+}
+
+size_t Bvh::nodeCount() const
+{
+	return _nodes.size() - _freeNodes.size();
+}
+
+float Bvh::sahCost() const
+{
+	if (_root == NONE) {
+		return 0.0f;
+	}
+
+	float total = 0.0f;
+	std::vector<uint32_t> stack(1, _root);
+	while (!stack.empty())
+	{
+		const Node& node = _nodes[stack.back()];
+		stack.pop_back();
+		if (node.right != LEAF)
+		{
+			total += area(node.min, node.max);
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+	}
+	const float rootArea = area(_nodes[_root].min, _nodes[_root].max);
+	return rootArea > 0.0f ? total / rootArea : 0.0f;
+}
+
+void benchmarkBvh(size_t maxObjects)
+{
+	const int QUERIES = 10000;
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	printf("BVH benchmark (%d queries of each kind)\n", QUERIES);
+	printf("  %9s %9s %9s %9s %9s %11s %11s %11s %11s\n", "objects", "build ms", "refit ms", "insert us", "remove us", "frustum ms", "flat ms", "rays/ms", "nearest/ms");
+	for (size_t count = 10000; count <= maxObjects; count *= 10)
+	{
+		// unit sized boxes at the same density whatever the count
+		const float side = std::cbrt((float)count) * 4.0f;
+		std::vector<Aabb> boxes(count);
+		for (Aabb& box : boxes)
+		{
+			const glm::vec3 center(unit(random) * side, unit(random) * side, unit(random) * side);
+			const glm::vec3 half(0.25f + unit(random) * 0.5f);
+			box = { center - half, center + half };
+		}
+
+		Bvh bvh;
+		auto start = std::chrono::steady_clock::now();
+		bvh.build(boxes);
+		const double buildTime = millisecondsSince(start);
+
+		for (uint32_t item = 0; item < count; item++)
+		{
+			const glm::vec3 move(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f);
+			boxes[item] = { boxes[item].min + move, boxes[item].max + move };
+			bvh.setBox(item, boxes[item]);
+		}
+		start = std::chrono::steady_clock::now();
+		bvh.refit();
+		const double refitTime = millisecondsSince(start);
+
+		// remove and insert back 1% of the objects
+		const size_t edits = count / 100;
+		start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < edits; i++) {
+			bvh.remove((uint32_t)(i * 97 % count));
+		}
+		const double removeTime = millisecondsSince(start) * 1000.0 / edits;
+		start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < edits; i++) {
+			bvh.insert((uint32_t)(i * 97 % count), boxes[i * 97 % count]);
+		}
+		const double insertTime = millisecondsSince(start) * 1000.0 / edits;
+
+		// a camera in the middle of the scene, looking somewhere random each query
+		WorldBoxes flat;
+		for (const Aabb& box : boxes)
+		{
+			flat.centerX.push_back((box.min.x + box.max.x) * 0.5f);
+			flat.centerY.push_back((box.min.y + box.max.y) * 0.5f);
+			flat.centerZ.push_back((box.min.z + box.max.z) * 0.5f);
+			flat.extentX.push_back((box.max.x - box.min.x) * 0.5f);
+			flat.extentY.push_back((box.max.y - box.min.y) * 0.5f);
+			flat.extentZ.push_back((box.max.z - box.min.z) * 0.5f);
+		}
+		for (std::vector<float>* axis : { &flat.centerX, &flat.centerY, &flat.centerZ, &flat.extentX, &flat.extentY, &flat.extentZ }) {
+			axis->resize((count + WorldBoxes::WIDTH - 1) / WorldBoxes::WIDTH * WorldBoxes::WIDTH, 0.0f);
+		}
+		const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, side * 0.25f);
+		const glm::vec3 eye(side * 0.5f);
+		const int FRUSTUM_QUERIES = 100;
+		std::vector<Frustum> frustums;
+		for (int i = 0; i < FRUSTUM_QUERIES; i++)
+		{
+			const glm::vec3 target = eye + glm::vec3(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f);
+			frustums.push_back(frustumFromMatrix(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f))));
+		}
+		std::vector<uint32_t> found;
+		start = std::chrono::steady_clock::now();
+		for (const Frustum& frustum : frustums) {
+			bvh.queryFrustum(frustum, found);
+		}
+		const double frustumTime = millisecondsSince(start) / FRUSTUM_QUERIES;
+		std::vector<char> visible;
+		start = std::chrono::steady_clock::now();
+		for (const Frustum& frustum : frustums) {
+			cullBoxes(frustum, flat, count, visible);
+		}
+		const double flatTime = millisecondsSince(start) / FRUSTUM_QUERIES;
+
+		float distance = 0.0f;
+		size_t hits = 0;
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < QUERIES; i++)
+		{
+			const glm::vec3 origin(unit(random) * side, unit(random) * side, unit(random) * side);
+			const glm::vec3 direction(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f);
+			hits += bvh.queryRay(origin, direction, side, distance) != Bvh::NONE;
+		}
+		const double rayRate = QUERIES / millisecondsSince(start);
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < QUERIES; i++)
+		{
+			const glm::vec3 point(unit(random) * side, unit(random) * side, unit(random) * side);
+			hits += bvh.queryNearest(point, side, distance) != Bvh::NONE;
+		}
+		const double nearestRate = QUERIES / millisecondsSince(start);
+
+		printf("  %9zu %9.2f %9.2f %9.2f %9.2f %11.3f %11.3f %11.0f %11.0f\n", count, buildTime, refitTime, insertTime, removeTime, frustumTime, flatTime, rayRate, nearestRate);
+		printf("            (%zu nodes, SAH cost %.1f, %zu hits)\n", bvh.nodeCount(), bvh.sahCost(), hits);
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+// STL
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Project
+#include "bounds.h"
+#include "frustumCulling.h"
+
+/**
+  Dynamic bounding volume hierarchy over world space boxes, one item per leaf. build() makes a
+  binned surface area heuristic (SAH) tree in depth-first order, so that a traversal walks the
+  node array mostly forwards. Items can then be inserted (next to the sibling that grows the
+  tree's surface area the least), removed, or moved and refit, without a full rebuild.
+  Nodes are 32 bytes, two per cache line; parent links are kept apart since queries never use them.
+*/
+class Bvh
+{
+public:
+	static const uint32_t NONE = ~0u;
+
+	/** \brief Replaces the tree with one over the given boxes.
+	*   \param boxes Box of every item, the item ID is its index
+	*/
+	void build(const std::vector<Aabb>& boxes);
+
+	/** \brief Adds an item.
+	*   \param item ID of the item, not in the tree yet
+	*   \param box  World space box
+	*/
+	void insert(uint32_t item, const Aabb& box);
+
+	/** \brief Removes an item, the tree around it is collapsed.
+	*   \param item ID of an item in the tree
+	*/
+	void remove(uint32_t item);
+
+	/** \brief Moves an item. The boxes of its ancestors are only updated by the next refit().
+	*   \param item ID of an item in the tree
+	*   \param box  New world space box
+	*/
+	void setBox(uint32_t item, const Aabb& box);
+
+	//* \brief Recomputes the boxes of all inner nodes from their children, after items were moved.
+	void refit();
+
+	/** \brief Finds the items whose box intersects a frustum.
+	*   \param frustum Frustum, from frustumFromMatrix()
+	*   \param items   Receives the IDs of the items found (cleared first)
+	*/
+	void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& items) const;
+
+	/** \brief Finds the item whose box a ray enters first.
+	*   \param origin      Start of the ray
+	*   \param direction   Direction of the ray, need not be normalized
+	*   \param maxDistance Ray length, in multiples of direction
+	*   \param distance    Receives the distance to the box hit, 0 when the origin is inside it
+	*   \return ID of the item hit, or NONE.
+	*/
+	uint32_t queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const;
+
+	/** \brief Finds the item whose box is nearest to a point.
+	*   \param point       Point
+	*   \param maxDistance Items farther than this are ignored
+	*   \param distance    Receives the distance to the box found, 0 when the point is inside it
+	*   \return ID of the item found, or NONE.
+	*/
+	uint32_t queryNearest(const glm::vec3& point, float maxDistance, float& distance) const;
+
+	/** \brief Gets number of items in the tree. */
+	size_t size() const;
+
+	/** \brief Gets number of nodes in use. */
+	size_t nodeCount() const;
+
+	/** \brief Gets the SAH cost of the tree (sum of inner node surface areas relative to the root's), to decide when a rebuild pays off. */
+	float sahCost() const;
+
+private:
+	struct Node
+	{
+		glm::vec3 min;
+		uint32_t left; //!< First child, or the item of a leaf
+		glm::vec3 max;
+		uint32_t right; //!< Second child, or LEAF
+	};
+	static const uint32_t LEAF = ~0u;
+
+	struct BuildItem
+	{
+		Aabb box;
+		glm::vec3 centroid;
+		uint32_t item;
+	};
+
+	uint32_t buildRange(std::vector<BuildItem>& items, size_t begin, size_t end, uint32_t parent);
+	uint32_t allocateNode();
+	void freeNode(uint32_t node);
+	void refitAncestors(uint32_t node);
+
+	std::vector<Node> _nodes;
+	std::vector<uint32_t> _parents; //! Per node
+	std::vector<uint32_t> _leafOfItem; //! Per item ID, NONE for IDs not in the tree
+	std::vector<uint32_t> _freeNodes;
+	uint32_t _root = NONE;
+	size_t _itemCount = 0;
+	bool _depthFirst = true; //! Children come after their parents in _nodes, true after build() until the tree is edited
+};
+
+/** \brief Times building, refitting, editing and querying a Bvh over random boxes and prints the results.
+*   \param maxObjects Largest scene size, sizes from 10k grow tenfold up to it
+*/
+void benchmarkBvh(size_t maxObjects);
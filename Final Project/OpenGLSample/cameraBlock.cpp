@@ -0,0 +1,62 @@
+// STL
+#include <cstring>
+#include <iostream>
+
+// Project
+#include "cameraBlock.h"
+#include "resourceTracker.h"
+
+CameraBlock::CameraBlock(int maxFramesInFlight)
+{
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment > 0) {
+		_offsetAlignment = (size_t)alignment;
+	}
+	_buffer.createStreamingVBO(GL_UNIFORM_BUFFER, sizeof(Data), maxFramesInFlight + 1, RESOURCE_SITE);
+}
+
+CameraBlock::~CameraBlock()
+{
+	_buffer.deleteVBO();
+}
+
+void CameraBlock::beginFrame()
+{
+	_buffer.beginStreamingFrame();
+}
+
+void CameraBlock::latch(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPosition, const SpotLight& spotLight)
+{
+	Data data;
+	data.view = view;
+	data.projection = projection;
+	data.inverseView = glm::inverse(view);
+	data.viewPosition = glm::vec4(viewPosition, 1.0f);
+	data.spotLightPosition = glm::vec4(spotLight.position, 1.0f);
+	data.spotLightDirection = glm::vec4(spotLight.direction, 0.0f);
+
+	size_t offset = 0;
+	void* destination = _buffer.allocateStreamingData(sizeof(Data), _offsetAlignment, offset);
+	if (destination == nullptr)
+	{
+		std::cout << "ERROR::CAMERA_BLOCK: no room left in the frame's region, latch() is meant once per frame" << std::endl;
+		return;
+	}
+	memcpy(destination, &data, sizeof(Data));
+	_buffer.flushStreamingData();
+	glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, _buffer.getBufferID(), (GLintptr)offset, sizeof(Data));
+}
+
+void CameraBlock::endFrame()
+{
+	_buffer.endStreamingFrame();
+}
+
+void CameraBlock::bind(const Shader& shader)
+{
+	const GLuint index = glGetUniformBlockIndex(shader.ID, "Camera");
+	if (index != GL_INVALID_INDEX) {
+		glUniformBlockBinding(shader.ID, index, BINDING);
+	}
+}
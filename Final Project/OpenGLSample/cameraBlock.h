@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Project
+#include "lighting.h"
+#include "shader.h"
+#include "vertextBufferObject.h"
+
+/**
+  The camera as the scene shaders see it: the std140 uniform block "Camera" (view and projection
+  matrices, eye position, the flashlight that follows the camera) that the forward, depth pre-pass,
+  G-buffer, deferred lighting and occlusion box programs share.
+  The block is written once per frame through a streaming ring, as late as it can be: latch() goes
+  right before the first draw, after culling, light binning and draw sorting, with the input polled
+  again just before it. Mouse-look thus reaches the screen with the frame's CPU work taken out of
+  the latency. What the CPU decided earlier in the frame (frustum and software occlusion culling,
+  draw order, light clusters) used the camera of the frame start, at most the mouse movement of
+  one frame behind: an object can pop in a frame late at the screen edges or from behind an
+  occluder's silhouette. The light clusters are looked up with the view they were binned with
+  (LightClusters::bind()), not with this block's. Everything tested on the GPU (depth pre-pass,
+  occlusion query boxes) reads this block, so it agrees with the depth buffer it is tested against.
+*/
+class CameraBlock
+{
+public:
+	/** \brief Creates the streaming ring of the block.
+	*   \param maxFramesInFlight Frames the CPU may be ahead of the GPU (see FramePacer), the ring has one region more so writing never waits
+	*/
+	explicit CameraBlock(int maxFramesInFlight);
+	~CameraBlock();
+
+	//* \brief Starts a frame, before anything of it uses the block. Waits if the GPU still reads the region it reuses.
+	void beginFrame();
+
+	/** \brief Writes the camera of the frame and binds it for the draws that follow.
+	*   \param view         View matrix
+	*   \param projection   Projection matrix
+	*   \param viewPosition World space camera position
+	*   \param spotLight    The flashlight, its position and direction go to the block
+	*/
+	void latch(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPosition, const SpotLight& spotLight);
+
+	//* \brief Ends a frame, after the last draw that reads the block.
+	void endFrame();
+
+	/** \brief Connects a program's Camera block to the binding point latch() binds to. Call it when the program
+	*   is first used in a frame: a (re)linked program, or one loaded from the program cache, starts unconnected.
+	*   \param shader Program declaring the block, it does not have to be in use
+	*/
+	static void bind(const Shader& shader);
+
+	static const GLuint BINDING = 0; //!< Uniform buffer binding point of the block
+
+private:
+	CameraBlock(const CameraBlock&) = delete;
+	CameraBlock& operator=(const CameraBlock&) = delete;
+
+	// std140 layout of the block, vec3s take a vec4 each
+	struct Data
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::mat4 inverseView;
+		glm::vec4 viewPosition;
+		glm::vec4 spotLightPosition;
+		glm::vec4 spotLightDirection;
+	};
+
+	VertexBufferObject _buffer;
+	size_t _offsetAlignment = 256; //! GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+};
@@ -1,12 +1,11 @@
-// STL
-#include <vector>
-
 // GLM
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
 // Project
 #include "cylinder.h"
+#include "arena.h"
+#include "resourceTracker.h"
 
 
 
@@ -36,6 +35,21 @@ namespace static_meshes_3D {
 		return _height;
 	}
 
+	GLuint Cylinder::getVertexArray() const
+	{
+		return _vao;
+	}
+
+	int Cylinder::getNumVerticesSide() const
+	{
+		return _numVerticesSide;
+	}
+
+	int Cylinder::getNumVerticesTopBottom() const
+	{
+		return _numVerticesTopBottom;
+	}
+
 	void Cylinder::initializeData()
 	{
 		if (_isInitialized) {
@@ -47,19 +61,24 @@ namespace static_meshes_3D {
 		_numVerticesTopBottom = _numSlices + 2;
 		_numVerticesTotal = _numVerticesSide + _numVerticesTopBottom * 2;
 
+		// Everything below is built in this thread's arena and released after the upload
+		Arena& arena = Arena::threadArena();
+		ArenaScope arenaScope(arena);
+
 		// Generate VAO and VBO for vertex attributes
-		glGenVertexArrays(1, &_vao);
+		trackedGenVertexArrays(1, &_vao);
 		glBindVertexArray(_vao);
-		_vbo.createVBO(getVertexByteSize() * _numVerticesTotal);
+		_vbo.createVBO(getVertexByteSize() * _numVerticesTotal, RESOURCE_SITE);
 
 		// Pre-calculate sines / cosines for given number of slices
 		const auto sliceAngleStep = 2.0f * glm::pi<float>() / float(_numSlices);
 		auto currentSliceAngle = 0.0f;
-		std::vector<float> sines, cosines;
+		float* sines = arena.allocateArray<float>(_numSlices + 1);
+		float* cosines = arena.allocateArray<float>(_numSlices + 1);
 		for (auto i = 0; i <= _numSlices; i++)
 		{
-			sines.push_back(sin(currentSliceAngle));
-			cosines.push_back(cos(currentSliceAngle));
+			sines[i] = sin(currentSliceAngle);
+			cosines[i] = cos(currentSliceAngle);
 
 			// Update slice angle
 			currentSliceAngle += sliceAngleStep;
@@ -68,12 +87,12 @@ namespace static_meshes_3D {
 		if (hasPositions())
 		{
 			// Pre-calculate X and Z coordinates
-			std::vector<float> x;
-			std::vector<float> z;
+			float* x = arena.allocateArray<float>(_numSlices + 1);
+			float* z = arena.allocateArray<float>(_numSlices + 1);
 			for (auto i = 0; i <= _numSlices; i++)
 			{
-				x.push_back(cosines[i] * _radius);
-				z.push_back(sines[i] * _radius);
+				x[i] = cosines[i] * _radius;
+				z[i] = sines[i] * _radius;
 			}
 
 			// Add cylinder side vertices
@@ -30,6 +30,21 @@ namespace static_meshes_3D {
 		 */
 		float getHeight() const;
 
+		/**
+		 * Gets the vertex array render() draws from.
+		 */
+		GLuint getVertexArray() const;
+
+		/**
+		 * Gets number of vertices of the side (one triangle strip, drawn first).
+		 */
+		int getNumVerticesSide() const;
+
+		/**
+		 * Gets number of vertices of the top and of the bottom cover (one triangle fan each, after the side).
+		 */
+		int getNumVerticesTopBottom() const;
+
 	private:
 		float _radius; // Cylinder radius (distance from the center of cylinder to surface)
 		int _numSlices; // Number of cylinder slices
@@ -0,0 +1,191 @@
+// STL
+#include <iostream>
+
+// Project
+#include "deferredShading.h"
+#include "cameraBlock.h"
+#include "shaderBatch.h"
+#include "shaderReloader.h"
+#include "resourceTracker.h"
+
+DeferredShading::DeferredShading(ShaderReloader* reloader)
+	: _geometry("shaderfiles/8.1.g_buffer.vs", "shaderfiles/8.1.g_buffer.fs", { { "HAS_SPECULAR_MAP", LIGHTING_SPECULAR_MAP } }, RESOURCE_SITE, reloader)
+{
+	ShaderBatch batch(RESOURCE_SITE);
+	batch.add(_lighting, "shaderfiles/8.1.deferred_shading.vs", "shaderfiles/8.1.deferred_shading.fs");
+	batch.build();
+	_geometry.precompile({ 0, LIGHTING_SPECULAR_MAP });
+	if (reloader != nullptr) {
+		reloader->watch(_lighting, "shaderfiles/8.1.deferred_shading.vs", "shaderfiles/8.1.deferred_shading.fs");
+	}
+
+	trackedGenVertexArrays(1, &_emptyVertexArray);
+}
+
+DeferredShading::~DeferredShading()
+{
+	release();
+	trackedDeleteVertexArrays(1, &_emptyVertexArray);
+}
+
+bool DeferredShading::beginFrame(int width, int height, const glm::mat4& projection)
+{
+	if ((width != _width || height != _height) && !resize(width, height)) {
+		return false;
+	}
+	_projection = projection;
+	_frameIndex++;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+	glViewport(0, 0, _width, _height);
+	// zero view depth marks pixels nothing was drawn to
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	return true;
+}
+
+void DeferredShading::useGeometry(const ObjectTransform& object, bool hasSpecularMap)
+{
+	ShaderPermutations::Variant& variant = _geometry.get(hasSpecularMap ? LIGHTING_SPECULAR_MAP : 0);
+	variant.shader.use();
+	if (variant.lastFrame != _frameIndex)
+	{
+		variant.shader.setInt("material.diffuse", 0);
+		variant.shader.setInt("material.specular", 1);
+		CameraBlock::bind(variant.shader);
+		variant.lastFrame = _frameIndex;
+	}
+	variant.shader.setMat4("model", object.model);
+	variant.shader.setMat3("normalMatrix", object.normalMatrix);
+}
+
+void DeferredShading::shade(const SceneLights& lights, const LightClusters& clusters)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, _width, _height);
+	if (_lighting.ID == 0) {
+		return;
+	}
+
+	// every pixel is lit once, depth is neither tested nor written
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+
+	_lighting.use();
+	CameraBlock::bind(_lighting);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, _albedoSpecular);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, _normal);
+	glActiveTexture(GL_TEXTURE0 + VIEW_DEPTH_UNIT);
+	glBindTexture(GL_TEXTURE_2D, _viewDepth);
+	_lighting.setInt("gAlbedoSpecular", 0);
+	_lighting.setInt("gNormal", 1);
+	_lighting.setInt("gViewDepth", VIEW_DEPTH_UNIT);
+	_lighting.setMat4("inverseProjection", glm::inverse(_projection));
+	_lighting.setVec2("viewportSize", glm::vec2((float)_width, (float)_height));
+	_lighting.setFloat("shininess", 32.0f);
+
+	_lighting.setVec3("dirLight.direction", lights.dirLight.direction);
+	_lighting.setVec3("dirLight.ambient", lights.dirLight.ambient);
+	_lighting.setVec3("dirLight.diffuse", lights.dirLight.diffuse);
+	_lighting.setVec3("dirLight.specular", lights.dirLight.specular);
+
+	const SpotLight& spotLight = lights.spotLight;
+	_lighting.setBool("spotLightOn", lights.spotLightOn);
+	_lighting.setVec3("spotLight.ambient", spotLight.ambient);
+	_lighting.setVec3("spotLight.diffuse", spotLight.diffuse);
+	_lighting.setVec3("spotLight.specular", spotLight.specular);
+	_lighting.setFloat("spotLight.constant", spotLight.constant);
+	_lighting.setFloat("spotLight.linear", spotLight.linear);
+	_lighting.setFloat("spotLight.quadratic", spotLight.quadratic);
+	_lighting.setFloat("spotLight.cutOff", spotLight.cutOff);
+	_lighting.setFloat("spotLight.outerCutOff", spotLight.outerCutOff);
+
+	clusters.bind(_lighting);
+
+	glBindVertexArray(_emptyVertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	// the G-buffer must not stay bound while the next geometry pass renders into it
+	glActiveTexture(GL_TEXTURE0 + VIEW_DEPTH_UNIT);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+}
+
+void DeferredShading::blitDepth()
+{
+	if (_framebuffer == 0) {
+		return;
+	}
+	// the formats have to match for a depth blit, the default framebuffer is depth 24 + stencil 8 too
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, _framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, _width, _height, 0, 0, _width, _height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+bool DeferredShading::resize(int width, int height)
+{
+	release();
+	if (width <= 0 || height <= 0) {
+		return false; // minimized
+	}
+
+	glGenFramebuffers(1, &_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+
+	const GLenum internalFormats[3] = { GL_RGBA8, GL_RG16F, GL_R32F };
+	const GLenum formats[3] = { GL_RGBA, GL_RG, GL_RED };
+	const GLenum types[3] = { GL_UNSIGNED_BYTE, GL_HALF_FLOAT, GL_FLOAT };
+	GLuint* targets[3] = { &_albedoSpecular, &_normal, &_viewDepth };
+	for (int i = 0; i < 3; i++)
+	{
+		trackedGenTextures(1, targets[i]);
+		glBindTexture(GL_TEXTURE_2D, *targets[i]);
+		trackedTexImage2D(GL_TEXTURE_2D, 0, internalFormats[i], width, height, 0, formats[i], types[i], nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, *targets[i], 0);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// depth is tested during the geometry pass and blitted for the translucent draws, never sampled
+	trackedGenRenderbuffers(1, &_depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, _depth);
+	trackedRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, _depth);
+
+	const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	glDrawBuffers(3, drawBuffers);
+
+	const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::DEFERRED_SHADING: G-buffer incomplete (0x" << std::hex << status << std::dec << ")" << std::endl;
+		release();
+		return false;
+	}
+
+	_width = width;
+	_height = height;
+	return true;
+}
+
+void DeferredShading::release()
+{
+	glDeleteFramebuffers(1, &_framebuffer);
+	trackedDeleteTextures(1, &_albedoSpecular);
+	trackedDeleteTextures(1, &_normal);
+	trackedDeleteTextures(1, &_viewDepth);
+	trackedDeleteRenderbuffers(1, &_depth);
+	_framebuffer = _albedoSpecular = _normal = _viewDepth = _depth = 0;
+	_width = _height = 0;
+}
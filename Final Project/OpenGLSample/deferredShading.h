@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Project
+#include "lightClusters.h"
+#include "lighting.h"
+#include "shader.h"
+#include "shaderPermutations.h"
+#include "transformTable.h"
+
+class ShaderReloader;
+
+/**
+  Deferred renderer. The geometry pass writes what lighting needs into a compact G-buffer
+  (RGBA8 albedo + specular intensity, RG16F octahedral normal, R32F view depth, 12 bytes per
+  pixel), then one full-screen pass lights every visible pixel exactly once with the
+  directional light, the spot light and the point lights of the pixel's cluster. Shading
+  cost therefore follows the number of pixels, not the overdraw of the scene. The view depth
+  is stored in the G-buffer rather than read from the depth buffer, whose values depend on the
+  depth slice of the pixel's layer (see RenderLayers).
+  The G-buffer holds one surface per pixel, so translucent draws stay out of it: they are
+  forward shaded over the lit result, tested against the depth blitDepth() copies over.
+*/
+class DeferredShading
+{
+public:
+	/** \brief Compiles the G-buffer and lighting programs. The G-buffer is allocated by the first beginFrame().
+	*   \param reloader Optional, the programs are hot-reloaded when their files change
+	*/
+	explicit DeferredShading(ShaderReloader* reloader = nullptr);
+	~DeferredShading();
+
+	/** \brief Binds and clears the G-buffer, resizing it first if the framebuffer size changed.
+	*   Both passes read the view from the Camera block, see CameraBlock.
+	*   \param width      Framebuffer width in pixels
+	*   \param height     Framebuffer height in pixels
+	*   \param projection Projection matrix of the frame
+	*   \return True if the G-buffer is usable or false otherwise (the frame then renders nothing).
+	*/
+	bool beginFrame(int width, int height, const glm::mat4& projection);
+
+	/** \brief Makes the G-buffer program current for an object and sets its uniforms.
+	*   \param object         Transform of the object
+	*   \param hasSpecularMap True if a specular map is bound for the object (texture unit 1)
+	*/
+	void useGeometry(const ObjectTransform& object, bool hasSpecularMap);
+
+	/** \brief Lights the G-buffer into the default framebuffer.
+	*   \param lights   All lights of the scene
+	*   \param clusters Point lights binned for this frame's view
+	*/
+	void shade(const SceneLights& lights, const LightClusters& clusters);
+
+	//* \brief Copies the depth of the geometry pass into the default framebuffer, for the draws forward shaded after shade().
+	void blitDepth();
+
+private:
+	DeferredShading(const DeferredShading&) = delete;
+	DeferredShading& operator=(const DeferredShading&) = delete;
+
+	static const int VIEW_DEPTH_UNIT = LightClusters::FIRST_TEXTURE_UNIT + 3; //!< Units 0 and 1 take albedo and normal, the clusters the next three
+
+	bool resize(int width, int height);
+	void release();
+
+	ShaderPermutations _geometry;
+	Shader _lighting;
+	GLuint _framebuffer = 0;
+	GLuint _albedoSpecular = 0;
+	GLuint _normal = 0;
+	GLuint _viewDepth = 0;
+	GLuint _depth = 0;
+	GLuint _emptyVertexArray = 0; //! Core profile needs a vertex array bound even without attributes
+	int _width = 0;
+	int _height = 0;
+	glm::mat4 _projection;
+	unsigned int _frameIndex = 0;
+};
@@ -0,0 +1,151 @@
+// STL
+#include <algorithm>
+
+// Project
+#include "depthPrepass.h"
+#include "cameraBlock.h"
+#include "shaderBatch.h"
+#include "shaderReloader.h"
+#include "resourceTracker.h"
+
+namespace {
+
+	const size_t INVALID_MESH = ~(size_t)0;
+}
+
+DepthPrepass::DepthPrepass(ShaderReloader* reloader)
+{
+	ShaderBatch batch(RESOURCE_SITE);
+	batch.add(_shader, "shaderfiles/depth_prepass.vs", "shaderfiles/depth_prepass.fs");
+	batch.build();
+	if (reloader != nullptr) {
+		reloader->watch(_shader, "shaderfiles/depth_prepass.vs", "shaderfiles/depth_prepass.fs");
+	}
+
+	trackedGenVertexArrays(1, &_vertexArray);
+	trackedGenBuffers(2, _buffers);
+}
+
+DepthPrepass::~DepthPrepass()
+{
+	trackedDeleteBuffers(2, _buffers);
+	trackedDeleteVertexArrays(1, &_vertexArray);
+}
+
+size_t DepthPrepass::addMesh(const MeshDraw& mesh)
+{
+	return mesh.indexCount > 0 ? addElements(mesh) : addArrays(mesh);
+}
+
+size_t DepthPrepass::addArrays(const MeshDraw& mesh)
+{
+	const std::vector<DrawRange>& ranges = mesh.ranges;
+	GLint first = ranges.empty() ? 0 : ranges[0].first;
+	GLint last = first;
+	for (const DrawRange& range : ranges)
+	{
+		first = std::min(first, range.first);
+		last = std::max(last, range.first + range.count);
+	}
+
+	std::vector<float> positions;
+	if (last <= first || !readVertexPositions(mesh.vertexArray, first, last - first, positions)) {
+		return INVALID_MESH;
+	}
+
+	Mesh added;
+	const GLint base = (GLint)(_positions.size() / 3);
+	for (DrawRange range : ranges)
+	{
+		range.first += base - first;
+		added.ranges.push_back(range);
+	}
+	_positions.insert(_positions.end(), positions.begin(), positions.end());
+	_meshes.push_back(added);
+	return _meshes.size() - 1;
+}
+
+size_t DepthPrepass::addElements(const MeshDraw& mesh)
+{
+	std::vector<GLuint> indices;
+	if (!readMeshIndices(mesh, indices)) {
+		return INVALID_MESH;
+	}
+	const GLuint lowest = *std::min_element(indices.begin(), indices.end());
+	const GLuint highest = *std::max_element(indices.begin(), indices.end());
+
+	std::vector<float> positions;
+	if (!readVertexPositions(mesh.vertexArray, (GLint)lowest, (GLsizei)(highest - lowest + 1), positions)) {
+		return INVALID_MESH;
+	}
+
+	// indices are rebased to the shared stream and widened, so every mesh draws from one element buffer
+	Mesh added;
+	added.mode = mesh.mode;
+	added.indexCount = (GLsizei)indices.size();
+	added.indexByteOffset = _indices.size() * sizeof(GLuint);
+	const GLuint base = (GLuint)(_positions.size() / 3);
+	for (GLuint index : indices) {
+		_indices.push_back(index - lowest + base);
+	}
+	_positions.insert(_positions.end(), positions.begin(), positions.end());
+	_meshes.push_back(added);
+	return _meshes.size() - 1;
+}
+
+void DepthPrepass::finish()
+{
+	glBindVertexArray(_vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, _buffers[0]);
+	trackedBufferData(GL_ARRAY_BUFFER, _positions.size() * sizeof(float), _positions.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _buffers[1]);
+	trackedBufferData(GL_ELEMENT_ARRAY_BUFFER, _indices.size() * sizeof(GLuint), _indices.data(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+
+	_positions.clear();
+	_positions.shrink_to_fit();
+	_indices.clear();
+	_indices.shrink_to_fit();
+}
+
+void DepthPrepass::begin()
+{
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+
+	_shader.use();
+	CameraBlock::bind(_shader);
+	glBindVertexArray(_vertexArray);
+}
+
+void DepthPrepass::draw(size_t mesh, const glm::mat4& model)
+{
+	if (mesh >= _meshes.size()) {
+		return;
+	}
+
+	_shader.setMat4("model", model);
+	const Mesh& drawn = _meshes[mesh];
+	if (drawn.indexCount > 0) {
+		glDrawElements(drawn.mode, drawn.indexCount, GL_UNSIGNED_INT, (void*)drawn.indexByteOffset);
+	}
+	for (const DrawRange& range : drawn.ranges) {
+		glDrawArrays(range.mode, range.first, range.count);
+	}
+}
+
+void DepthPrepass::end()
+{
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask(GL_FALSE);
+	glDepthFunc(GL_EQUAL);
+}
+
+void DepthPrepass::restoreDepthState()
+{
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+// STL
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Project
+#include "meshDraw.h"
+#include "shader.h"
+
+class ShaderReloader;
+
+/**
+  Depth pre-pass. Every mesh registered here gets a copy of its positions in one tightly
+  packed position-only vertex stream (12 bytes per vertex, shared by all meshes), drawn with
+  a shader that writes depth only. The shading pass that follows tests with GL_EQUAL and does
+  not write depth, so the expensive fragment shader runs once per visible pixel instead of
+  once per fragment that happens to be in front at the time it is drawn.
+  The position computation of depth_prepass.vs has to match the shading vertex shaders
+  operation for operation (both declare gl_Position invariant), or GL_EQUAL fails.
+*/
+class DepthPrepass
+{
+public:
+	/** \brief Compiles the depth-only program, meshes are added afterwards.
+	*   \param reloader Optional, the program is hot-reloaded when its files change
+	*/
+	explicit DepthPrepass(ShaderReloader* reloader = nullptr);
+	~DepthPrepass();
+
+	/** \brief Registers a mesh. Its positions (and indices) are read back from the buffers of its vertex array.
+	*   \param mesh How the mesh is drawn, vertex attribute 0 has to hold 3 float positions
+	*   \return Mesh ID, or ~0 if the data could not be read.
+	*/
+	size_t addMesh(const MeshDraw& mesh);
+
+	/** \brief Uploads the meshes added so far. Call it once after the last add.
+	*/
+	void finish();
+
+	/** \brief Starts the pass: depth only, colour writes off. The camera is the one latched in the Camera block,
+	*   the same the shading pass reads.
+	*/
+	void begin();
+
+	/** \brief Draws a mesh's depth.
+	*   \param mesh  ID returned by addMesh()
+	*   \param model Model matrix, the one the shading pass uses
+	*/
+	void draw(size_t mesh, const glm::mat4& model);
+
+	//* \brief Ends the pass and sets up depth state for shading: GL_EQUAL, no depth writes.
+	void end();
+
+	//* \brief Restores the default depth state (GL_LESS, depth writes on) once the shading pass is done.
+	static void restoreDepthState();
+
+private:
+	DepthPrepass(const DepthPrepass&) = delete;
+	DepthPrepass& operator=(const DepthPrepass&) = delete;
+
+	struct Mesh
+	{
+		std::vector<DrawRange> ranges; //!< Rebased to the shared stream, empty for indexed meshes
+		GLenum mode = GL_TRIANGLES;
+		GLsizei indexCount = 0;
+		size_t indexByteOffset = 0; //!< Into the shared element buffer
+	};
+
+	size_t addArrays(const MeshDraw& mesh);
+	size_t addElements(const MeshDraw& mesh);
+
+	Shader _shader;
+	std::vector<Mesh> _meshes;
+	std::vector<float> _positions; //! Staging until finish()
+	std::vector<GLuint> _indices;
+	GLuint _vertexArray = 0;
+	GLuint _buffers[2] = {};
+};
@@ -0,0 +1,46 @@
+// STL
+#include <chrono>
+
+// Project
+#include "drawList.h"
+#include "parallel.h"
+
+namespace {
+
+	// Packets one job fills at least, filling one is a light selection and a few matrix copies
+	const size_t MIN_DRAWS_PER_THREAD = 128;
+}
+
+const std::vector<const DrawPacket*>& DrawList::build(size_t drawCount, const std::function<void(size_t, DrawPacket&)>& fill)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	_packets.resize(drawCount);
+	_keys.resize(drawCount);
+	parallelFor(drawCount, MIN_DRAWS_PER_THREAD, [&](size_t begin, size_t end) {
+		for (size_t draw = begin; draw < end; draw++)
+		{
+			DrawPacket& packet = _packets[draw];
+			packet.draw = (uint32_t)draw;
+			fill(draw, packet);
+			_keys[draw] = packet.sortKey;
+		}
+	});
+
+	_sorted.clear();
+	for (size_t draw : _order.sort(_keys))
+	{
+		if (_keys[draw] == NOT_DRAWN) {
+			break;
+		}
+		_sorted.push_back(&_packets[draw]);
+	}
+
+	_lastBuildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return _sorted;
+}
+
+double DrawList::lastBuildMilliseconds() const
+{
+	return _lastBuildMilliseconds;
+}
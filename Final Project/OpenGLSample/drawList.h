@@ -0,0 +1,58 @@
+#pragma once
+
+// STL
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Project
+#include "drawOrder.h"
+#include "lighting.h"
+
+// Sort key of a draw that is not drawn this frame (culled), sorts after every other draw
+const uint64_t NOT_DRAWN = ~(uint64_t)0;
+
+//* \brief Everything the GL thread needs to issue one draw, worked out beforehand on any thread.
+struct DrawPacket
+{
+	uint64_t sortKey; //!< From drawSortKey(), or NOT_DRAWN
+	uint32_t draw; //!< Index of the draw the packet is for
+	uint32_t lightingFeatures; //!< Lighting variant, see selectLighting()
+	uint64_t pointLightKey; //!< pointLightSelectionKey() of the point lights below
+	int pointLightCount;
+	int pointLights[MAX_POINT_LIGHTS_PER_DRAW];
+	glm::mat4 model;
+	glm::mat3 normalMatrix;
+};
+
+/**
+  A frame's draws as packets, built in parallel and replayed in order by the thread that owns
+  the GL context. The draws are split in ranges across the job system and every range fills the
+  packets of its own draws, so there is nothing to lock and the merge is the sort: packets are
+  ordered by key with DrawOrder (nearly sorted from the frame before), and the ones not drawn
+  end up last and are left out.
+*/
+class DrawList
+{
+public:
+	/** \brief Builds the packets of a frame.
+	*   \param drawCount Number of draws
+	*   \param fill      Called as fill(draw, packet) for every draw, from any thread; it may only read shared state.
+	*                    packet.draw is set, everything else is up to fill, sortKey NOT_DRAWN skips the draw.
+	*   \return Packets of the draws to issue, in drawing order, valid until the next build().
+	*/
+	const std::vector<const DrawPacket*>& build(size_t drawCount, const std::function<void(size_t, DrawPacket&)>& fill);
+
+	/** \brief Gets how long the last build() took on the calling thread, in milliseconds. */
+	double lastBuildMilliseconds() const;
+
+private:
+	std::vector<DrawPacket> _packets; //! Per draw
+	std::vector<uint64_t> _keys; //! Per draw, for DrawOrder
+	DrawOrder _order;
+	std::vector<const DrawPacket*> _sorted;
+	double _lastBuildMilliseconds = 0.0;
+};
@@ -0,0 +1,76 @@
+// STL
+#include <algorithm>
+
+// Project
+#include "drawOrder.h"
+
+namespace {
+
+	const int DEPTH_BITS = 24;
+	const int LAYER_BITS = 8;
+	const uint64_t DEPTH_MAX = (1ull << DEPTH_BITS) - 1;
+	const uint64_t LAYER_MAX = (1ull << LAYER_BITS) - 1;
+
+	// Element shifts per draw past which the order is too far off for insertion sort (e.g. the camera turned around)
+	const size_t MAX_SHIFTS_PER_DRAW = 16;
+}
+
+uint64_t drawSortKey(int layer, bool translucent, float viewDepth, float farPlane)
+{
+	// |translucent:1|layer:8|depth:24|
+	// depth is quantised linearly, objects behind the camera or past the far plane are clamped
+	const float unitDepth = std::min(std::max(viewDepth / farPlane, 0.0f), 1.0f);
+	const uint64_t depth = (uint64_t)(unitDepth * DEPTH_MAX);
+	const uint64_t layerBits = std::min((uint64_t)std::max(layer, 0), LAYER_MAX);
+
+	// opaque: the nearest layer first, then front to back, so early-Z rejects as much as possible
+	// translucent: layers in order, then back to front, for blending
+	if (!translucent) {
+		return ((LAYER_MAX - layerBits) << DEPTH_BITS) | depth;
+	}
+	return (1ull << (DEPTH_BITS + LAYER_BITS)) | (layerBits << DEPTH_BITS) | (DEPTH_MAX - depth);
+}
+
+const std::vector<size_t>& DrawOrder::sort(const std::vector<uint64_t>& keys)
+{
+	if (_order.size() != keys.size())
+	{
+		_order.resize(keys.size());
+		for (size_t i = 0; i < _order.size(); i++) {
+			_order[i] = i;
+		}
+	}
+
+	// insertion sort, linear when last frame's order still holds; stable, so equal keys do not flicker
+	_lastMoveCount = 0;
+	size_t shifts = 0;
+	for (size_t i = 1; i < _order.size(); i++)
+	{
+		const size_t draw = _order[i];
+		const uint64_t key = keys[draw];
+		size_t j = i;
+		while (j > 0 && keys[_order[j - 1]] > key)
+		{
+			_order[j] = _order[j - 1];
+			j--;
+		}
+		if (j != i)
+		{
+			_order[j] = draw;
+			_lastMoveCount++;
+			shifts += i - j;
+		}
+		if (shifts > MAX_SHIFTS_PER_DRAW * _order.size())
+		{
+			std::stable_sort(_order.begin(), _order.end(), [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+			_lastMoveCount = _order.size();
+			break;
+		}
+	}
+	return _order;
+}
+
+size_t DrawOrder::lastMoveCount() const
+{
+	return _lastMoveCount;
+}
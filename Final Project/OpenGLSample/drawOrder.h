@@ -0,0 +1,36 @@
+#pragma once
+
+// STL
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** \brief Builds the sort key of a draw: opaque draws before translucent ones, opaque front to back, translucent back to front.
+*   \param layer       Render layer of the draw, later layers are nearer the viewer (see RenderLayers)
+*   \param translucent Blended draws are sorted after all opaque ones
+*   \param viewDepth   Distance of the object in front of the camera, along the view direction
+*   \param farPlane    Far plane distance, depths are quantised over [0, farPlane]
+*/
+uint64_t drawSortKey(int layer, bool translucent, float viewDepth, float farPlane);
+
+/**
+  Order in which to issue a frame's draws, by sort key. The order of the previous frame is
+  kept and re-sorted with an insertion sort: the camera and the objects move little between
+  two frames, so the order is nearly sorted already and this takes close to one pass.
+*/
+class DrawOrder
+{
+public:
+	/** \brief Sorts the draws by key. The keys are indexed by draw, the draw count may change between calls.
+	*   \param keys Sort key of every draw, from drawSortKey()
+	*   \return Draw indices in drawing order, valid until the next call.
+	*/
+	const std::vector<size_t>& sort(const std::vector<uint64_t>& keys);
+
+	/** \brief Gets number of draws that moved in the last sort(), 0 when the order did not change. */
+	size_t lastMoveCount() const;
+
+private:
+	std::vector<size_t> _order;
+	size_t _lastMoveCount = 0;
+};
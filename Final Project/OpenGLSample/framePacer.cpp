@@ -0,0 +1,86 @@
+// STL
+#include <algorithm>
+#include <cstdio>
+
+// Project
+#include "framePacer.h"
+
+FramePacer::FramePacer(int maxFramesInFlight)
+	: _frames(std::max(maxFramesInFlight, 1))
+{
+}
+
+FramePacer::~FramePacer()
+{
+	for (Frame& frame : _frames)
+	{
+		if (frame.fence != nullptr) {
+			glDeleteSync(frame.fence);
+		}
+	}
+}
+
+void FramePacer::beginFrame()
+{
+	const Clock::time_point start = Clock::now();
+	_slot = (_slot + 1) % (int)_frames.size();
+
+	// frames that finished meanwhile are timed now rather than when their slot comes up again
+	for (int slot = 0; slot < (int)_frames.size(); slot++) {
+		retire(_frames[slot], slot == _slot);
+	}
+
+	const Clock::time_point now = Clock::now();
+	_waitMilliseconds += std::chrono::duration<double, std::milli>(now - start).count();
+	_pacedFrames++;
+	_frames[_slot].start = now;
+}
+
+void FramePacer::endFrame()
+{
+	_frames[_slot].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+int FramePacer::frameSlot() const
+{
+	return _slot;
+}
+
+int FramePacer::maxFramesInFlight() const
+{
+	return (int)_frames.size();
+}
+
+void FramePacer::report()
+{
+	if (_retiredFrames > 0 && _pacedFrames > 0)
+	{
+		printf("Frame pacing: %d frames in flight, input to GPU done %.2f ms on average, %.2f ms worst, %.3f ms waited per frame\n",
+			maxFramesInFlight(), _latencySum / _retiredFrames, _latencyWorst, _waitMilliseconds / _pacedFrames);
+	}
+	_latencySum = _latencyWorst = _waitMilliseconds = 0.0;
+	_retiredFrames = _pacedFrames = 0;
+}
+
+void FramePacer::retire(Frame& frame, bool wait)
+{
+	if (frame.fence == nullptr) {
+		return;
+	}
+
+	// the first wait flushes, so the fence is sure to be submitted and signal eventually
+	GLenum status = glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	while (wait && status == GL_TIMEOUT_EXPIRED) {
+		status = glClientWaitSync(frame.fence, 0, 1000000);
+	}
+	if (status == GL_TIMEOUT_EXPIRED) {
+		return;
+	}
+
+	const double latency = std::chrono::duration<double, std::milli>(Clock::now() - frame.start).count();
+	_latencySum += latency;
+	_latencyWorst = std::max(_latencyWorst, latency);
+	_retiredFrames++;
+	glDeleteSync(frame.fence);
+	frame.fence = nullptr;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+// STL
+#include <chrono>
+#include <vector>
+
+#include <glad/glad.h>
+
+/**
+  Bounds how far the CPU runs ahead of the GPU. Every frame ends with a fence sync; a new frame
+  first waits for the fence of the frame maxFramesInFlight back, so the driver never queues
+  more frames than that and the input sampled after beginFrame() is at most that many frames
+  old when its frame is done on the GPU. Per-frame resources indexed by frameSlot() are free
+  to reuse once beginFrame() returns.
+  Latency is measured from beginFrame() (right before input is sampled) to the moment the
+  frame's fence is seen signalled, so it is an upper bound of input to GPU done; the display
+  adds its scanout on top.
+*/
+class FramePacer
+{
+public:
+	/** \brief Creates the pacer.
+	*   \param maxFramesInFlight Frames the CPU may be ahead of the GPU, at least 1
+	*/
+	explicit FramePacer(int maxFramesInFlight);
+	~FramePacer();
+
+	//* \brief Starts a frame, waits until the GPU is done with the frame that used the same slot. Call it before sampling input.
+	void beginFrame();
+
+	//* \brief Ends a frame after its last GL call (the swap included), fences it.
+	void endFrame();
+
+	/** \brief Gets the slot of the current frame, in [0, maxFramesInFlight). */
+	int frameSlot() const;
+
+	/** \brief Gets the number of frames the CPU may be ahead of the GPU. */
+	int maxFramesInFlight() const;
+
+	//* \brief Prints average and worst input to GPU done latency and the time spent waiting per frame, and starts new statistics.
+	void report();
+
+private:
+	FramePacer(const FramePacer&) = delete;
+	FramePacer& operator=(const FramePacer&) = delete;
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct Frame
+	{
+		GLsync fence = nullptr; //!< Null once the frame is done on the GPU
+		Clock::time_point start;
+	};
+
+	// Checks if a frame is done on the GPU, waiting for it if asked, and records its latency if it is
+	void retire(Frame& frame, bool wait);
+
+	std::vector<Frame> _frames; //! Per slot
+	int _slot = 0;
+
+	double _latencySum = 0.0; //! Milliseconds, over the frames retired since the last report()
+	double _latencyWorst = 0.0;
+	int _retiredFrames = 0;
+	double _waitMilliseconds = 0.0; //! Spent in beginFrame() since the last report()
+	int _pacedFrames = 0;
+};
@@ -0,0 +1,98 @@
+// STL
+#include <atomic>
+#include <cmath>
+
+// Project
+#include "frustumCulling.h"
+#include "parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULL_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+	// Below this many boxes threads cost more than they save
+	const size_t MIN_BOXES_PER_THREAD = 4096;
+
+	glm::vec4 row(const glm::mat4& m, int index)
+	{
+		return glm::vec4(m[0][index], m[1][index], m[2][index], m[3][index]);
+	}
+
+	glm::vec4 normalizePlane(const glm::vec4& plane)
+	{
+		const float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		return length > 0.0f ? plane * (1.0f / length) : plane;
+	}
+}
+
+Frustum frustumFromMatrix(const glm::mat4& viewProjection)
+{
+	// a clip space point is inside when -w <= x, y, z <= w, each inequality is a plane in world space
+	const glm::vec4 x = row(viewProjection, 0), y = row(viewProjection, 1), z = row(viewProjection, 2), w = row(viewProjection, 3);
+	Frustum frustum;
+	frustum.planes[0] = normalizePlane(w + x);
+	frustum.planes[1] = normalizePlane(w - x);
+	frustum.planes[2] = normalizePlane(w + y);
+	frustum.planes[3] = normalizePlane(w - y);
+	frustum.planes[4] = normalizePlane(w + z);
+	frustum.planes[5] = normalizePlane(w - z);
+	return frustum;
+}
+
+size_t cullBoxes(const Frustum& frustum, const WorldBoxes& boxes, size_t count, std::vector<char>& visible)
+{
+	visible.resize(count);
+	const size_t groupCount = (count + WorldBoxes::WIDTH - 1) / WorldBoxes::WIDTH;
+	std::atomic<size_t> visibleCount(0);
+
+	// a box is outside when it is entirely behind one plane: its center's distance plus its
+	// projected half extent (the extent along the plane normal) is still negative
+	parallelFor(groupCount, MIN_BOXES_PER_THREAD / WorldBoxes::WIDTH, [&](size_t beginGroup, size_t endGroup) {
+		size_t rangeVisible = 0;
+		for (size_t group = beginGroup; group < endGroup; group++)
+		{
+			const size_t first = group * WorldBoxes::WIDTH;
+#ifdef CULL_USE_SSE2
+			const __m128 centerX = _mm_loadu_ps(&boxes.centerX[first]);
+			const __m128 centerY = _mm_loadu_ps(&boxes.centerY[first]);
+			const __m128 centerZ = _mm_loadu_ps(&boxes.centerZ[first]);
+			const __m128 extentX = _mm_loadu_ps(&boxes.extentX[first]);
+			const __m128 extentY = _mm_loadu_ps(&boxes.extentY[first]);
+			const __m128 extentZ = _mm_loadu_ps(&boxes.extentZ[first]);
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (const glm::vec4& plane : frustum.planes)
+			{
+				const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(plane.x)), _mm_mul_ps(centerY, _mm_set1_ps(plane.y))),
+					_mm_add_ps(_mm_mul_ps(centerZ, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+				const __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(extentX, _mm_set1_ps(std::abs(plane.x))), _mm_mul_ps(extentY, _mm_set1_ps(std::abs(plane.y)))),
+					_mm_mul_ps(extentZ, _mm_set1_ps(std::abs(plane.z))));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+			}
+			const int mask = _mm_movemask_ps(inside);
+			for (size_t lane = 0; lane < WorldBoxes::WIDTH && first + lane < count; lane++)
+			{
+				visible[first + lane] = (mask >> lane) & 1;
+				rangeVisible += visible[first + lane];
+			}
+#else
+			for (size_t box = first; box < first + WorldBoxes::WIDTH && box < count; box++)
+			{
+				bool inside = true;
+				for (const glm::vec4& plane : frustum.planes)
+				{
+					const float distance = boxes.centerX[box] * plane.x + boxes.centerY[box] * plane.y + boxes.centerZ[box] * plane.z + plane.w;
+					const float reach = boxes.extentX[box] * std::abs(plane.x) + boxes.extentY[box] * std::abs(plane.y) + boxes.extentZ[box] * std::abs(plane.z);
+					inside = inside && distance + reach >= 0.0f;
+				}
+				visible[box] = inside ? 1 : 0;
+				rangeVisible += visible[box];
+			}
+#endif
+		}
+		visibleCount += rangeVisible;
+	});
+	return visibleCount;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// STL
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Project
+#include "transformTable.h"
+
+/**
+  The six planes of a view frustum in world space, normals pointing inwards: a point p is
+  inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+*/
+struct Frustum
+{
+	glm::vec4 planes[6]; //!< Left, right, bottom, top, near, far
+};
+
+/** \brief Extracts the frustum planes from a view projection matrix.
+*   \param viewProjection projection * view
+*/
+Frustum frustumFromMatrix(const glm::mat4& viewProjection);
+
+/** \brief Tests world space boxes against a frustum, four boxes at a time.
+*   \param frustum Frustum, from frustumFromMatrix()
+*   \param boxes   Boxes, from TransformTable::worldBoxes()
+*   \param count   Number of boxes to test, the first count of the arrays
+*   \param visible Resized to count, set to 1 for boxes that intersect the frustum and 0 for the others
+*   \return Number of visible boxes.
+*/
+size_t cullBoxes(const Frustum& frustum, const WorldBoxes& boxes, size_t count, std::vector<char>& visible);
@@ -0,0 +1,91 @@
+// STL
+#include <iostream>
+
+// Project
+#include "gpuTimers.h"
+
+GpuTimers::GpuTimers()
+{
+}
+
+GpuTimers::~GpuTimers()
+{
+	for (Frame& frame : _frames)
+	{
+		if (!frame.queries.empty()) {
+			glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+		}
+	}
+}
+
+int GpuTimers::addPass(const char* name)
+{
+	_names.push_back(name);
+	_milliseconds.push_back(0.0);
+	return (int)_names.size() - 1;
+}
+
+void GpuTimers::beginFrame()
+{
+	_current = (_current + 1) % FRAME_LATENCY;
+	collect(_frames[_current]);
+}
+
+void GpuTimers::begin(int pass)
+{
+	Frame& frame = _frames[_current];
+	if (frame.used == frame.queries.size())
+	{
+		GLuint query = 0;
+		glGenQueries(1, &query);
+		frame.queries.push_back(query);
+		frame.passes.push_back(0);
+	}
+	frame.passes[frame.used] = pass;
+	glBeginQuery(GL_TIME_ELAPSED, frame.queries[frame.used]);
+	frame.used++;
+}
+
+void GpuTimers::end()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+}
+
+void GpuTimers::collect(Frame& frame)
+{
+	if (frame.used == 0) {
+		return;
+	}
+
+	// queries complete in order, the last one being ready means the whole frame is
+	GLint available = 0;
+	glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (available)
+	{
+		for (size_t i = 0; i < frame.used; i++)
+		{
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &nanoseconds);
+			_milliseconds[frame.passes[i]] += nanoseconds / 1.0e6;
+		}
+		_measuredFrames++;
+	}
+	// a frame still in flight after FRAME_LATENCY frames is dropped, its queries get reused
+	frame.used = 0;
+}
+
+void GpuTimers::report()
+{
+	if (_measuredFrames == 0) {
+		return;
+	}
+
+	std::cout << "GPU time per frame (" << _measuredFrames << " frames):";
+	for (size_t pass = 0; pass < _names.size(); pass++)
+	{
+		std::cout << " " << _names[pass] << " " << _milliseconds[pass] / _measuredFrames << " ms";
+		_milliseconds[pass] = 0.0;
+	}
+	std::cout << std::endl;
+	_measuredFrames = 0;
+}
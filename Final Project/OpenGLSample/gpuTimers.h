@@ -0,0 +1,63 @@
+#pragma once
+
+// STL
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+/**
+  GPU time per render pass, measured with GL_TIME_ELAPSED queries. Results are read a few
+  frames after they were issued, and only once the driver reports them available, so
+  measuring never stalls the pipeline. A pass may be timed several times per frame (e.g.
+  once per layer), its times are summed per frame and averaged over the frames since the
+  last report().
+*/
+class GpuTimers
+{
+public:
+	GpuTimers();
+	~GpuTimers();
+
+	/** \brief Registers a pass.
+	*   \param name Name printed by report()
+	*   \return ID to pass to begin().
+	*/
+	int addPass(const char* name);
+
+	//* \brief Starts a frame, collects the results of earlier frames that are ready. Call it before the first begin() of a frame.
+	void beginFrame();
+
+	/** \brief Starts timing a pass. Timed sections must not nest.
+	*   \param pass ID returned by addPass()
+	*/
+	void begin(int pass);
+
+	//* \brief Stops timing the pass started by the last begin().
+	void end();
+
+	//* \brief Prints the average GPU milliseconds per frame of every pass and starts a new average.
+	void report();
+
+private:
+	GpuTimers(const GpuTimers&) = delete;
+	GpuTimers& operator=(const GpuTimers&) = delete;
+
+	// Frames between issuing a query and reading it back
+	static const int FRAME_LATENCY = 4;
+
+	struct Frame
+	{
+		std::vector<GLuint> queries; //!< Grows to the most sections a frame has used, reused afterwards
+		std::vector<int> passes; //!< Pass of each used query
+		size_t used = 0;
+	};
+
+	void collect(Frame& frame);
+
+	std::vector<std::string> _names;
+	std::vector<double> _milliseconds; //! Sum over the measured frames, per pass
+	int _measuredFrames = 0;
+	Frame _frames[FRAME_LATENCY];
+	int _current = 0;
+};
@@ -0,0 +1,539 @@
+// STL
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+// Project
+#include "jobSystem.h"
+
+namespace {
+
+	// Ranges parallelFor makes per thread at most, a few so that stealing evens out uneven ranges
+	const size_t RANGES_PER_THREAD = 4;
+
+	// Idle workers yield this many times before going to sleep, jobs tend to come in bursts
+	const int IDLE_SPINS = 64;
+
+	// index of the calling thread's deque: 0 for the main thread, -1 for threads without one
+	thread_local int t_thread = -1;
+
+	void runRange(void* data, size_t begin, size_t end)
+	{
+		(*static_cast<const std::function<void(size_t, size_t)>*>(data))(begin, end);
+	}
+
+	double millisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+bool JobSystem::Deque::push(const Job& job)
+{
+	const int64_t b = bottom.load(std::memory_order_relaxed);
+	const int64_t t = top.load(std::memory_order_acquire);
+	if (b - t >= DEQUE_CAPACITY) {
+		return false;
+	}
+	jobs[b & (DEQUE_CAPACITY - 1)] = job;
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+bool JobSystem::Deque::pop(Job& job)
+{
+	const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+	if (t > b)
+	{
+		// empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	job = jobs[b & (DEQUE_CAPACITY - 1)];
+	if (t < b) {
+		return true;
+	}
+	// the last job, a thief may be taking it at the same time
+	const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return won;
+}
+
+bool JobSystem::Deque::steal(Job& job)
+{
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const int64_t b = bottom.load(std::memory_order_acquire);
+	if (t >= b) {
+		return false;
+	}
+
+	// the copy is only kept if no one else took the job meanwhile
+	job = jobs[t & (DEQUE_CAPACITY - 1)];
+	return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+JobSystem& JobSystem::instance()
+{
+	static JobSystem jobSystem;
+	return jobSystem;
+}
+
+JobSystem::JobSystem()
+{
+	static_assert((DEQUE_CAPACITY & (DEQUE_CAPACITY - 1)) == 0, "the deque capacity has to be a power of two");
+
+	_mainThread = std::this_thread::get_id();
+	t_thread = 0;
+	const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+	for (size_t thread = 0; thread < threads; thread++) {
+		_deques.push_back(new Deque());
+	}
+	for (size_t thread = 1; thread < threads; thread++) {
+		_workers.emplace_back(&JobSystem::workerLoop, this, (int)thread);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+		_quit = true;
+	}
+	_wakeUp.notify_all();
+	for (std::thread& worker : _workers) {
+		worker.join();
+	}
+	for (Deque* deque : _deques) {
+		delete deque;
+	}
+}
+
+void JobSystem::run(JobFunction function, void* data, size_t begin, size_t end, JobCounter* counter, JobCounter* dependency)
+{
+	if (counter != nullptr) {
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+	submit({ function, data, begin, end, counter, dependency }, false);
+}
+
+void JobSystem::runOnMainThread(JobFunction function, void* data, size_t begin, size_t end, JobCounter* counter, JobCounter* dependency)
+{
+	if (counter != nullptr) {
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+	submit({ function, data, begin, end, counter, dependency }, true);
+}
+
+void JobSystem::submit(const Job& job, bool mainThread)
+{
+	if (job.dependency != nullptr && park(job, mainThread)) {
+		return;
+	}
+	if (mainThread) {
+		scheduleOnMainThread(job);
+	}
+	else {
+		schedule(job);
+	}
+}
+
+void JobSystem::scheduleOnMainThread(const Job& job)
+{
+	std::lock_guard<std::mutex> lock(_sharedMutex);
+	_mainThreadJobs.push_back(job);
+	_mainThreadCount++;
+}
+
+bool JobSystem::park(const Job& job, bool mainThread)
+{
+	std::lock_guard<std::mutex> lock(_parkedMutex);
+	// counted before the dependency is read, and execute() reads the count after decrementing: either the job
+	// finishing the dependency sees this one parked and releases it (once we unlock), or we see the counter at zero
+	_parkedCount++;
+	if (job.dependency->pending.load() == 0)
+	{
+		_parkedCount--;
+		return false;
+	}
+	_parkedJobs.push_back({ job, mainThread });
+	return true;
+}
+
+void JobSystem::releaseParked()
+{
+	std::vector<ParkedJob> released;
+	{
+		std::lock_guard<std::mutex> lock(_parkedMutex);
+		for (size_t i = 0; i < _parkedJobs.size();)
+		{
+			if (_parkedJobs[i].job.dependency->pending.load() != 0)
+			{
+				i++;
+				continue;
+			}
+			released.push_back(_parkedJobs[i]);
+			_parkedJobs[i] = _parkedJobs.back();
+			_parkedJobs.pop_back();
+			_parkedCount--;
+		}
+	}
+	// queued outside the lock, a full deque runs the job right here
+	for (const ParkedJob& parked : released)
+	{
+		if (parked.mainThread) {
+			scheduleOnMainThread(parked.job);
+		}
+		else {
+			schedule(parked.job);
+		}
+	}
+}
+
+void JobSystem::schedule(const Job& job)
+{
+	// counted first, so that a worker woken up for it keeps looking until it is found
+	_queued++;
+	const int thread = t_thread;
+	if (thread >= 0)
+	{
+		if (!_deques[thread]->push(job))
+		{
+			// full: the caller runs it, which also throttles whoever schedules that much
+			_queued--;
+			execute(job);
+			return;
+		}
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(_sharedMutex);
+		_sharedJobs.push_back(job);
+		_sharedCount++;
+	}
+
+	if (_sleeping.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+		_wakeUp.notify_one();
+	}
+}
+
+void JobSystem::execute(const Job& job)
+{
+	job.function(job.data, job.begin, job.end);
+	// the last job of a counter queues the jobs parked on it
+	if (job.counter != nullptr && job.counter->pending.fetch_sub(1) == 1 && _parkedCount.load() > 0) {
+		releaseParked();
+	}
+}
+
+bool JobSystem::takeJob(int thread, Job& job)
+{
+	if (thread >= 0 && _deques[thread]->pop(job)) {
+		return true;
+	}
+
+	// steal, starting after our own deque so that the thieves spread over the victims
+	const size_t count = _deques.size();
+	const size_t first = thread >= 0 ? (size_t)thread + 1 : 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		const size_t victim = (first + i) % count;
+		if ((int)victim != thread && _deques[victim]->steal(job)) {
+			return true;
+		}
+	}
+
+	if (_sharedCount.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(_sharedMutex);
+		if (!_sharedJobs.empty())
+		{
+			job = _sharedJobs.back();
+			_sharedJobs.pop_back();
+			_sharedCount--;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool JobSystem::tryRunJob(int thread)
+{
+	Job job;
+	if (!takeJob(thread, job)) {
+		return false;
+	}
+	_queued--;
+	execute(job);
+	return true;
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	const int thread = t_thread;
+	while (counter.pending.load(std::memory_order_acquire) > 0)
+	{
+		if (thread == 0 && _mainThreadCount.load() > 0) {
+			runMainThreadJobs();
+		}
+		else if (!tryRunJob(thread)) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::runMainThreadJobs()
+{
+	std::vector<Job> jobs;
+	{
+		std::lock_guard<std::mutex> lock(_sharedMutex);
+		jobs.swap(_mainThreadJobs);
+		_mainThreadCount = 0;
+	}
+	for (const Job& job : jobs) {
+		execute(job);
+	}
+}
+
+void JobSystem::parallelFor(size_t count, size_t minRangeSize, const std::function<void(size_t, size_t)>& body)
+{
+	if (count == 0) {
+		return;
+	}
+
+	minRangeSize = std::max<size_t>(minRangeSize, 1);
+	const size_t rangeCount = std::min(threadCount() * RANGES_PER_THREAD, (count + minRangeSize - 1) / minRangeSize);
+	if (rangeCount <= 1)
+	{
+		body(0, count);
+		return;
+	}
+
+	// the calling thread takes the first range itself, then helps with the rest
+	const size_t rangeSize = (count + rangeCount - 1) / rangeCount;
+	JobCounter counter;
+	for (size_t begin = rangeSize; begin < count; begin += rangeSize) {
+		run(&runRange, const_cast<std::function<void(size_t, size_t)>*>(&body), begin, std::min(begin + rangeSize, count), &counter);
+	}
+	body(0, rangeSize);
+	wait(counter);
+}
+
+size_t JobSystem::threadCount() const
+{
+	return _deques.size();
+}
+
+bool JobSystem::isMainThread() const
+{
+	return std::this_thread::get_id() == _mainThread;
+}
+
+void JobSystem::workerLoop(int thread)
+{
+	t_thread = thread;
+	while (!_quit.load())
+	{
+		if (tryRunJob(thread)) {
+			continue;
+		}
+
+		bool busy = false;
+		for (int spin = 0; spin < IDLE_SPINS && !busy; spin++)
+		{
+			std::this_thread::yield();
+			busy = _queued.load() > 0;
+		}
+		if (busy) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_sleepMutex);
+		_sleeping++;
+		_wakeUp.wait(lock, [this] { return _queued.load() > 0 || _quit.load(); });
+		_sleeping--;
+	}
+}
+
+namespace {
+
+	// a few hundred nanoseconds of arithmetic per item, enough for the scheduling cost to show
+	void busyItems(std::vector<float>& items, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			float x = items[i];
+			for (int k = 0; k < 64; k++) {
+				x = std::sqrt(x * x + 1.0f) * 0.5f;
+			}
+			items[i] = x;
+		}
+	}
+
+	void emptyJob(void*, size_t, size_t)
+	{
+	}
+
+	// self-test: jobs in stages, every job of a stage depends on the counter of the one before and waits for nested jobs of its own
+	struct StageTest
+	{
+		static const int STAGES = 8;
+		JobCounter counters[STAGES];
+		std::atomic<int> done[STAGES];
+		std::atomic<int> early{ 0 }; //!< Jobs that started before the stage they depend on was done
+		std::atomic<int> wrongThread{ 0 }; //!< Main thread jobs run elsewhere
+		int jobsPerStage = 0;
+	};
+
+	void nestedItem(void* data, size_t, size_t)
+	{
+		static_cast<std::atomic<int>*>(data)->fetch_add(1);
+	}
+
+	void stageJob(void* data, size_t stage, size_t)
+	{
+		StageTest& test = *static_cast<StageTest*>(data);
+		if (stage > 0 && test.done[stage - 1].load() != test.jobsPerStage) {
+			test.early++;
+		}
+
+		// jobs waiting for jobs, from every thread at once
+		JobSystem& jobs = JobSystem::instance();
+		std::atomic<int> items{ 0 };
+		JobCounter nested;
+		for (int i = 0; i < 8; i++) {
+			jobs.run(&nestedItem, &items, 0, 0, &nested);
+		}
+		jobs.wait(nested);
+		if (items.load() == 8) {
+			test.done[stage]++;
+		}
+	}
+
+	void mainThreadStageJob(void* data, size_t stage, size_t)
+	{
+		StageTest& test = *static_cast<StageTest*>(data);
+		if (!JobSystem::instance().isMainThread()) {
+			test.wrongThread++;
+		}
+		stageJob(data, stage, 0);
+	}
+
+	bool testNestedWaits(JobSystem& jobs)
+	{
+		StageTest test;
+		test.jobsPerStage = (int)jobs.threadCount() * 8;
+		for (std::atomic<int>& done : test.done) {
+			done = 0;
+		}
+		// all scheduled up front, the jobs of later stages are parked until the stage before is done
+		for (int stage = 0; stage < StageTest::STAGES; stage++)
+		{
+			JobCounter* dependency = stage > 0 ? &test.counters[stage - 1] : nullptr;
+			for (int i = 0; i < test.jobsPerStage; i++)
+			{
+				// one job per stage needs the main thread, as GL uploads would
+				if (i == 0) {
+					jobs.runOnMainThread(&mainThreadStageJob, &test, stage, 0, &test.counters[stage], dependency);
+				}
+				else {
+					jobs.run(&stageJob, &test, stage, 0, &test.counters[stage], dependency);
+				}
+			}
+		}
+		jobs.wait(test.counters[StageTest::STAGES - 1]);
+
+		bool passed = test.early.load() == 0 && test.wrongThread.load() == 0;
+		for (const std::atomic<int>& done : test.done) {
+			passed = passed && done.load() == test.jobsPerStage;
+		}
+		printf("  self-test, %d stages of %d dependent jobs with nested waits: %s\n", StageTest::STAGES, test.jobsPerStage, passed ? "passed" : "FAILED");
+		return passed;
+	}
+}
+
+bool benchmarkJobs()
+{
+	JobSystem& jobs = JobSystem::instance();
+	printf("Job system benchmark (%zu threads)\n", jobs.threadCount());
+	const bool passed = testNestedWaits(jobs);
+
+	// scheduling overhead: empty jobs from the main thread, in batches that fit the deque
+	const int BATCH = 1000, BATCHES = 200;
+	auto start = std::chrono::steady_clock::now();
+	for (int batch = 0; batch < BATCHES; batch++)
+	{
+		JobCounter counter;
+		for (int i = 0; i < BATCH; i++) {
+			jobs.run(&emptyJob, nullptr, 0, 0, &counter);
+		}
+		jobs.wait(counter);
+	}
+	printf("  empty jobs:        %8.1f ns per job\n", millisecondsSince(start) * 1.0e6 / (BATCH * BATCHES));
+
+	// the same with a dependency: half the batch waits for the other half
+	start = std::chrono::steady_clock::now();
+	for (int batch = 0; batch < BATCHES; batch++)
+	{
+		JobCounter first, second;
+		for (int i = 0; i < BATCH / 2; i++) {
+			jobs.run(&emptyJob, nullptr, 0, 0, &first);
+		}
+		for (int i = 0; i < BATCH / 2; i++) {
+			jobs.run(&emptyJob, nullptr, 0, 0, &second, &first);
+		}
+		jobs.wait(second);
+	}
+	printf("  dependent jobs:    %8.1f ns per job\n", millisecondsSince(start) * 1.0e6 / (BATCH * BATCHES));
+
+	// scaling: the same items on one thread, then split in ranges of several sizes
+	const size_t ITEMS = 1 << 20;
+	std::vector<float> items(ITEMS, 1.0f);
+	start = std::chrono::steady_clock::now();
+	busyItems(items, 0, ITEMS);
+	const double serialTime = millisecondsSince(start);
+	printf("  %zu items on one thread: %.2f ms\n", ITEMS, serialTime);
+	printf("  %12s %10s %8s\n", "min range", "ms", "speedup");
+	for (size_t range : { (size_t)16, (size_t)256, (size_t)4096, (size_t)65536 })
+	{
+		start = std::chrono::steady_clock::now();
+		jobs.parallelFor(ITEMS, range, [&items](size_t begin, size_t end) { busyItems(items, begin, end); });
+		const double time = millisecondsSince(start);
+		printf("  %12zu %10.2f %8.2f\n", range, time, serialTime / time);
+	}
+
+	// per-frame sized work: many small parallelFor calls, against a thread per range (how parallelFor used to run)
+	const int CALLS = 1000;
+	const size_t SMALL = 4096;
+	start = std::chrono::steady_clock::now();
+	for (int call = 0; call < CALLS; call++) {
+		jobs.parallelFor(SMALL, 256, [&items](size_t begin, size_t end) { busyItems(items, begin, end); });
+	}
+	const double jobTime = millisecondsSince(start) * 1000.0 / CALLS;
+	start = std::chrono::steady_clock::now();
+	for (int call = 0; call < CALLS; call++)
+	{
+		const size_t rangeSize = (SMALL + jobs.threadCount() - 1) / jobs.threadCount();
+		std::vector<std::thread> threads;
+		for (size_t begin = rangeSize; begin < SMALL; begin += rangeSize)
+		{
+			const size_t end = std::min(begin + rangeSize, SMALL);
+			threads.emplace_back([&items, begin, end] { busyItems(items, begin, end); });
+		}
+		busyItems(items, 0, rangeSize);
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+	}
+	const double threadTime = millisecondsSince(start) * 1000.0 / CALLS;
+	printf("  parallelFor over %zu items: %.1f us with jobs, %.1f us with a thread per range\n", SMALL, jobTime, threadTime);
+	return passed;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+// STL
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//* \brief Counts the unfinished jobs of a group, JobSystem::wait() returns once it is back to zero.
+struct JobCounter
+{
+	std::atomic<int> pending{ 0 };
+};
+
+/**
+  Work-stealing job scheduler. Every thread owns a fixed size Chase-Lev deque: it pushes and pops
+  its own jobs at the bottom without locks, idle threads steal from the top of the others'.
+  Jobs are plain values (a function, its data and a range), so scheduling one allocates nothing.
+  Jobs that must run on the main thread (anything that touches the GL context) go to a separate
+  queue the main thread drains in runMainThreadJobs() and while it waits.
+  wait() never blocks while there is work: the waiting thread runs queued jobs meanwhile, so jobs
+  may schedule and wait for other jobs. A job with a dependency is not queued before the dependency's
+  counter is zero: it is parked, and whoever finishes the counter's last job queues it.
+  The thread that first uses the scheduler is the main thread; other threads (not workers) may
+  schedule and wait too, their jobs go through a shared queue.
+*/
+class JobSystem
+{
+public:
+	typedef void(*JobFunction)(void* data, size_t begin, size_t end);
+
+	struct Job
+	{
+		JobFunction function;
+		void* data;
+		size_t begin;
+		size_t end;
+		JobCounter* counter; //!< Decremented once the job has run, may be null
+		JobCounter* dependency; //!< The job starts once this is zero, may be null
+	};
+
+	//* \brief Gets the scheduler, started on first use by the main thread.
+	static JobSystem& instance();
+
+	/** \brief Schedules a job.
+	*   \param function   Called as function(data, begin, end)
+	*   \param data       Passed through, has to outlive the job
+	*   \param begin      Passed through
+	*   \param end        Passed through
+	*   \param counter    Incremented now and decremented when the job is done, may be null
+	*   \param dependency The job only starts once this counter is zero, may be null
+	*/
+	void run(JobFunction function, void* data, size_t begin, size_t end, JobCounter* counter, JobCounter* dependency = nullptr);
+
+	/** \brief Schedules a job on the main thread, for GL work. It runs in runMainThreadJobs() or while the main thread waits.
+	*   \param function   Called as function(data, begin, end)
+	*   \param data       Passed through, has to outlive the job
+	*   \param begin      Passed through
+	*   \param end        Passed through
+	*   \param counter    Incremented now and decremented when the job is done, may be null
+	*   \param dependency The job only starts once this counter is zero, may be null
+	*/
+	void runOnMainThread(JobFunction function, void* data, size_t begin, size_t end, JobCounter* counter, JobCounter* dependency = nullptr);
+
+	/** \brief Runs jobs until a counter is zero.
+	*   \param counter Counter of the jobs to wait for
+	*/
+	void wait(JobCounter& counter);
+
+	//* \brief Runs the main thread jobs scheduled so far. Call it from the main thread, e.g. once per frame.
+	void runMainThreadJobs();
+
+	/** \brief Splits [0, count) into ranges run as jobs, the caller takes part. Blocks until all ranges are done.
+	*   \param count        Number of items
+	*   \param minRangeSize Smallest range worth a job
+	*   \param body         Called as body(begin, end) for every range
+	*/
+	void parallelFor(size_t count, size_t minRangeSize, const std::function<void(size_t, size_t)>& body);
+
+	/** \brief Gets number of threads running jobs, the main thread included. */
+	size_t threadCount() const;
+
+	/** \brief Gets whether the calling thread is the main thread. */
+	bool isMainThread() const;
+
+private:
+	JobSystem();
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// Jobs one thread can have queued; past that, run() runs the job right away
+	static const int64_t DEQUE_CAPACITY = 4096;
+
+	// Chase-Lev deque (Le et al. 2013, fixed capacity). Only the owner pushes and pops, anyone steals.
+	struct Deque
+	{
+		std::atomic<int64_t> top{ 0 };
+		char padding[64]; //!< Keeps the thieves' and the owner's index on separate cache lines
+		std::atomic<int64_t> bottom{ 0 };
+		Job jobs[DEQUE_CAPACITY];
+
+		bool push(const Job& job);
+		bool pop(Job& job);
+		bool steal(Job& job);
+	};
+
+	struct ParkedJob
+	{
+		Job job;
+		bool mainThread;
+	};
+
+	bool tryRunJob(int thread);
+	bool takeJob(int thread, Job& job);
+	void execute(const Job& job);
+	void submit(const Job& job, bool mainThread);
+	void schedule(const Job& job);
+	void scheduleOnMainThread(const Job& job);
+	bool park(const Job& job, bool mainThread);
+	void releaseParked();
+	void workerLoop(int thread);
+
+	std::vector<Deque*> _deques; //! Per thread, 0 is the main thread
+	std::vector<std::thread> _workers;
+	std::thread::id _mainThread;
+
+	std::mutex _sharedMutex; //! Guards the queues below
+	std::vector<Job> _sharedJobs; //! Scheduled by threads without a deque
+	std::vector<Job> _mainThreadJobs;
+	std::atomic<int> _sharedCount{ 0 };
+	std::atomic<int> _mainThreadCount{ 0 };
+
+	std::mutex _parkedMutex; //! Guards _parkedJobs
+	std::vector<ParkedJob> _parkedJobs; //! Jobs whose dependency was not zero yet
+	std::atomic<int> _parkedCount{ 0 };
+
+	std::atomic<int> _queued{ 0 }; //! Jobs in the deques and the shared queue, for idle workers to know when to wake up
+	std::atomic<int> _sleeping{ 0 };
+	std::mutex _sleepMutex;
+	std::condition_variable _wakeUp;
+	std::atomic<bool> _quit{ false };
+};
+
+/** \brief Checks nested waits and dependencies, times scheduling empty jobs, dependent jobs and parallelFor at several range sizes, and prints the results.
+*   \return False if the self-test failed
+*/
+bool benchmarkJobs();
@@ -0,0 +1,264 @@
+// STL
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#ifdef KTX2_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+// Project
+#include "ktx2Loader.h"
+#include "mappedFile.h"
+#include "parallel.h"
+#include "resourceTracker.h"
+
+// Compressed formats that glad (core profile, no extensions) doesn't define
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT        0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT       0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT       0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT       0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT       0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT 0x8C4E
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+namespace {
+
+	const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	const size_t KTX2_HEADER_SIZE = 80; // identifier + header + index, the level index follows
+	const size_t KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+
+	const unsigned int SUPERCOMPRESSION_NONE = 0;
+	const unsigned int SUPERCOMPRESSION_ZSTD = 2;
+
+	struct FormatInfo
+	{
+		unsigned int vkFormat;
+		GLenum internalFormat;
+		GLenum format; //!< 0 for block compressed formats
+		GLenum type;
+		unsigned int bytesPerBlock; //!< Bytes per pixel, or per 4x4 block for compressed formats
+	};
+
+	// VkFormat -> OpenGL, only the formats that make sense for our 2D textures
+	const FormatInfo FORMATS[] = {
+		{   9, GL_R8,                                   GL_RED,  GL_UNSIGNED_BYTE, 1 },
+		{  16, GL_RG8,                                  GL_RG,   GL_UNSIGNED_BYTE, 2 },
+		{  23, GL_RGB8,                                 GL_RGB,  GL_UNSIGNED_BYTE, 3 },
+		{  29, GL_SRGB8,                                GL_RGB,  GL_UNSIGNED_BYTE, 3 },
+		{  30, GL_RGB8,                                 GL_BGR,  GL_UNSIGNED_BYTE, 3 },
+		{  36, GL_SRGB8,                                GL_BGR,  GL_UNSIGNED_BYTE, 3 },
+		{  37, GL_RGBA8,                                GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+		{  43, GL_SRGB8_ALPHA8,                         GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+		{  44, GL_RGBA8,                                GL_BGRA, GL_UNSIGNED_BYTE, 4 },
+		{  50, GL_SRGB8_ALPHA8,                         GL_BGRA, GL_UNSIGNED_BYTE, 4 },
+		{  97, GL_RGBA16F,                              GL_RGBA, GL_HALF_FLOAT,    8 },
+		{ 109, GL_RGBA32F,                              GL_RGBA, GL_FLOAT,        16 },
+		{ 131, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,         0, 0,  8 },
+		{ 132, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT,        0, 0,  8 },
+		{ 133, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,        0, 0,  8 },
+		{ 134, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT,  0, 0,  8 },
+		{ 135, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,        0, 0, 16 },
+		{ 136, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT,  0, 0, 16 },
+		{ 137, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,        0, 0, 16 },
+		{ 138, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT,  0, 0, 16 },
+		{ 139, GL_COMPRESSED_RED_RGTC1,                 0, 0,  8 },
+		{ 140, GL_COMPRESSED_SIGNED_RED_RGTC1,          0, 0,  8 },
+		{ 141, GL_COMPRESSED_RG_RGTC2,                  0, 0, 16 },
+		{ 142, GL_COMPRESSED_SIGNED_RG_RGTC2,           0, 0, 16 },
+		{ 145, GL_COMPRESSED_RGBA_BPTC_UNORM,           0, 0, 16 },
+		{ 146, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM,     0, 0, 16 },
+	};
+
+	struct Level
+	{
+		const unsigned char* data; //!< Points into the mapping, or into decoded for supercompressed levels
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+		std::vector<unsigned char> decoded;
+	};
+
+	uint32_t readU32(const unsigned char* p)
+	{
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	uint64_t readU64(const unsigned char* p)
+	{
+		uint64_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	const FormatInfo* findFormat(unsigned int vkFormat)
+	{
+		for (const auto& info : FORMATS)
+		{
+			if (info.vkFormat == vkFormat) {
+				return &info;
+			}
+		}
+		return nullptr;
+	}
+
+	uint64_t expectedLevelSize(const FormatInfo& info, int width, int height)
+	{
+		if (info.format == 0) {
+			return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * info.bytesPerBlock;
+		}
+		return (uint64_t)width * height * info.bytesPerBlock;
+	}
+
+	bool decodeSupercompressedLevels(std::vector<Level>& levels, const char* path)
+	{
+#ifdef KTX2_WITH_ZSTD
+		// Every level is an independent Zstd frame, so decode them all at once
+		std::vector<int> failed(levels.size(), 0);
+		parallelFor(levels.size(), 1, [&levels, &failed](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				auto& level = levels[i];
+				level.decoded.resize((size_t)level.uncompressedByteLength);
+				const auto result = ZSTD_decompress(level.decoded.data(), level.decoded.size(), level.data, (size_t)level.byteLength);
+				failed[i] = ZSTD_isError(result) || result != level.decoded.size();
+			}
+		});
+
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			if (failed[i])
+			{
+				std::cout << "KTX2: failed to decode level " << i << " of " << path << std::endl;
+				return false;
+			}
+			levels[i].data = levels[i].decoded.data();
+		}
+		return true;
+#else
+		(void)levels;
+		std::cout << "KTX2: " << path << " is Zstd supercompressed, rebuild with KTX2_WITH_ZSTD to load it" << std::endl;
+		return false;
+#endif
+	}
+
+} // namespace
+
+GLuint loadKTX2(const char* path)
+{
+	MappedFile file;
+	if (!file.open(path))
+	{
+		std::cout << "Texture failed to load at path: " << path << std::endl;
+		return 0;
+	}
+
+	const unsigned char* bytes = file.data();
+	if (file.size() < KTX2_HEADER_SIZE || memcmp(bytes, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+	{
+		std::cout << "KTX2: " << path << " is not a KTX2 file" << std::endl;
+		return 0;
+	}
+
+	const uint32_t vkFormat = readU32(bytes + 12);
+	const int width = (int)readU32(bytes + 20);
+	const int height = (int)readU32(bytes + 24);
+	const uint32_t depth = readU32(bytes + 28);
+	const uint32_t layerCount = readU32(bytes + 32);
+	const uint32_t faceCount = readU32(bytes + 36);
+	const uint32_t levelCount = readU32(bytes + 40);
+	const uint32_t supercompression = readU32(bytes + 44);
+
+	const FormatInfo* info = findFormat(vkFormat);
+	if (info == nullptr || width <= 0 || height <= 0 || depth > 1 || layerCount > 1 || faceCount != 1)
+	{
+		std::cout << "KTX2: " << path << " is not a supported 2D texture (vkFormat " << vkFormat << ")" << std::endl;
+		return 0;
+	}
+	if (supercompression != SUPERCOMPRESSION_NONE && supercompression != SUPERCOMPRESSION_ZSTD)
+	{
+		std::cout << "KTX2: " << path << " uses unsupported supercompression scheme " << supercompression << std::endl;
+		return 0;
+	}
+
+	// Validate the level index against the file before touching any level data
+	const uint32_t numLevels = std::max(levelCount, 1u);
+	if (numLevels > 32 || file.size() < KTX2_HEADER_SIZE + numLevels * KTX2_LEVEL_INDEX_ENTRY_SIZE)
+	{
+		std::cout << "KTX2: " << path << " has a truncated level index" << std::endl;
+		return 0;
+	}
+
+	std::vector<Level> levels(numLevels);
+	for (uint32_t i = 0; i < numLevels; i++)
+	{
+		const unsigned char* entry = bytes + KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+		const uint64_t byteOffset = readU64(entry);
+		auto& level = levels[i];
+		level.byteLength = readU64(entry + 8);
+		level.uncompressedByteLength = readU64(entry + 16);
+
+		const int levelWidth = std::max(width >> i, 1);
+		const int levelHeight = std::max(height >> i, 1);
+		const bool inFile = byteOffset <= file.size() && level.byteLength <= file.size() - byteOffset;
+		const bool sizeMatches = level.uncompressedByteLength == expectedLevelSize(*info, levelWidth, levelHeight)
+			&& (supercompression != SUPERCOMPRESSION_NONE || level.byteLength == level.uncompressedByteLength);
+		if (!inFile || !sizeMatches)
+		{
+			std::cout << "KTX2: " << path << " has an invalid entry for level " << i << std::endl;
+			return 0;
+		}
+		level.data = bytes + byteOffset;
+	}
+
+	if (supercompression == SUPERCOMPRESSION_ZSTD && !decodeSupercompressedLevels(levels, path)) {
+		return 0;
+	}
+
+	GLuint textureID;
+	trackedGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // KTX2 rows are tightly packed
+
+	for (uint32_t i = 0; i < numLevels; i++)
+	{
+		const int levelWidth = std::max(width >> i, 1);
+		const int levelHeight = std::max(height >> i, 1);
+		if (info->format == 0)
+		{
+			trackedCompressedTexImage2D(GL_TEXTURE_2D, i, info->internalFormat, levelWidth, levelHeight,
+				0, (GLsizei)levels[i].uncompressedByteLength, levels[i].data);
+		}
+		else {
+			trackedTexImage2D(GL_TEXTURE_2D, i, info->internalFormat, levelWidth, levelHeight,
+				0, info->format, info->type, levels[i].data);
+		}
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// levelCount 0 asks the loader to generate the chain, which is only possible for uncompressed data
+	const bool generateMipmaps = levelCount == 0 && info->format != 0;
+	if (generateMipmaps) {
+		trackedGenerateMipmap(GL_TEXTURE_2D);
+	}
+	else {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+	}
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, generateMipmaps || numLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	return textureID;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <glad/glad.h>
+
+/** \brief Loads a 2D KTX2 texture. Drop-in replacement for loadTexture() for .ktx2 files.
+*
+*   The file is memory mapped, its level index validated, and every level is passed to OpenGL
+*   straight from the mapping. Zstandard supercompressed levels are decoded in parallel when
+*   built with KTX2_WITH_ZSTD (link against libzstd), otherwise such files are rejected.
+*   If the file carries no mip levels (levelCount 0), they are generated after the upload.
+*
+*   \param path Path to the .ktx2 file
+*   \return OpenGL texture ID, or 0, if the file could not be loaded.
+*/
+GLuint loadKTX2(const char* path);
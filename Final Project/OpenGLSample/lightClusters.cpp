@@ -0,0 +1,304 @@
+// STL
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+// Project
+#include "lightClusters.h"
+#include "parallel.h"
+#include "resourceTracker.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CLUSTER_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+	const int TILES_PER_SLICE = LightClusters::TILES_X * LightClusters::TILES_Y;
+	const int TEXELS_PER_LIGHT = 4;
+
+	// Point on the ray through an NDC position at a view space depth (distance in front of the camera)
+	glm::vec3 pointAtDepth(const glm::mat4& inverseProjection, float x, float y, float depth)
+	{
+		glm::vec4 nearPoint = inverseProjection * glm::vec4(x, y, -1.0f, 1.0f);
+		glm::vec4 farPoint = inverseProjection * glm::vec4(x, y, 1.0f, 1.0f);
+		const glm::vec3 from = glm::vec3(nearPoint) / nearPoint.w;
+		const glm::vec3 to = glm::vec3(farPoint) / farPoint.w;
+		const float t = (-depth - from.z) / (to.z - from.z);
+		return from + (to - from) * t;
+	}
+
+	int sliceOf(float depth, float scale, float bias)
+	{
+		const int slice = (int)std::floor(std::log(std::max(depth, 1e-6f)) * scale + bias);
+		return std::min(std::max(slice, 0), LightClusters::SLICES - 1);
+	}
+}
+
+LightClusters::LightClusters()
+	: _minX(CLUSTER_COUNT), _minY(CLUSTER_COUNT), _minZ(CLUSTER_COUNT)
+	, _maxX(CLUSTER_COUNT), _maxY(CLUSTER_COUNT), _maxZ(CLUSTER_COUNT)
+	, _clusterLights(CLUSTER_COUNT)
+	, _grid(CLUSTER_COUNT * 2)
+{
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &_maxTexels);
+
+	const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+	trackedGenBuffers(3, _buffers);
+	trackedGenTextures(3, _textures);
+	for (int i = 0; i < 3; i++)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, _buffers[i]);
+		trackedBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, _textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], _buffers[i]);
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+LightClusters::~LightClusters()
+{
+	trackedDeleteTextures(3, _textures);
+	trackedDeleteBuffers(3, _buffers);
+}
+
+void LightClusters::setProjection(const glm::mat4& projection, float nearPlane, float farPlane)
+{
+	if (_hasBounds && projection == _projection && nearPlane == _nearPlane && farPlane == _farPlane) {
+		return;
+	}
+	_projection = projection;
+	_nearPlane = nearPlane;
+	_farPlane = farPlane;
+
+	// exponential slices: slice k covers [near * (far/near)^(k/SLICES), near * (far/near)^((k+1)/SLICES)]
+	const float logRange = std::log(farPlane / nearPlane);
+	_sliceScale = SLICES / logRange;
+	_sliceBias = -SLICES * std::log(nearPlane) / logRange;
+
+	buildClusterBounds();
+	_hasBounds = true;
+}
+
+void LightClusters::buildClusterBounds()
+{
+	const glm::mat4 inverseProjection = glm::inverse(_projection);
+	for (int slice = 0; slice < SLICES; slice++)
+	{
+		const float sliceNear = _nearPlane * std::pow(_farPlane / _nearPlane, (float)slice / SLICES);
+		const float sliceFar = _nearPlane * std::pow(_farPlane / _nearPlane, (float)(slice + 1) / SLICES);
+		for (int y = 0; y < TILES_Y; y++)
+		{
+			for (int x = 0; x < TILES_X; x++)
+			{
+				// the tile frustum between the two depths is the hull of its eight corners
+				glm::vec3 lower(1e30f);
+				glm::vec3 upper(-1e30f);
+				for (int corner = 0; corner < 8; corner++)
+				{
+					const float ndcX = -1.0f + 2.0f * (float)(x + (corner & 1)) / TILES_X;
+					const float ndcY = -1.0f + 2.0f * (float)(y + ((corner >> 1) & 1)) / TILES_Y;
+					const glm::vec3 p = pointAtDepth(inverseProjection, ndcX, ndcY, (corner & 4) ? sliceFar : sliceNear);
+					lower = glm::min(lower, p);
+					upper = glm::max(upper, p);
+				}
+
+				const int cluster = slice * TILES_PER_SLICE + y * TILES_X + x;
+				_minX[cluster] = lower.x;
+				_minY[cluster] = lower.y;
+				_minZ[cluster] = lower.z;
+				_maxX[cluster] = upper.x;
+				_maxY[cluster] = upper.y;
+				_maxZ[cluster] = upper.z;
+			}
+		}
+	}
+}
+
+void LightClusters::update(const std::vector<PointLight>& lights, const glm::mat4& view, JobCounter& uploaded)
+{
+	_lights = &lights;
+	_view = view;
+	JobSystem& jobs = JobSystem::instance();
+	jobs.run(&LightClusters::binJob, this, 0, 0, &_binned);
+	jobs.runOnMainThread(&LightClusters::uploadJob, this, 0, 0, &uploaded, &_binned);
+}
+
+void LightClusters::binJob(void* data, size_t, size_t)
+{
+	static_cast<LightClusters*>(data)->bin();
+}
+
+void LightClusters::uploadJob(void* data, size_t, size_t)
+{
+	static_cast<LightClusters*>(data)->upload();
+}
+
+void LightClusters::bin()
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+	const std::vector<PointLight>& lights = *_lights;
+	const glm::mat4& view = _view;
+
+	// light spheres to view space, and the depth slices they can touch
+	const size_t lightCount = std::min(lights.size(), (size_t)std::max(_maxTexels / TEXELS_PER_LIGHT, 0));
+	_lightX.resize(lightCount);
+	_lightY.resize(lightCount);
+	_lightZ.resize(lightCount);
+	_lightRadius.resize(lightCount);
+	_firstSlice.resize(lightCount);
+	_lastSlice.resize(lightCount);
+	_lightTexels.resize(lightCount * TEXELS_PER_LIGHT);
+	for (size_t i = 0; i < lightCount; i++)
+	{
+		const PointLight& light = lights[i];
+		const glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+		const float radius = light.range();
+		_lightX[i] = center.x;
+		_lightY[i] = center.y;
+		_lightZ[i] = center.z;
+		_lightRadius[i] = radius;
+		if (-center.z + radius < _nearPlane || -center.z - radius > _farPlane)
+		{
+			// nothing of it is inside the frustum depth range
+			_firstSlice[i] = 1;
+			_lastSlice[i] = 0;
+		}
+		else
+		{
+			_firstSlice[i] = sliceOf(-center.z - radius, _sliceScale, _sliceBias);
+			_lastSlice[i] = sliceOf(-center.z + radius, _sliceScale, _sliceBias);
+		}
+
+		// layout read by fetchPointLight() in 6.multiple_lights.fs
+		glm::vec4* texels = &_lightTexels[i * TEXELS_PER_LIGHT];
+		texels[0] = glm::vec4(light.position, light.constant);
+		texels[1] = glm::vec4(light.ambient, light.linear);
+		texels[2] = glm::vec4(light.diffuse, light.quadratic);
+		texels[3] = glm::vec4(light.specular, 0.0f);
+	}
+
+	parallelFor(SLICES, 1, [this](size_t begin, size_t end) {
+		for (size_t slice = begin; slice < end; slice++) {
+			binSlice((int)slice);
+		}
+	});
+
+	// pack the per-cluster lists back to back
+	_indices.clear();
+	bool overflow = false;
+	for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+	{
+		const std::vector<uint32_t>& list = _clusterLights[cluster];
+		const size_t count = std::min(list.size(), (size_t)_maxTexels - _indices.size());
+		overflow |= count < list.size();
+		_grid[cluster * 2] = (uint32_t)_indices.size();
+		_grid[cluster * 2 + 1] = (uint32_t)count;
+		_indices.insert(_indices.end(), list.begin(), list.begin() + count);
+	}
+	if (overflow && !_warnedOverflow)
+	{
+		std::cout << "WARNING::LIGHT_CLUSTERS: more cluster-light pairs than GL_MAX_TEXTURE_BUFFER_SIZE (" << _maxTexels << "), some lights are dropped" << std::endl;
+		_warnedOverflow = true;
+	}
+	_lightReferenceCount = _indices.size();
+	_binMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightClusters::upload()
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	// re-specifying the whole store lets the driver hand out fresh memory instead of waiting on the last frame
+	const size_t sizes[3] = { _lightTexels.size() * sizeof(glm::vec4), _grid.size() * sizeof(uint32_t), _indices.size() * sizeof(uint32_t) };
+	const void* data[3] = { _lightTexels.data(), _grid.data(), _indices.data() };
+	for (int i = 0; i < 3; i++)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, _buffers[i]);
+		trackedBufferData(GL_TEXTURE_BUFFER, std::max(sizes[i], (size_t)16), nullptr, GL_STREAM_DRAW);
+		if (sizes[i] > 0) {
+			glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]);
+		}
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	_lastUpdateMilliseconds = _binMilliseconds + std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightClusters::binSlice(int slice)
+{
+	const int first = slice * TILES_PER_SLICE;
+	for (int tile = 0; tile < TILES_PER_SLICE; tile++) {
+		_clusterLights[first + tile].clear();
+	}
+
+	for (size_t light = 0; light < _lightX.size(); light++)
+	{
+		if (slice < _firstSlice[light] || slice > _lastSlice[light]) {
+			continue;
+		}
+		const float x = _lightX[light], y = _lightY[light], z = _lightZ[light];
+		const float radiusSquared = _lightRadius[light] * _lightRadius[light];
+
+#ifdef CLUSTER_USE_SSE2
+		// squared distance from the sphere center to four boxes at once
+		const __m128 centerX = _mm_set1_ps(x), centerY = _mm_set1_ps(y), centerZ = _mm_set1_ps(z);
+		const __m128 limit = _mm_set1_ps(radiusSquared);
+		const __m128 zero = _mm_setzero_ps();
+		for (int tile = 0; tile < TILES_PER_SLICE; tile += 4)
+		{
+			const int cluster = first + tile;
+			const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&_minX[cluster]), centerX), _mm_sub_ps(centerX, _mm_loadu_ps(&_maxX[cluster]))), zero);
+			const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&_minY[cluster]), centerY), _mm_sub_ps(centerY, _mm_loadu_ps(&_maxY[cluster]))), zero);
+			const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&_minZ[cluster]), centerZ), _mm_sub_ps(centerZ, _mm_loadu_ps(&_maxZ[cluster]))), zero);
+			const __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			int hits = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, limit));
+			for (int lane = 0; hits != 0; lane++, hits >>= 1)
+			{
+				if (hits & 1) {
+					_clusterLights[cluster + lane].push_back((uint32_t)light);
+				}
+			}
+		}
+#else
+		for (int tile = 0; tile < TILES_PER_SLICE; tile++)
+		{
+			const int cluster = first + tile;
+			const float dx = std::max(std::max(_minX[cluster] - x, x - _maxX[cluster]), 0.0f);
+			const float dy = std::max(std::max(_minY[cluster] - y, y - _maxY[cluster]), 0.0f);
+			const float dz = std::max(std::max(_minZ[cluster] - z, z - _maxZ[cluster]), 0.0f);
+			if (dx * dx + dy * dy + dz * dz <= radiusSquared) {
+				_clusterLights[cluster].push_back((uint32_t)light);
+			}
+		}
+#endif
+	}
+}
+
+void LightClusters::bind(const Shader& shader) const
+{
+	const char* samplers[3] = { "clusterLights", "clusterGrid", "clusterLightIndices" };
+	for (int i = 0; i < 3; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + FIRST_TEXTURE_UNIT + i);
+		glBindTexture(GL_TEXTURE_BUFFER, _textures[i]);
+		shader.setInt(samplers[i], FIRST_TEXTURE_UNIT + i);
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	shader.setMat4("clusterView", _view);
+	shader.setVec2("clusterSliceScaleBias", glm::vec2(_sliceScale, _sliceBias));
+}
+
+size_t LightClusters::lightReferenceCount() const
+{
+	return _lightReferenceCount;
+}
+
+double LightClusters::lastUpdateMilliseconds() const
+{
+	return _lastUpdateMilliseconds;
+}
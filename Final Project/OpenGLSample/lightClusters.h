@@ -0,0 +1,107 @@
+#pragma once
+
+// STL
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Project
+#include "jobSystem.h"
+#include "lighting.h"
+#include "shader.h"
+
+/**
+  Clustered forward lighting. The view frustum is split into a grid of clusters (screen tiles
+  times exponential depth slices) and every frame the point lights are binned into the clusters
+  their sphere of influence touches. The binning runs on the CPU as a job, one depth slice per task,
+  with one light tested against four clusters at a time, while the main thread goes on with the
+  frame; the upload is a main thread job that depends on it. The lights, the per-cluster (offset, count)
+  grid and the light index lists go to the GPU as texture buffers; a fragment only walks the
+  lights of its own cluster, so the cost per pixel follows the local light density instead of
+  the number of lights in the scene.
+*/
+class LightClusters
+{
+public:
+	// Grid resolution, 16:9 tiles so that clusters are roughly square at the default aspect ratio
+	static const int TILES_X = 16;
+	static const int TILES_Y = 9;
+	static const int SLICES = 24;
+	static const int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+	static const int FIRST_TEXTURE_UNIT = 2; //!< bind() uses this unit and the next two, the units below are left to the material
+
+	LightClusters();
+	~LightClusters();
+
+	/** \brief Sets the projection the grid is built for. Cluster bounds are only recomputed when it changes.
+	*   \param projection Projection matrix (perspective or orthographic)
+	*   \param nearPlane  Distance of the near plane, the first depth slice starts here
+	*   \param farPlane   Distance of the far plane, the last depth slice ends here
+	*/
+	void setProjection(const glm::mat4& projection, float nearPlane, float farPlane);
+
+	/** \brief Bins the lights into the clusters on the worker threads, then uploads the result on the main thread. Returns right away.
+	*   Call it on the main thread, once per frame; until uploaded is zero (JobSystem::wait()) the lights must not change and bind() must not be used.
+	*   \param lights   Point lights of the scene
+	*   \param view     View matrix of the frame
+	*   \param uploaded Incremented now and decremented once the clusters are on the GPU
+	*/
+	void update(const std::vector<PointLight>& lights, const glm::mat4& view, JobCounter& uploaded);
+
+	/** \brief Binds the texture buffers and sets the cluster uniforms on a CLUSTERED_LIGHTING variant, the binning view among them:
+	*   the shaders look fragments up in the clusters the lights were binned into, not under the (late latched) view they are drawn with.
+	*   \param shader Variant, it has to be in use
+	*/
+	void bind(const Shader& shader) const;
+
+	/** \brief Gets number of cluster-light pairs found by the last finished update(). */
+	size_t lightReferenceCount() const;
+
+	/** \brief Gets the CPU time spent in the last finished update() in milliseconds (binning and upload, not the wait between). */
+	double lastUpdateMilliseconds() const;
+
+private:
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	static void binJob(void* data, size_t begin, size_t end);
+	static void uploadJob(void* data, size_t begin, size_t end);
+	void buildClusterBounds();
+	void bin();
+	void binSlice(int slice);
+	void upload();
+
+	glm::mat4 _projection;
+	float _nearPlane = 0.0f;
+	float _farPlane = 0.0f;
+	float _sliceScale = 0.0f; //! slice = log(depth) * _sliceScale + _sliceBias
+	float _sliceBias = 0.0f;
+	bool _hasBounds = false;
+
+	// view space cluster bounds, structure of arrays so four clusters load into one register
+	std::vector<float> _minX, _minY, _minZ, _maxX, _maxY, _maxZ;
+
+	// what the frame's update() bins
+	const std::vector<PointLight>* _lights = nullptr;
+	glm::mat4 _view;
+	JobCounter _binned; //! The upload job depends on it
+
+	// view space light spheres of the frame being binned, and the slices each one spans
+	std::vector<float> _lightX, _lightY, _lightZ, _lightRadius;
+	std::vector<int> _firstSlice, _lastSlice;
+
+	std::vector<std::vector<uint32_t>> _clusterLights; //! Light indices per cluster, capacity kept across frames
+	std::vector<uint32_t> _grid; //! (offset, count) per cluster
+	std::vector<uint32_t> _indices; //! All index lists back to back
+	std::vector<glm::vec4> _lightTexels;
+
+	GLuint _buffers[3] = {};
+	GLuint _textures[3] = {};
+	GLint _maxTexels = 0; //! GL_MAX_TEXTURE_BUFFER_SIZE
+	bool _warnedOverflow = false;
+	size_t _lightReferenceCount = 0;
+	double _binMilliseconds = 0.0;
+	double _lastUpdateMilliseconds = 0.0;
+};
@@ -0,0 +1,170 @@
+// STL
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+
+// Project
+#include "lighting.h"
+
+namespace {
+
+	// Contributions below half an 8-bit step are invisible
+	const float VISIBLE_THRESHOLD = 0.5f / 255.0f;
+
+	float maxComponent(const glm::vec3& v)
+	{
+		return std::max(v.x, std::max(v.y, v.z));
+	}
+
+	// Solves constant + linear * d + quadratic * d^2 = intensity / threshold for d
+	float attenuationRange(float constant, float linear, float quadratic, float intensity)
+	{
+		const float target = intensity / VISIBLE_THRESHOLD;
+		if (target <= constant) {
+			return 0.0f;
+		}
+		if (quadratic <= 0.0f) {
+			return linear > 0.0f ? (target - constant) / linear : std::numeric_limits<float>::max();
+		}
+		return (-linear + std::sqrt(linear * linear + 4.0f * quadratic * (target - constant))) / (2.0f * quadratic);
+	}
+
+	// Cone against sphere, conservative (the cone is treated as infinitely thin at the apex)
+	bool spotLightReaches(const SpotLight& light, const glm::vec3& center, float radius)
+	{
+		const glm::vec3 toCenter = center - light.position;
+		const float distanceSquared = glm::dot(toCenter, toCenter);
+		const float distanceAlongAxis = glm::dot(toCenter, glm::normalize(light.direction));
+		if (distanceAlongAxis < -radius || distanceAlongAxis > light.range() + radius) {
+			return false;
+		}
+
+		const float sinOuter = std::sqrt(std::max(0.0f, 1.0f - light.outerCutOff * light.outerCutOff));
+		const float distanceFromAxis = std::sqrt(std::max(0.0f, distanceSquared - distanceAlongAxis * distanceAlongAxis));
+		const float distanceFromCone = light.outerCutOff * distanceFromAxis - distanceAlongAxis * sinOuter;
+		return distanceFromCone <= radius;
+	}
+
+	// Feature bits that do not depend on how the point lights are delivered
+	uint32_t sharedFeatures(const SceneLights& lights, const glm::vec3& center, float radius, bool hasSpecularMap)
+	{
+		uint32_t features = 0;
+		if (lights.spotLightOn && spotLightReaches(lights.spotLight, center, radius)) {
+			features |= LIGHTING_SPOT_LIGHT;
+		}
+		if (hasSpecularMap) {
+			features |= LIGHTING_SPECULAR_MAP;
+		}
+		return features;
+	}
+
+	void setPointLight(const Shader& shader, int slot, const PointLight& light)
+	{
+		const std::string name = "pointLights[" + std::to_string(slot) + "].";
+		shader.setVec3(name + "position", light.position);
+		shader.setVec3(name + "ambient", light.ambient);
+		shader.setVec3(name + "diffuse", light.diffuse);
+		shader.setVec3(name + "specular", light.specular);
+		shader.setFloat(name + "constant", light.constant);
+		shader.setFloat(name + "linear", light.linear);
+		shader.setFloat(name + "quadratic", light.quadratic);
+	}
+}
+
+float PointLight::range() const
+{
+	return attenuationRange(constant, linear, quadratic, maxComponent(ambient + diffuse + specular));
+}
+
+float SpotLight::range() const
+{
+	return attenuationRange(constant, linear, quadratic, maxComponent(ambient + diffuse + specular));
+}
+
+std::vector<ShaderPermutations::Define> lightingPermutationDefines()
+{
+	return {
+		{ "NR_POINT_LIGHTS", LIGHTING_POINT_LIGHT_COUNT },
+		{ "USE_SPOT_LIGHT", LIGHTING_SPOT_LIGHT },
+		{ "HAS_SPECULAR_MAP", LIGHTING_SPECULAR_MAP },
+		{ "CLUSTERED_LIGHTING", LIGHTING_CLUSTERED },
+	};
+}
+
+uint32_t selectLighting(const SceneLights& lights, const glm::vec3& center, float radius, bool hasSpecularMap, std::vector<int>& pointLightIndices)
+{
+	// rank the lights that reach the sphere by how close they get to it relative to their range; the scratch
+	// list is per thread, as draws are set up across the worker threads every frame
+	thread_local std::vector<std::pair<float, int>> reaching;
+	reaching.clear();
+	for (size_t i = 0; i < lights.pointLights.size(); i++)
+	{
+		const PointLight& light = lights.pointLights[i];
+		const float gap = glm::length(light.position - center) - radius;
+		const float range = light.range();
+		if (gap <= range) {
+			reaching.push_back(std::make_pair(gap / range, (int)i));
+		}
+	}
+	if (reaching.size() > MAX_POINT_LIGHTS_PER_DRAW)
+	{
+		std::partial_sort(reaching.begin(), reaching.begin() + MAX_POINT_LIGHTS_PER_DRAW, reaching.end());
+		reaching.resize(MAX_POINT_LIGHTS_PER_DRAW);
+	}
+
+	pointLightIndices.clear();
+	for (const auto& light : reaching) {
+		pointLightIndices.push_back(light.second);
+	}
+	std::sort(pointLightIndices.begin(), pointLightIndices.end());
+
+	return (uint32_t)pointLightIndices.size() | sharedFeatures(lights, center, radius, hasSpecularMap);
+}
+
+uint32_t selectClusteredLighting(const SceneLights& lights, const glm::vec3& center, float radius, bool hasSpecularMap)
+{
+	return LIGHTING_CLUSTERED | sharedFeatures(lights, center, radius, hasSpecularMap);
+}
+
+void setFrameLighting(const Shader& shader, const SceneLights& lights, uint32_t features)
+{
+	shader.setInt("material.diffuse", 0);
+	shader.setInt("material.specular", 1);
+	shader.setFloat("material.shininess", 32.0f);
+
+	shader.setVec3("dirLight.direction", lights.dirLight.direction);
+	shader.setVec3("dirLight.ambient", lights.dirLight.ambient);
+	shader.setVec3("dirLight.diffuse", lights.dirLight.diffuse);
+	shader.setVec3("dirLight.specular", lights.dirLight.specular);
+
+	if (features & LIGHTING_SPOT_LIGHT)
+	{
+		const SpotLight& spotLight = lights.spotLight;
+		shader.setVec3("spotLight.ambient", spotLight.ambient);
+		shader.setVec3("spotLight.diffuse", spotLight.diffuse);
+		shader.setVec3("spotLight.specular", spotLight.specular);
+		shader.setFloat("spotLight.constant", spotLight.constant);
+		shader.setFloat("spotLight.linear", spotLight.linear);
+		shader.setFloat("spotLight.quadratic", spotLight.quadratic);
+		shader.setFloat("spotLight.cutOff", spotLight.cutOff);
+		shader.setFloat("spotLight.outerCutOff", spotLight.outerCutOff);
+	}
+}
+
+void setPointLights(const Shader& shader, const SceneLights& lights, const std::vector<int>& indices)
+{
+	for (size_t slot = 0; slot < indices.size(); slot++) {
+		setPointLight(shader, (int)slot, lights.pointLights[indices[slot]]);
+	}
+}
+
+uint64_t pointLightSelectionKey(const std::vector<int>& indices)
+{
+	// indices are ascending, so the set of lights identifies the selection
+	uint64_t key = 0;
+	for (int index : indices) {
+		key |= 1ull << (index & 63);
+	}
+	return key;
+}
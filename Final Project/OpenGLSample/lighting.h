@@ -0,0 +1,106 @@
+#pragma once
+
+// STL
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Project
+#include "shader.h"
+#include "shaderPermutations.h"
+
+// The light types of 6.multiple_lights.fs, member for member
+struct DirLight
+{
+	glm::vec3 direction;
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+};
+
+struct PointLight
+{
+	glm::vec3 position;
+	float constant;
+	float linear;
+	float quadratic;
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+
+	/** \brief Gets the distance beyond which the light adds less than half an 8-bit step to any channel. */
+	float range() const;
+};
+
+struct SpotLight
+{
+	glm::vec3 position;
+	glm::vec3 direction;
+	float cutOff; //!< Cosine of the inner cone angle
+	float outerCutOff; //!< Cosine of the outer cone angle
+	float constant;
+	float linear;
+	float quadratic;
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+
+	/** \brief Gets the distance beyond which the light adds less than half an 8-bit step to any channel. */
+	float range() const;
+};
+
+struct SceneLights
+{
+	DirLight dirLight;
+	std::vector<PointLight> pointLights;
+	SpotLight spotLight;
+	bool spotLightOn = true;
+};
+
+// Feature bits of the lighting shader permutations
+const uint32_t LIGHTING_POINT_LIGHT_COUNT = 0x07; //!< Number of point lights the variant evaluates
+const uint32_t LIGHTING_SPOT_LIGHT = 0x08;
+const uint32_t LIGHTING_SPECULAR_MAP = 0x10;
+const uint32_t LIGHTING_CLUSTERED = 0x20; //!< Point lights come from LightClusters instead of the pointLights[] uniforms
+const int MAX_POINT_LIGHTS_PER_DRAW = 4;
+
+/** \brief Gets the defines the lighting feature bits map to in 6.multiple_lights.fs. */
+std::vector<ShaderPermutations::Define> lightingPermutationDefines();
+
+/** \brief Picks the cheapest lighting variant for an object: only lights that reach its bounding sphere are evaluated.
+*   \param lights            All lights of the scene
+*   \param center            World space center of the bounding sphere
+*   \param radius            World space radius of the bounding sphere
+*   \param hasSpecularMap    True if a specular map is bound for the object
+*   \param pointLightIndices Receives the point lights to evaluate, in ascending order (at most MAX_POINT_LIGHTS_PER_DRAW)
+*   \return Feature mask of the variant.
+*/
+uint32_t selectLighting(const SceneLights& lights, const glm::vec3& center, float radius, bool hasSpecularMap, std::vector<int>& pointLightIndices);
+
+/** \brief Picks the lighting variant for an object when the point lights are clustered (see LightClusters).
+*   \param lights         All lights of the scene
+*   \param center         World space center of the bounding sphere
+*   \param radius         World space radius of the bounding sphere
+*   \param hasSpecularMap True if a specular map is bound for the object
+*   \return Feature mask of the variant.
+*/
+uint32_t selectClusteredLighting(const SceneLights& lights, const glm::vec3& center, float radius, bool hasSpecularMap);
+
+/** \brief Sets the uniforms every object of a frame shares (directional light, spot light, material) on a variant.
+*   The camera and the spot light's position and direction are in the Camera block, see CameraBlock.
+*   \param shader   Variant, it has to be in use
+*   \param lights   All lights of the scene
+*   \param features Feature mask of the variant
+*/
+void setFrameLighting(const Shader& shader, const SceneLights& lights, uint32_t features);
+
+/** \brief Uploads the selected point lights into the pointLights[] array of a variant.
+*   \param shader  Variant, it has to be in use
+*   \param lights  All lights of the scene
+*   \param indices Lights returned by selectLighting()
+*/
+void setPointLights(const Shader& shader, const SceneLights& lights, const std::vector<int>& indices);
+
+/** \brief Gets a key identifying a point light selection, to skip uploading the same lights again. */
+uint64_t pointLightSelectionKey(const std::vector<int>& indices);
@@ -0,0 +1,43 @@
+#pragma once
+
+// STL
+#include <cstddef>
+
+/**
+  Read-only memory mapping of a whole file. The mapped bytes can be handed straight to
+  OpenGL (glTexImage2D, glBufferData...) without copying them into a buffer first.
+*/
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/** \brief Maps the file into memory (unmaps previously mapped file, if any).
+	*   \param path Path to the file
+	*   \return True if the file has been mapped or false otherwise.
+	*/
+	bool open(const char* path);
+
+	//* \brief Unmaps the file.
+	void close();
+
+	/** \brief Gets pointer to the mapped bytes.
+	*   \return Pointer to the first byte, or nullptr, if nothing is mapped.
+	*/
+	const unsigned char* data() const;
+
+	/** \brief Gets size of the mapped file, in bytes. */
+	size_t size() const;
+
+private:
+	const unsigned char* _data = nullptr; //! Start of the mapping
+	size_t _size = 0; //! Size of the mapping in bytes
+#ifdef _WIN32
+	void* _fileHandle = nullptr; //! HANDLE of the opened file
+	void* _mappingHandle = nullptr; //! HANDLE of the file mapping object
+#endif
+};
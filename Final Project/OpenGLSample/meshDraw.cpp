@@ -0,0 +1,135 @@
+// STL
+#include <algorithm>
+#include <iostream>
+
+// Project
+#include "meshDraw.h"
+
+namespace {
+
+	size_t indexSize(GLenum indexType)
+	{
+		return indexType == GL_UNSIGNED_BYTE ? 1 : indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+	}
+
+	// appends the triangles of one primitive run, vertex indices are relative to the run
+	void appendTriangles(GLenum mode, const GLuint* vertices, size_t count, std::vector<GLuint>& triangles)
+	{
+		if (mode == GL_TRIANGLES)
+		{
+			triangles.insert(triangles.end(), vertices, vertices + count / 3 * 3);
+			return;
+		}
+		for (size_t i = 2; i < count; i++)
+		{
+			if (mode == GL_TRIANGLE_FAN) {
+				triangles.insert(triangles.end(), { vertices[0], vertices[i - 1], vertices[i] });
+			}
+			// strips alternate winding, swapping every other triangle keeps it consistent
+			else if (i % 2 == 0) {
+				triangles.insert(triangles.end(), { vertices[i - 2], vertices[i - 1], vertices[i] });
+			}
+			else {
+				triangles.insert(triangles.end(), { vertices[i - 1], vertices[i - 2], vertices[i] });
+			}
+		}
+	}
+}
+
+bool readVertexPositions(GLuint vertexArray, GLint first, GLsizei count, std::vector<float>& positions)
+{
+	glBindVertexArray(vertexArray);
+	GLint buffer = 0, size = 0, type = 0, stride = 0;
+	void* pointer = nullptr;
+	glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &buffer);
+	glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_SIZE, &size);
+	glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_TYPE, &type);
+	glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &stride);
+	glGetVertexAttribPointerv(0, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pointer);
+	if (buffer == 0 || size != 3 || type != GL_FLOAT || count <= 0)
+	{
+		std::cout << "ERROR::MESH_DRAW: attribute 0 of vertex array " << vertexArray << " is not a float3 position buffer" << std::endl;
+		return false;
+	}
+
+	// one read of the whole range, then keep every position and drop the other attributes
+	const size_t vertexStride = stride != 0 ? (size_t)stride : 3 * sizeof(float);
+	const size_t offset = reinterpret_cast<size_t>(pointer) + first * vertexStride;
+	std::vector<unsigned char> data((count - 1) * vertexStride + 3 * sizeof(float));
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glGetBufferSubData(GL_ARRAY_BUFFER, offset, data.size(), data.data());
+
+	positions.resize(count * 3);
+	for (GLsizei i = 0; i < count; i++) {
+		std::copy_n(reinterpret_cast<const float*>(&data[i * vertexStride]), 3, &positions[i * 3]);
+	}
+	return true;
+}
+
+bool readMeshIndices(const MeshDraw& mesh, std::vector<GLuint>& indices)
+{
+	glBindVertexArray(mesh.vertexArray);
+	GLint elementBuffer = 0;
+	glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elementBuffer);
+	if (elementBuffer == 0 || mesh.indexCount <= 0)
+	{
+		std::cout << "ERROR::MESH_DRAW: vertex array " << mesh.vertexArray << " has no element buffer" << std::endl;
+		return false;
+	}
+
+	std::vector<unsigned char> data(mesh.indexCount * indexSize(mesh.indexType));
+	glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexByteOffset, data.size(), data.data());
+	indices.resize(mesh.indexCount);
+	for (GLsizei i = 0; i < mesh.indexCount; i++)
+	{
+		switch (mesh.indexType)
+		{
+		case GL_UNSIGNED_BYTE: indices[i] = data[i]; break;
+		case GL_UNSIGNED_SHORT: indices[i] = reinterpret_cast<const GLushort*>(data.data())[i]; break;
+		default: indices[i] = reinterpret_cast<const GLuint*>(data.data())[i]; break;
+		}
+	}
+	return true;
+}
+
+bool readMeshTriangles(const MeshDraw& mesh, std::vector<glm::vec3>& positions, std::vector<GLuint>& triangles)
+{
+	positions.clear();
+	triangles.clear();
+	std::vector<float> floats;
+	if (mesh.indexCount > 0)
+	{
+		std::vector<GLuint> indices;
+		if (!readMeshIndices(mesh, indices)) {
+			return false;
+		}
+		const GLuint lowest = *std::min_element(indices.begin(), indices.end());
+		const GLuint highest = *std::max_element(indices.begin(), indices.end());
+		if (!readVertexPositions(mesh.vertexArray, (GLint)lowest, (GLsizei)(highest - lowest + 1), floats)) {
+			return false;
+		}
+		for (GLuint& index : indices) {
+			index -= lowest;
+		}
+		appendTriangles(mesh.mode, indices.data(), indices.size(), triangles);
+	}
+
+	for (const DrawRange& range : mesh.ranges)
+	{
+		std::vector<float> rangeFloats;
+		if (!readVertexPositions(mesh.vertexArray, range.first, range.count, rangeFloats)) {
+			return false;
+		}
+		std::vector<GLuint> vertices(range.count);
+		for (GLsizei i = 0; i < range.count; i++) {
+			vertices[i] = (GLuint)(floats.size() / 3 + i);
+		}
+		appendTriangles(range.mode, vertices.data(), vertices.size(), triangles);
+		floats.insert(floats.end(), rangeFloats.begin(), rangeFloats.end());
+	}
+
+	for (size_t i = 0; i + 2 < floats.size(); i += 3) {
+		positions.push_back(glm::vec3(floats[i], floats[i + 1], floats[i + 2]));
+	}
+	return true;
+}
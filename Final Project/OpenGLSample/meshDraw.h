@@ -0,0 +1,97 @@
+#pragma once
+
+// STL
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+struct DrawRange
+{
+	GLenum mode; //!< Primitive type, e.g. GL_TRIANGLES or GL_TRIANGLE_STRIP
+	GLint first;
+	GLsizei count;
+};
+
+/**
+  How one mesh is drawn: its vertex array and either a list of glDrawArrays ranges or one
+  indexed draw. Lets passes other than the main one (e.g. the depth pre-pass) find out what
+  a mesh consists of without knowing how it was built.
+*/
+struct MeshDraw
+{
+	GLuint vertexArray = 0;
+	std::vector<DrawRange> ranges; //!< Non-indexed meshes
+	GLenum mode = GL_TRIANGLES; //!< Indexed meshes
+	GLsizei indexCount = 0; //!< Non-zero for indexed meshes
+	GLenum indexType = GL_UNSIGNED_SHORT;
+	size_t indexByteOffset = 0;
+};
+
+/** \brief Describes a non-indexed mesh drawn with one glDrawArrays call. */
+inline MeshDraw arraysMesh(GLuint vertexArray, GLenum mode, GLint first, GLsizei count)
+{
+	MeshDraw mesh;
+	mesh.vertexArray = vertexArray;
+	mesh.ranges.push_back({ mode, first, count });
+	return mesh;
+}
+
+/** \brief Describes an indexed mesh, the element buffer is the one bound to the vertex array. */
+inline MeshDraw elementsMesh(GLuint vertexArray, GLenum mode, GLsizei indexCount, GLenum indexType, size_t indexByteOffset)
+{
+	MeshDraw mesh;
+	mesh.vertexArray = vertexArray;
+	mesh.mode = mode;
+	mesh.indexCount = indexCount;
+	mesh.indexType = indexType;
+	mesh.indexByteOffset = indexByteOffset;
+	return mesh;
+}
+
+/** \brief Binds the mesh's vertex array and issues its draw calls. */
+inline void drawMesh(const MeshDraw& mesh)
+{
+	glBindVertexArray(mesh.vertexArray);
+	if (mesh.indexCount > 0) {
+		glDrawElements(mesh.mode, mesh.indexCount, mesh.indexType, (void*)mesh.indexByteOffset);
+	}
+	for (const DrawRange& range : mesh.ranges) {
+		glDrawArrays(range.mode, range.first, range.count);
+	}
+}
+
+/** \brief Gets the number of vertices a mesh's draw calls process (indices for indexed meshes). */
+inline GLsizei meshVertexCount(const MeshDraw& mesh)
+{
+	GLsizei count = mesh.indexCount;
+	for (const DrawRange& range : mesh.ranges) {
+		count += range.count;
+	}
+	return count;
+}
+
+/** \brief Reads vertex positions back from the buffer behind attribute 0 of a vertex array.
+*   \param vertexArray Vertex array, attribute 0 has to hold 3 float positions
+*   \param first       First vertex
+*   \param count       Number of vertices
+*   \param positions   Receives 3 floats per vertex
+*   \return True if the positions have been read or false otherwise.
+*/
+bool readVertexPositions(GLuint vertexArray, GLint first, GLsizei count, std::vector<float>& positions);
+
+/** \brief Reads the indices of an indexed mesh back from the element buffer of its vertex array.
+*   \param mesh    Indexed mesh
+*   \param indices Receives the indices, widened to 32 bits
+*   \return True if the indices have been read or false otherwise.
+*/
+bool readMeshIndices(const MeshDraw& mesh, std::vector<GLuint>& indices);
+
+/** \brief Reads a mesh back as a triangle list, strips and fans are unrolled.
+*   \param mesh      Mesh, made of triangles, strips or fans
+*   \param positions Receives the positions of the vertices used
+*   \param triangles Receives 3 indices into positions per triangle
+*   \return True if the mesh has been read or false otherwise.
+*/
+bool readMeshTriangles(const MeshDraw& mesh, std::vector<glm::vec3>& positions, std::vector<GLuint>& triangles);
@@ -0,0 +1,508 @@
+// STL
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <glad/glad.h>
+
+// Project
+#include "mipGenerator.h"
+#include "parallel.h"
+#include "stb_image.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_USE_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+	// sRGB <-> linear lookup tables, linear values are 14-bit fixed point so that the sum of a 2x2 block fits 16 bits
+	struct SrgbTables
+	{
+		unsigned short toLinear[256];
+		unsigned char fromLinear[4096]; //!< Indexed by the top 12 bits of the 14-bit linear value
+
+		SrgbTables()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				const double c = i / 255.0;
+				const double linear = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+				toLinear[i] = (unsigned short)std::lround(linear * 16383.0);
+			}
+			for (int i = 0; i < 4096; i++)
+			{
+				const double linear = (i + 0.5) / 4096.0;
+				const double c = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+				fromLinear[i] = (unsigned char)std::lround(std::min(std::max(c, 0.0), 1.0) * 255.0);
+			}
+		}
+	};
+
+	const SrgbTables& srgbTables()
+	{
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	// Scalar kernel, handles any channel count, clamped edges and the tails of the SIMD loops
+	void downsampleRowScalar(const unsigned char* row0, const unsigned char* row1, int srcWidth, int channels,
+		unsigned char* dst, int firstX, int dstWidth)
+	{
+		for (int x = firstX; x < dstWidth; x++)
+		{
+			const int x0 = std::min(x * 2, srcWidth - 1) * channels;
+			const int x1 = std::min(x * 2 + 1, srcWidth - 1) * channels;
+			for (int c = 0; c < channels; c++) {
+				dst[x * channels + c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+			}
+		}
+	}
+
+	// Gamma-correct version: colour channels are averaged in linear space, alpha (4th channel) as is
+	void downsampleRowSrgb(const unsigned char* row0, const unsigned char* row1, int srcWidth, int channels,
+		unsigned char* dst, int firstX, int dstWidth)
+	{
+		const auto& tables = srgbTables();
+		const int colorChannels = channels == 4 ? 3 : channels;
+		for (int x = firstX; x < dstWidth; x++)
+		{
+			const int x0 = std::min(x * 2, srcWidth - 1) * channels;
+			const int x1 = std::min(x * 2 + 1, srcWidth - 1) * channels;
+			for (int c = 0; c < colorChannels; c++)
+			{
+				const unsigned int sum = tables.toLinear[row0[x0 + c]] + tables.toLinear[row0[x1 + c]]
+					+ tables.toLinear[row1[x0 + c]] + tables.toLinear[row1[x1 + c]];
+				dst[x * channels + c] = tables.fromLinear[(sum + 2) >> 4];
+			}
+			if (channels == 4) {
+				dst[x * 4 + 3] = (unsigned char)((row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3] + 2) >> 2);
+			}
+		}
+	}
+
+#ifdef MIP_USE_SSE2
+
+	// 8 R8 outputs per iteration
+	int downsampleRowR8_SSE2(const unsigned char* row0, const unsigned char* row1, unsigned char* dst, int dstWidth)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i ones = _mm_set1_epi16(1);
+		const __m128i two = _mm_set1_epi16(2);
+		int x = 0;
+		for (; x + 8 <= dstWidth; x += 8)
+		{
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 2));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 2));
+			const __m128i sumLo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+			const __m128i sumHi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+			// madd adds horizontally adjacent 16-bit lanes, which are exactly the column pairs
+			__m128i sum = _mm_packs_epi32(_mm_madd_epi16(sumLo, ones), _mm_madd_epi16(sumHi, ones));
+			sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(sum, sum));
+		}
+		return x;
+	}
+
+	// 2 RGB8 outputs per iteration, reads 4 bytes past the 12 it uses
+	int downsampleRowRGB8_SSE2(const unsigned char* row0, const unsigned char* row1, int srcWidth, unsigned char* dst, int dstWidth)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i two = _mm_set1_epi16(2);
+		const __m128i firstPixel = _mm_set_epi16(0, 0, 0, 0, 0, -1, -1, -1);
+		int x = 0;
+		for (; x + 2 <= dstWidth && x * 6 + 16 <= srcWidth * 3; x += 2)
+		{
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 6));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 6));
+			const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)); // p0 p1 p2.rg
+			const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)); // p2.b p3 ...
+			const __m128i out0 = _mm_add_epi16(lo, _mm_srli_si128(lo, 6));
+			const __m128i p23 = _mm_or_si128(_mm_srli_si128(lo, 12), _mm_slli_si128(hi, 4));
+			const __m128i out1 = _mm_add_epi16(p23, _mm_srli_si128(p23, 6));
+			__m128i sum = _mm_or_si128(_mm_and_si128(out0, firstPixel), _mm_slli_si128(_mm_and_si128(out1, firstPixel), 6));
+			sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+
+			unsigned char packed[16];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(packed), _mm_packus_epi16(sum, zero));
+			memcpy(dst + x * 3, packed, 6);
+		}
+		return x;
+	}
+
+	// 4 RGBA8 outputs per iteration
+	int downsampleRowRGBA8_SSE2(const unsigned char* row0, const unsigned char* row1, unsigned char* dst, int dstWidth)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i two = _mm_set1_epi16(2);
+		int x = 0;
+		for (; x + 4 <= dstWidth; x += 4)
+		{
+			const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+			const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 16));
+			const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+			const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 16));
+			const __m128i p01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+			const __m128i p23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+			const __m128i p45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+			const __m128i p67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+			// one pixel per 64-bit half, so pair columns by interleaving the halves
+			__m128i out01 = _mm_add_epi16(_mm_unpacklo_epi64(p01, p23), _mm_unpackhi_epi64(p01, p23));
+			__m128i out23 = _mm_add_epi16(_mm_unpacklo_epi64(p45, p67), _mm_unpackhi_epi64(p45, p67));
+			out01 = _mm_srli_epi16(_mm_add_epi16(out01, two), 2);
+			out23 = _mm_srli_epi16(_mm_add_epi16(out23, two), 2);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(out01, out23));
+		}
+		return x;
+	}
+
+	// sRGB RGB8 and RGBA8, 2 outputs per iteration. There is no gather before AVX2, so decoding and encoding stay table
+	// lookups: both rows are decoded into one linear sum per column first, then the column pairs are added, rounded and
+	// shifted down to encode table indices 8 channels at a time
+	int downsampleRowSrgb_SSE2(const unsigned char* row0, const unsigned char* row1, int srcWidth, int channels,
+		unsigned char* dst, int dstWidth)
+	{
+		// clamped columns at an odd right edge are left to the scalar kernel
+		const int simdWidth = std::min(dstWidth, srcWidth / 2) & ~1;
+		if (simdWidth == 0) {
+			return 0;
+		}
+
+		const auto& tables = srgbTables();
+		const int count = simdWidth * 2 * channels;
+		thread_local std::vector<unsigned short> columnSums;
+		columnSums.resize((size_t)count + 8); // the RGB8 loop reads 4 lanes past what it uses
+		unsigned short* sums = columnSums.data();
+		if (channels == 4)
+		{
+			for (int i = 0; i < count; i += 4)
+			{
+				sums[i] = tables.toLinear[row0[i]] + tables.toLinear[row1[i]];
+				sums[i + 1] = tables.toLinear[row0[i + 1]] + tables.toLinear[row1[i + 1]];
+				sums[i + 2] = tables.toLinear[row0[i + 2]] + tables.toLinear[row1[i + 2]];
+				sums[i + 3] = row0[i + 3] + row1[i + 3];
+			}
+		}
+		else
+		{
+			for (int i = 0; i < count; i++) {
+				sums[i] = tables.toLinear[row0[i]] + tables.toLinear[row1[i]];
+			}
+		}
+
+		const __m128i two = _mm_set1_epi16(2);
+		alignas(16) unsigned short indices[8];
+		if (channels == 4)
+		{
+			// colour lanes keep 12 of their 16 bits for the encode table, alpha lanes are averaged like the linear kernels
+			const __m128i colour = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+			for (int x = 0; x < simdWidth; x += 2)
+			{
+				const __m128i p01 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums + x * 8));
+				const __m128i p23 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums + x * 8 + 8));
+				const __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi64(p01, p23), _mm_unpackhi_epi64(p01, p23)), two);
+				const __m128i index = _mm_or_si128(_mm_and_si128(colour, _mm_srli_epi16(sum, 4)), _mm_andnot_si128(colour, _mm_srli_epi16(sum, 2)));
+				_mm_store_si128(reinterpret_cast<__m128i*>(indices), index);
+
+				unsigned char* out = dst + x * 4;
+				out[0] = tables.fromLinear[indices[0]];
+				out[1] = tables.fromLinear[indices[1]];
+				out[2] = tables.fromLinear[indices[2]];
+				out[3] = (unsigned char)indices[3];
+				out[4] = tables.fromLinear[indices[4]];
+				out[5] = tables.fromLinear[indices[5]];
+				out[6] = tables.fromLinear[indices[6]];
+				out[7] = (unsigned char)indices[7];
+			}
+		}
+		else
+		{
+			// the lane shuffles of downsampleRowRGB8_SSE2, on the 16-bit column sums
+			const __m128i firstPixel = _mm_set_epi16(0, 0, 0, 0, 0, -1, -1, -1);
+			for (int x = 0; x < simdWidth; x += 2)
+			{
+				const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums + x * 6));     // p0 p1 p2.rg
+				const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums + x * 6 + 8)); // p2.b p3 ...
+				const __m128i out0 = _mm_add_epi16(lo, _mm_srli_si128(lo, 6));
+				const __m128i p23 = _mm_or_si128(_mm_srli_si128(lo, 12), _mm_slli_si128(hi, 4));
+				const __m128i out1 = _mm_add_epi16(p23, _mm_srli_si128(p23, 6));
+				const __m128i sum = _mm_or_si128(_mm_and_si128(out0, firstPixel), _mm_slli_si128(_mm_and_si128(out1, firstPixel), 6));
+				_mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_srli_epi16(_mm_add_epi16(sum, two), 4));
+
+				unsigned char* out = dst + x * 3;
+				for (int i = 0; i < 6; i++) {
+					out[i] = tables.fromLinear[indices[i]];
+				}
+			}
+		}
+		return simdWidth;
+	}
+
+#endif // MIP_USE_SSE2
+
+#ifdef __AVX2__
+
+	// 4 RGBA8 outputs per 256-bit block, two blocks per iteration
+	int downsampleRowRGBA8_AVX2(const unsigned char* row0, const unsigned char* row1, unsigned char* dst, int dstWidth)
+	{
+		const __m256i two = _mm256_set1_epi16(2);
+		const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 0, 4, 1, 5);
+		int x = 0;
+		for (; x + 8 <= dstWidth; x += 8)
+		{
+			for (int block = 0; block < 2; block++)
+			{
+				const int offset = (x + block * 4) * 8;
+				const __m256i a0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + offset)));
+				const __m256i a1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + offset + 16)));
+				const __m256i b0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + offset)));
+				const __m256i b1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + offset + 16)));
+				const __m256i p0123 = _mm256_add_epi16(a0, b0); // [p0 p1 | p2 p3]
+				const __m256i p4567 = _mm256_add_epi16(a1, b1); // [p4 p5 | p6 p7]
+				__m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi64(p0123, p4567), _mm256_unpackhi_epi64(p0123, p4567)); // [o0 o2 | o1 o3]
+				sum = _mm256_srli_epi16(_mm256_add_epi16(sum, two), 2);
+				const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(sum, sum), order);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (x + block * 4) * 4), _mm256_castsi256_si128(packed));
+			}
+		}
+		return x;
+	}
+
+#endif // __AVX2__
+
+	void downsampleRow(const MipImage& src, int y, bool srgb, MipImage& dst)
+	{
+		const size_t srcStride = (size_t)src.width * src.channels;
+		const unsigned char* row0 = src.pixels.data() + std::min(y * 2, src.height - 1) * srcStride;
+		const unsigned char* row1 = src.pixels.data() + std::min(y * 2 + 1, src.height - 1) * srcStride;
+		unsigned char* out = dst.pixels.data() + (size_t)y * dst.width * dst.channels;
+
+		if (srgb && src.channels != 2)
+		{
+			int x = 0;
+#ifdef MIP_USE_SSE2
+			if (src.channels >= 3) {
+				x = downsampleRowSrgb_SSE2(row0, row1, src.width, src.channels, out, dst.width);
+			}
+#endif
+			downsampleRowSrgb(row0, row1, src.width, src.channels, out, x, dst.width);
+			return;
+		}
+
+		int x = 0;
+		if (src.width >= 2)
+		{
+#ifdef MIP_USE_SSE2
+			switch (src.channels)
+			{
+			case 1: x = downsampleRowR8_SSE2(row0, row1, out, dst.width); break;
+			case 3: x = downsampleRowRGB8_SSE2(row0, row1, src.width, out, dst.width); break;
+			case 4:
+#ifdef __AVX2__
+				x = downsampleRowRGBA8_AVX2(row0, row1, out, dst.width);
+				x += downsampleRowRGBA8_SSE2(row0 + x * 8, row1 + x * 8, out + x * 4, dst.width - x);
+#else
+				x = downsampleRowRGBA8_SSE2(row0, row1, out, dst.width);
+#endif
+				break;
+			default: break;
+			}
+#endif
+		}
+		downsampleRowScalar(row0, row1, src.width, src.channels, out, x, dst.width);
+	}
+
+	void writeU32(unsigned char* p, unsigned int value)
+	{
+		p[0] = value & 0xff;
+		p[1] = (value >> 8) & 0xff;
+		p[2] = (value >> 16) & 0xff;
+		p[3] = (value >> 24) & 0xff;
+	}
+
+	double millisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+} // namespace
+
+MipImage downsampleMip(const MipImage& src, bool srgb)
+{
+	MipImage dst;
+	dst.width = std::max(src.width / 2, 1);
+	dst.height = std::max(src.height / 2, 1);
+	dst.channels = src.channels;
+	dst.pixels.resize((size_t)dst.width * dst.height * dst.channels);
+
+	// Row bands of roughly 64 KB of output each, tiny tail levels stay on this thread
+	const size_t rowsPerBand = std::max<size_t>(1, 65536 / ((size_t)dst.width * dst.channels));
+	parallelFor(dst.height, rowsPerBand, [&](size_t begin, size_t end)
+	{
+		for (size_t y = begin; y < end; y++) {
+			downsampleRow(src, (int)y, srgb, dst);
+		}
+	});
+
+	return dst;
+}
+
+std::vector<MipImage> generateMipChain(MipImage&& base, bool srgb)
+{
+	std::vector<MipImage> levels;
+	levels.push_back(std::move(base));
+
+	// Every level is filtered from the previous one, so levels are built in order
+	while (levels.back().width > 1 || levels.back().height > 1) {
+		levels.push_back(downsampleMip(levels.back(), srgb));
+	}
+
+	return levels;
+}
+
+bool bakeMipChain(const char* srcPath, const char* dstPath, bool srgb)
+{
+	stbi_set_flip_vertically_on_load(true); // bake in the same orientation the runtime loader uses
+
+	int width, height, nrComponents;
+	if (!stbi_info(srcPath, &width, &height, &nrComponents))
+	{
+		std::cout << "Texture failed to load at path: " << srcPath << std::endl;
+		return false;
+	}
+
+	// The baked DDS is plain RGB or RGBA, grey images are expanded
+	const int channels = nrComponents == 3 ? 3 : 4;
+	unsigned char* data = stbi_load(srcPath, &width, &height, &nrComponents, channels);
+	if (!data)
+	{
+		std::cout << "Texture failed to load at path: " << srcPath << std::endl;
+		return false;
+	}
+
+	MipImage base;
+	base.width = width;
+	base.height = height;
+	base.channels = channels;
+	base.pixels.assign(data, data + (size_t)width * height * channels);
+	stbi_image_free(data);
+
+	const auto levels = generateMipChain(std::move(base), srgb);
+
+	unsigned char header[128] = {};
+	memcpy(header, "DDS ", 4);
+	writeU32(header + 4, 124); // header size
+	writeU32(header + 8, 0x1 | 0x2 | 0x4 | 0x8 | 0x1000 | 0x20000); // CAPS | HEIGHT | WIDTH | PITCH | PIXELFORMAT | MIPMAPCOUNT
+	writeU32(header + 12, height);
+	writeU32(header + 16, width);
+	writeU32(header + 20, width * channels); // pitch
+	writeU32(header + 28, (unsigned int)levels.size());
+	writeU32(header + 76, 32); // pixel format size
+	writeU32(header + 80, channels == 4 ? 0x40 | 0x1 : 0x40); // RGB (| ALPHAPIXELS)
+	writeU32(header + 88, channels * 8);
+	writeU32(header + 92, 0x000000ff);
+	writeU32(header + 96, 0x0000ff00);
+	writeU32(header + 100, 0x00ff0000);
+	writeU32(header + 104, channels == 4 ? 0xff000000 : 0);
+	writeU32(header + 108, 0x1000 | 0x400000 | 0x8); // TEXTURE | MIPMAP | COMPLEX
+
+	FILE* fp = fopen(dstPath, "wb");
+	if (fp == NULL)
+	{
+		std::cout << dstPath << " could not be opened for writing" << std::endl;
+		return false;
+	}
+
+	bool ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header);
+	for (const auto& level : levels) {
+		ok = ok && fwrite(level.pixels.data(), 1, level.pixels.size(), fp) == level.pixels.size();
+	}
+	fclose(fp);
+
+	std::cout << "Baked " << srcPath << " -> " << dstPath << " (" << levels.size() << " levels)" << std::endl;
+	return ok;
+}
+
+void benchmarkMipGeneration(const char* imagePath, int iterations)
+{
+	stbi_set_flip_vertically_on_load(true);
+
+	// the channels the image has, as TextureStreamer loads it: JPEGs take the RGB8 kernels
+	int width, height, nrComponents;
+	unsigned char* data = stbi_load(imagePath, &width, &height, &nrComponents, 0);
+	if (!data)
+	{
+		std::cout << "Texture failed to load at path: " << imagePath << std::endl;
+		return;
+	}
+
+	MipImage base;
+	base.width = width;
+	base.height = height;
+	base.channels = nrComponents;
+	base.pixels.assign(data, data + (size_t)width * height * nrComponents);
+	stbi_image_free(data);
+
+	const GLenum formats[4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	const GLenum internalFormats[4] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+	const char* formatNames[4] = { "R8", "RG8", "RGB8", "RGBA8" };
+	const GLenum format = formats[nrComponents - 1];
+	const GLenum internalFormat = internalFormats[nrComponents - 1];
+
+	std::cout << "Mip generation benchmark: " << imagePath << " (" << width << "x" << height << " " << formatNames[nrComponents - 1] << ") on "
+		<< glGetString(GL_RENDERER) << ", " << iterations << " iterations" << std::endl;
+
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	double cpuLinear = 0.0, cpuSrgb = 0.0, cpuUpload = 0.0, glBaseUpload = 0.0, glGenerate = 0.0;
+	for (int i = 0; i < iterations; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		MipImage copy = base;
+		auto levels = generateMipChain(std::move(copy), false);
+		cpuLinear += millisecondsSince(start);
+
+		copy = base;
+		start = std::chrono::steady_clock::now();
+		levels = generateMipChain(std::move(copy), true);
+		cpuSrgb += millisecondsSince(start);
+
+		// CPU path also pays for uploading every level
+		start = std::chrono::steady_clock::now();
+		for (size_t level = 0; level < levels.size(); level++) {
+			glTexImage2D(GL_TEXTURE_2D, (GLint)level, internalFormat, levels[level].width, levels[level].height, 0, format, GL_UNSIGNED_BYTE, levels[level].pixels.data());
+		}
+		glFinish();
+		cpuUpload += millisecondsSince(start);
+
+		start = std::chrono::steady_clock::now();
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, base.pixels.data());
+		glFinish();
+		glBaseUpload += millisecondsSince(start);
+
+		start = std::chrono::steady_clock::now();
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glFinish();
+		glGenerate += millisecondsSince(start);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glDeleteTextures(1, &textureID);
+
+	printf("  CPU chain, linear      : %8.3f ms\n", cpuLinear / iterations);
+	printf("  CPU chain, sRGB        : %8.3f ms\n", cpuSrgb / iterations);
+	printf("  CPU chain upload       : %8.3f ms\n", cpuUpload / iterations);
+	printf("  glTexImage2D (level 0) : %8.3f ms\n", glBaseUpload / iterations);
+	printf("  glGenerateMipmap       : %8.3f ms\n", glGenerate / iterations);
+	printf("  threads used           : %8u\n", (unsigned int)parallelWorkerCount());
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// STL
+#include <vector>
+
+/**
+  One 8-bit image level, rows tightly packed, bottom row first (as stb_image loads it when flipping).
+*/
+struct MipImage
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0; //!< 1 (R8), 2 (RG8), 3 (RGB8) or 4 (RGBA8)
+	std::vector<unsigned char> pixels;
+};
+
+/** \brief Builds the complete mip chain of an image on the CPU, down to 1x1.
+*
+*   Uses SSE2 (and AVX2 when compiled with it) 2x2 box filter kernels for R8, RGB8 and RGBA8, the sRGB
+*   RGB8 and RGBA8 kernels decode and encode through lookup tables around the SIMD averaging.
+*   Colour channels of sRGB images are averaged in linear space (alpha is always linear).
+*   Every level is split into row bands that are filtered in parallel.
+*
+*   \param base Level 0 image, it is moved into the first element of the result
+*   \param srgb True if colour channels are sRGB encoded
+*   \return All levels, level 0 first.
+*/
+std::vector<MipImage> generateMipChain(MipImage&& base, bool srgb);
+
+/** \brief Halves one level with a 2x2 box filter (odd edges are clamped).
+*   \param src  Source level
+*   \param srgb True if colour channels are sRGB encoded
+*   \return The next smaller level.
+*/
+MipImage downsampleMip(const MipImage& src, bool srgb);
+
+/** \brief Offline baker: loads an image, builds its mip chain and writes it as an uncompressed DDS.
+*   TextureStreamer then streams the baked file tail first without decoding or filtering at runtime.
+*   \param srcPath Any image stb_image can decode
+*   \param dstPath Output .dds path
+*   \param srgb    True if colour channels are sRGB encoded
+*   \return True if the file has been written or false otherwise.
+*/
+bool bakeMipChain(const char* srcPath, const char* dstPath, bool srgb);
+
+/** \brief Times CPU mip generation against glGenerateMipmap for one image and prints the results.
+*   Needs a current OpenGL context (it is meant to be run on llvmpipe and on real GPUs).
+*   \param imagePath  Any image stb_image can decode
+*   \param iterations How many times to repeat every measurement
+*/
+void benchmarkMipGeneration(const char* imagePath, int iterations);
@@ -0,0 +1,194 @@
+// STL
+#include <iostream>
+
+// Project
+#include "occlusionQueries.h"
+#include "cameraBlock.h"
+#include "shaderBatch.h"
+#include "shaderReloader.h"
+#include "resourceTracker.h"
+
+namespace {
+
+	// a hidden mesh's box is tested this much larger (relative to its size), so that it is found
+	// visible again slightly before it actually comes into view
+	const float HIDDEN_BOX_MARGIN = 0.1f;
+
+	// boxes closer than this to the camera may be cut by the near plane and are not tested
+	const float NEAR_MARGIN = 0.2f;
+
+	bool isInside(const glm::vec3& point, const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		return point.x >= boxMin.x && point.y >= boxMin.y && point.z >= boxMin.z
+			&& point.x <= boxMax.x && point.y <= boxMax.y && point.z <= boxMax.z;
+	}
+}
+
+OcclusionQueries::OcclusionQueries(ShaderReloader* reloader)
+{
+	ShaderBatch batch(RESOURCE_SITE);
+	batch.add(_shader, "shaderfiles/occlusion_box.vs", "shaderfiles/occlusion_box.fs");
+	batch.build();
+	if (reloader != nullptr) {
+		reloader->watch(_shader, "shaderfiles/occlusion_box.vs", "shaderfiles/occlusion_box.fs");
+	}
+	trackedGenVertexArrays(1, &_vertexArray);
+
+	// the conservative target lets the GPU answer from its coarse depth data alone, it needs GL 4.3
+	if (GLAD_GL_VERSION_4_3) {
+		_target = GL_ANY_SAMPLES_PASSED_CONSERVATIVE;
+	}
+}
+
+OcclusionQueries::~OcclusionQueries()
+{
+	for (Mesh& mesh : _meshes) {
+		glDeleteQueries(FRAME_LATENCY, mesh.queries);
+	}
+	trackedDeleteVertexArrays(1, &_vertexArray);
+}
+
+size_t OcclusionQueries::add(GLsizei vertexCount)
+{
+	Mesh mesh;
+	mesh.vertexCount = vertexCount;
+	glGenQueries(FRAME_LATENCY, mesh.queries);
+	_meshes.push_back(mesh);
+	return _meshes.size() - 1;
+}
+
+void OcclusionQueries::beginFrame(const glm::vec3& eye)
+{
+	CameraBlock::bind(_shader);
+	_eye = eye;
+	_current = (_current + 1) % FRAME_LATENCY;
+	for (Mesh& mesh : _meshes) {
+		collect(mesh);
+	}
+	_frames++;
+}
+
+void OcclusionQueries::collect(Mesh& mesh)
+{
+	// oldest first, _current is the query about to be reused
+	for (int age = 0; age < FRAME_LATENCY; age++)
+	{
+		const int i = (_current + age) % FRAME_LATENCY;
+		if (!mesh.pending[i]) {
+			continue;
+		}
+
+		GLint available = 0;
+		glGetQueryObjectiv(mesh.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			// queries complete in order, nothing newer is ready either; the oldest is given up on
+			if (age == 0)
+			{
+				mesh.pending[i] = false;
+				continue;
+			}
+			break;
+		}
+
+		GLuint anySamples = 0;
+		glGetQueryObjectuiv(mesh.queries[i], GL_QUERY_RESULT, &anySamples);
+		mesh.pending[i] = false;
+		if (anySamples) {
+			mesh.hiddenResults = 0;
+		}
+		else
+		{
+			mesh.hiddenResults++;
+			_hiddenResults++;
+			// with GL_QUERY_NO_WAIT the GPU may still have drawn it, if the result came too late
+			if (mesh.conditional[i]) {
+				_gpuSkippedVertices += mesh.vertexCount;
+			}
+		}
+	}
+}
+
+bool OcclusionQueries::isHidden(size_t id) const
+{
+	return id < _meshes.size() && _meshes[id].hiddenResults >= HIDDEN_RESULTS_TO_SKIP;
+}
+
+bool OcclusionQueries::beginDraw(size_t id, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+	_conditional = false;
+	if (id >= _meshes.size()) {
+		return true;
+	}
+
+	Mesh& mesh = _meshes[id];
+	const bool hidden = isHidden(id);
+	const glm::vec3 margin = hidden ? (boxMax - boxMin) * HIDDEN_BOX_MARGIN : glm::vec3(0.0f);
+	const glm::vec3 testMin = boxMin - margin;
+	const glm::vec3 testMax = boxMax + margin;
+	if (isInside(_eye, testMin - glm::vec3(NEAR_MARGIN), testMax + glm::vec3(NEAR_MARGIN)))
+	{
+		mesh.hiddenResults = 0;
+		return true;
+	}
+
+	// the box only tests depth, it changes nothing
+	GLint depthFunc = GL_LESS;
+	GLboolean depthMask = GL_TRUE;
+	glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	// after a depth pre-pass the mesh's own depth is in the buffer, its box is in front of it or on it
+	glDepthFunc(GL_LEQUAL);
+
+	_shader.use();
+	_shader.setVec3("boxMin", testMin);
+	_shader.setVec3("boxMax", testMax);
+	glBindVertexArray(_vertexArray);
+	const GLuint query = mesh.queries[_current];
+	glBeginQuery(_target, query);
+	glDrawArrays(GL_TRIANGLES, 0, 36);
+	glEndQuery(_target);
+	mesh.pending[_current] = true;
+	mesh.conditional[_current] = !hidden;
+	_tests++;
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask(depthMask);
+	glDepthFunc((GLenum)depthFunc);
+
+	if (hidden)
+	{
+		_cpuSkippedVertices += mesh.vertexCount;
+		return false;
+	}
+	glBeginConditionalRender(query, GL_QUERY_NO_WAIT);
+	_conditional = true;
+	return true;
+}
+
+void OcclusionQueries::endDraw()
+{
+	if (_conditional)
+	{
+		glEndConditionalRender();
+		_conditional = false;
+	}
+}
+
+void OcclusionQueries::report()
+{
+	if (_frames == 0) {
+		return;
+	}
+
+	std::cout << "GPU occlusion queries per frame (" << _frames << " frames): " << (double)_tests / _frames << " tested, "
+		<< (double)_hiddenResults / _frames << " hidden, vertices skipped " << (double)_cpuSkippedVertices / _frames << " on the CPU, up to "
+		<< (double)_gpuSkippedVertices / _frames << " on the GPU" << std::endl;
+	_frames = 0;
+	_tests = 0;
+	_hiddenResults = 0;
+	_cpuSkippedVertices = 0;
+	_gpuSkippedVertices = 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+// STL
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Project
+#include "shader.h"
+
+class ShaderReloader;
+
+/**
+  Hardware occlusion queries for expensive meshes. Right before such a mesh is drawn, its world
+  space box is drawn into the depth buffer with colour and depth writes off inside an
+  any-samples-passed query, and the mesh itself is drawn under glBeginConditionalRender with
+  GL_QUERY_NO_WAIT: the GPU drops it when the box turned out hidden, the CPU never waits.
+  Results are read back frames later, only once available. An object whose box came out hidden
+  for several results in a row is not submitted at all (its box is still tested every frame,
+  slightly enlarged so that it tends to reappear a frame before the object does), and one visible
+  result brings it back at once.
+  The box is tested against the depth drawn so far, so hidden is only found for meshes drawn
+  after their occluders (front to back order, or after a depth pre-pass).
+*/
+class OcclusionQueries
+{
+public:
+	/** \brief Compiles the box program.
+	*   \param reloader Optional, the program is hot-reloaded when its files change
+	*/
+	explicit OcclusionQueries(ShaderReloader* reloader = nullptr);
+	~OcclusionQueries();
+
+	/** \brief Registers a mesh to test.
+	*   \param vertexCount Vertices the mesh draws, for the statistics
+	*   \return ID to pass to beginDraw().
+	*/
+	size_t add(GLsizei vertexCount);
+
+	/** \brief Starts a frame, collects the results of earlier frames that are ready.
+	*   Boxes are drawn with the camera latched in the Camera block, the one the meshes are drawn with.
+	*   \param eye Camera position, boxes around it are never tested
+	*/
+	void beginFrame(const glm::vec3& eye);
+
+	/** \brief Gets whether a mesh is hidden according to its last few results, and not submitted by beginDraw().
+	*   \param id ID returned by add()
+	*/
+	bool isHidden(size_t id) const;
+
+	/** \brief Tests a mesh's box and, unless the mesh is hidden, starts conditional rendering for it.
+	*   Call it right before the mesh is drawn, with its depth state and depth range set up.
+	*   \param id     ID returned by add()
+	*   \param boxMin Lowest corner of the world space box
+	*   \param boxMax Highest corner of the world space box
+	*   \return False if the mesh is hidden and must not be drawn, otherwise draw it and call endDraw().
+	*/
+	bool beginDraw(size_t id, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+	//* \brief Ends the conditional rendering started by the last beginDraw().
+	void endDraw();
+
+	//* \brief Prints the average tests and skipped vertices per frame and starts a new average.
+	void report();
+
+private:
+	OcclusionQueries(const OcclusionQueries&) = delete;
+	OcclusionQueries& operator=(const OcclusionQueries&) = delete;
+
+	// Frames a query stays in flight before its result is given up on and the query reused
+	static const int FRAME_LATENCY = 4;
+	// Hidden results in a row before a mesh stops being submitted
+	static const int HIDDEN_RESULTS_TO_SKIP = 4;
+
+	struct Mesh
+	{
+		GLsizei vertexCount = 0;
+		GLuint queries[FRAME_LATENCY] = {};
+		bool pending[FRAME_LATENCY] = {};
+		bool conditional[FRAME_LATENCY] = {}; //!< The draw was submitted under conditional rendering
+		int hiddenResults = 0; //!< In a row
+	};
+
+	void collect(Mesh& mesh);
+
+	Shader _shader;
+	GLuint _vertexArray = 0; //! Empty, the box corners come from gl_VertexID
+	GLenum _target = GL_ANY_SAMPLES_PASSED;
+	std::vector<Mesh> _meshes;
+	int _current = 0;
+	glm::vec3 _eye = glm::vec3(0.0f);
+	bool _conditional = false; //! Between beginDraw() and endDraw()
+
+	// statistics since the last report()
+	int _frames = 0;
+	size_t _tests = 0;
+	size_t _hiddenResults = 0;
+	size_t _cpuSkippedVertices = 0;
+	size_t _gpuSkippedVertices = 0;
+};
@@ -0,0 +1,13 @@
+// Project
+#include "jobSystem.h"
+#include "parallel.h"
+
+size_t parallelWorkerCount()
+{
+	return JobSystem::instance().threadCount();
+}
+
+void parallelFor(size_t count, size_t minRangeSize, const std::function<void(size_t, size_t)>& body)
+{
+	JobSystem::instance().parallelFor(count, minRangeSize, body);
+}
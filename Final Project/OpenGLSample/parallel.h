@@ -0,0 +1,15 @@
+#pragma once
+
+// STL
+#include <cstddef>
+#include <functional>
+
+/** \brief Splits [0, count) into contiguous ranges and runs body on them across the CPU cores, as JobSystem jobs. Blocks until all ranges are done.
+*   \param count        Number of items
+*   \param minRangeSize Smallest range worth handing to another thread (small counts run inline on the caller)
+*   \param body         Called as body(begin, end) for every range
+*/
+void parallelFor(size_t count, size_t minRangeSize, const std::function<void(size_t, size_t)>& body);
+
+/** \brief Gets number of threads parallelFor spreads work over (including the calling thread). */
+size_t parallelWorkerCount();
@@ -0,0 +1,193 @@
+// STL
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Project
+#include "programCache.h"
+#include "resourceTracker.h"
+
+namespace {
+
+	const uint32_t CACHE_MAGIC = 0x31425047; // "GPB1"
+
+	struct CacheHeader
+	{
+		uint32_t magic;
+		uint32_t binaryFormat;
+		uint32_t length;
+		uint32_t reserved;
+		uint64_t key; //!< Guards against a renamed or truncated file
+	};
+
+	std::string cacheDirectory = "shadercache";
+
+	// glGetProgramBinary & co. are core in 4.1 only; on our 3.3 context they come from ARB_get_program_binary
+	// under the same names, which glad (core profile, no extensions) doesn't load.
+	PFNGLGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+	PFNGLPROGRAMBINARYPROC programBinary = nullptr;
+	PFNGLPROGRAMPARAMETERIPROC programParameteri = nullptr;
+
+	bool binariesSupported()
+	{
+		static const bool supported = [] {
+			getProgramBinary = (PFNGLGETPROGRAMBINARYPROC)glfwGetProcAddress("glGetProgramBinary");
+			programBinary = (PFNGLPROGRAMBINARYPROC)glfwGetProcAddress("glProgramBinary");
+			programParameteri = (PFNGLPROGRAMPARAMETERIPROC)glfwGetProcAddress("glProgramParameteri");
+			if (getProgramBinary == nullptr || programBinary == nullptr || programParameteri == nullptr) {
+				return false;
+			}
+
+			// some drivers expose the entry points but no format at all
+			GLint numFormats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+			return numFormats > 0;
+		}();
+		return supported;
+	}
+
+	// FNV-1a
+	uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	uint64_t hashString(uint64_t hash, const char* str)
+	{
+		// include the terminator so "ab"+"c" and "a"+"bc" differ
+		return str != nullptr ? hashBytes(hash, str, strlen(str) + 1) : hashBytes(hash, "", 1);
+	}
+
+	std::string cachePath(uint64_t key)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+		return cacheDirectory + "/" + name;
+	}
+
+	void createCacheDirectory()
+	{
+#ifdef _WIN32
+		_mkdir(cacheDirectory.c_str());
+#else
+		mkdir(cacheDirectory.c_str(), 0755);
+#endif
+	}
+}
+
+void setProgramCacheDirectory(const char* path)
+{
+	cacheDirectory = path;
+}
+
+uint64_t programCacheKey(const std::string& sources)
+{
+	uint64_t hash = 14695981039346656037ull;
+	hash = hashString(hash, (const char*)glGetString(GL_VENDOR));
+	hash = hashString(hash, (const char*)glGetString(GL_RENDERER));
+	hash = hashString(hash, (const char*)glGetString(GL_VERSION));
+	return hashBytes(hash, sources.data(), sources.size());
+}
+
+unsigned int loadCachedProgram(uint64_t key, const char* site)
+{
+	if (!binariesSupported()) {
+		return 0;
+	}
+
+	FILE* file = fopen(cachePath(key).c_str(), "rb");
+	if (file == nullptr) {
+		return 0;
+	}
+
+	CacheHeader header;
+	std::vector<unsigned char> binary;
+	bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == CACHE_MAGIC && header.key == key && header.length > 0;
+	if (valid)
+	{
+		binary.resize(header.length);
+		valid = fread(binary.data(), 1, binary.size(), file) == binary.size();
+	}
+	fclose(file);
+	if (!valid) {
+		return 0;
+	}
+
+	GLuint program = trackCreateProgram(site);
+	programBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+
+	// drivers reject binaries after an update without changing the strings we hash, so always check
+	GLint success = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		trackedDeleteProgram(program);
+		remove(cachePath(key).c_str());
+		return 0;
+	}
+	return program;
+}
+
+void prepareProgramForCache(unsigned int program)
+{
+	if (binariesSupported()) {
+		programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+}
+
+void storeCachedProgram(uint64_t key, unsigned int program)
+{
+	if (!binariesSupported()) {
+		return;
+	}
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return;
+	}
+
+	std::vector<unsigned char> binary(length);
+	GLenum binaryFormat = 0;
+	getProgramBinary(program, length, &length, &binaryFormat, binary.data());
+
+	CacheHeader header;
+	header.magic = CACHE_MAGIC;
+	header.binaryFormat = binaryFormat;
+	header.length = (uint32_t)length;
+	header.reserved = 0;
+	header.key = key;
+
+	createCacheDirectory();
+	// write to a temporary file first so a crash never leaves a truncated binary behind
+	const std::string path = cachePath(key);
+	const std::string tempPath = path + ".tmp";
+	FILE* file = fopen(tempPath.c_str(), "wb");
+	if (file == nullptr)
+	{
+		std::cout << "Program cache could not be written at path: " << tempPath << std::endl;
+		return;
+	}
+	const bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary.data(), 1, header.length, file) == header.length;
+	fclose(file);
+	remove(path.c_str());
+	if (!written || rename(tempPath.c_str(), path.c_str()) != 0) {
+		remove(tempPath.c_str());
+	}
+}
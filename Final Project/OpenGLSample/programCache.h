@@ -0,0 +1,39 @@
+#pragma once
+
+// STL
+#include <cstdint>
+#include <string>
+
+// Deliberately no OpenGL header here: this is included both from glad code (shader.h)
+// and from the GLEW based LoadShaders() (shader.cpp).
+
+/** \brief Sets the directory program binaries are kept in (created on first store). Default is "shadercache".
+*   \param path Directory path, without trailing separator
+*/
+void setProgramCacheDirectory(const char* path);
+
+/** \brief Computes the cache key of a program from all of its shader sources.
+*   The vendor, renderer and version strings of the current context are hashed in too,
+*   so a driver update or a different GPU never picks up a stale binary.
+*   \param sources Source of every stage, concatenated in a fixed order
+*   \return 64-bit key.
+*/
+uint64_t programCacheKey(const std::string& sources);
+
+/** \brief Creates a program from its cached binary.
+*   \param key  Key returned by programCacheKey()
+*   \param site Call site the program is tracked under, see resourceTracker.h
+*   \return Linked program ID, or 0 if there is no binary or the driver rejected it (compile from source then).
+*/
+unsigned int loadCachedProgram(uint64_t key, const char* site);
+
+/** \brief Hints the driver that the binary of a program will be retrieved. Call it before glLinkProgram().
+*   \param program Program ID
+*/
+void prepareProgramForCache(unsigned int program);
+
+/** \brief Writes the binary of a successfully linked program to the cache.
+*   \param key     Key returned by programCacheKey()
+*   \param program Linked program ID
+*/
+void storeCachedProgram(uint64_t key, unsigned int program);
@@ -0,0 +1,46 @@
+// STL
+#include <algorithm>
+
+// Project
+#include "renderLayers.h"
+
+int RenderLayers::addLayer(const char* name, float depthShare)
+{
+	depthShare = std::max(depthShare, 0.001f);
+	_layers.push_back({ name, depthShare });
+	_totalShare += depthShare;
+	return (int)_layers.size() - 1;
+}
+
+void RenderLayers::begin(int layer) const
+{
+	double nearDepth = 0.0, farDepth = 1.0;
+	depthRange(layer, nearDepth, farDepth);
+	glDepthRange(nearDepth, farDepth);
+}
+
+void RenderLayers::end()
+{
+	glDepthRange(0.0, 1.0);
+}
+
+void RenderLayers::depthRange(int layer, double& nearDepth, double& farDepth) const
+{
+	// the last layer takes the front of the range, the first one the back
+	float front = 0.0f;
+	for (int i = (int)_layers.size() - 1; i > layer; i--) {
+		front += _layers[i].depthShare;
+	}
+	nearDepth = front / _totalShare;
+	farDepth = layer == 0 ? 1.0 : (front + _layers[layer].depthShare) / _totalShare;
+}
+
+const std::string& RenderLayers::name(int layer) const
+{
+	return _layers[layer].name;
+}
+
+int RenderLayers::size() const
+{
+	return (int)_layers.size();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+// STL
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+/**
+  Draw order between groups of objects without clearing depth. Each layer gets its own slice
+  of the depth range through glDepthRange, later layers nearer the viewer, so everything in a
+  layer ends up in front of all earlier layers while depth testing still works inside a layer.
+  The depth buffer stays valid for the whole frame, so early-Z, a depth pre-pass or occlusion
+  tests can use it. A layer's depth precision is its share of the depth buffer's.
+*/
+class RenderLayers
+{
+public:
+	/** \brief Adds a layer, drawn over the layers added before it.
+	*   \param name       Name, for messages
+	*   \param depthShare Relative size of its depth slice, the slices are scaled to fill [0, 1]
+	*   \return Layer ID.
+	*/
+	int addLayer(const char* name, float depthShare = 1.0f);
+
+	/** \brief Selects a layer's depth slice for the draws that follow.
+	*   \param layer ID returned by addLayer()
+	*/
+	void begin(int layer) const;
+
+	//* \brief Goes back to the full depth range.
+	static void end();
+
+	/** \brief Gets the window space depth range of a layer.
+	*   \param layer ID returned by addLayer()
+	*   \param nearDepth Depth the layer's near plane maps to
+	*   \param farDepth  Depth the layer's far plane maps to
+	*/
+	void depthRange(int layer, double& nearDepth, double& farDepth) const;
+
+	/** \brief Gets name of a layer. */
+	const std::string& name(int layer) const;
+
+	/** \brief Gets number of layers. */
+	int size() const;
+
+private:
+	struct Layer
+	{
+		std::string name;
+		float depthShare;
+	};
+
+	std::vector<Layer> _layers;
+	float _totalShare = 0.0f;
+};
@@ -0,0 +1,357 @@
+// STL
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Project
+#include "resourceTracker.h"
+
+namespace {
+
+	const char* const CATEGORY_NAMES[RESOURCE_CATEGORY_COUNT] = { "buffers", "textures", "renderbuffers", "vertex arrays", "programs", "CPU memory" };
+
+	// Texture levels sized separately, more than any texture we load has
+	const int MAX_TEXTURE_LEVELS = 16;
+
+	struct TrackedObject
+	{
+		const char* site;
+		size_t levelBytes[MAX_TEXTURE_LEVELS]; //!< Buffers and renderbuffers only use the first
+	};
+
+	struct Totals
+	{
+		size_t count = 0;
+		size_t bytes = 0;
+	};
+
+	struct Tracker
+	{
+		std::mutex mutex;
+		std::map<std::pair<int, GLuint>, TrackedObject> objects;
+		std::map<std::string, ptrdiff_t> cpuMemory;
+	};
+
+	// Created on first use, so that it outlives the singletons and thread arenas that report to it
+	Tracker& tracker()
+	{
+		static Tracker instance;
+		return instance;
+	}
+
+	size_t objectBytes(const TrackedObject& object)
+	{
+		size_t bytes = 0;
+		for (size_t level : object.levelBytes) {
+			bytes += level;
+		}
+		return bytes;
+	}
+
+	void add(ResourceCategory category, GLsizei n, const GLuint* ids, const char* site)
+	{
+		Tracker& state = tracker();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		for (GLsizei i = 0; i < n; i++)
+		{
+			TrackedObject& object = state.objects[std::make_pair((int)category, ids[i])];
+			object = TrackedObject();
+			object.site = site;
+		}
+	}
+
+	void remove(ResourceCategory category, GLsizei n, const GLuint* ids)
+	{
+		Tracker& state = tracker();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		for (GLsizei i = 0; i < n; i++) {
+			state.objects.erase(std::make_pair((int)category, ids[i]));
+		}
+	}
+
+	// Sets the size of one level of an object, ignored for objects created untracked
+	void setBytes(ResourceCategory category, GLuint id, int level, size_t bytes)
+	{
+		if (id == 0 || level < 0 || level >= MAX_TEXTURE_LEVELS) {
+			return;
+		}
+		Tracker& state = tracker();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		auto found = state.objects.find(std::make_pair((int)category, id));
+		if (found != state.objects.end()) {
+			found->second.levelBytes[level] = bytes;
+		}
+	}
+
+	GLuint boundObject(GLenum binding)
+	{
+		GLint id = 0;
+		if (binding != 0) {
+			glGetIntegerv(binding, &id);
+		}
+		return (GLuint)id;
+	}
+
+	GLenum bufferBinding(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_ARRAY_BUFFER: return GL_ARRAY_BUFFER_BINDING;
+		case GL_ELEMENT_ARRAY_BUFFER: return GL_ELEMENT_ARRAY_BUFFER_BINDING;
+		case GL_UNIFORM_BUFFER: return GL_UNIFORM_BUFFER_BINDING;
+		case GL_TEXTURE_BUFFER: return GL_TEXTURE_BUFFER; // queried by the target's own name
+		case GL_PIXEL_PACK_BUFFER: return GL_PIXEL_PACK_BUFFER_BINDING;
+		case GL_PIXEL_UNPACK_BUFFER: return GL_PIXEL_UNPACK_BUFFER_BINDING;
+		case GL_COPY_READ_BUFFER: return GL_COPY_READ_BUFFER;
+		case GL_COPY_WRITE_BUFFER: return GL_COPY_WRITE_BUFFER;
+		default: return 0;
+		}
+	}
+
+	GLenum textureBinding(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_TEXTURE_2D: return GL_TEXTURE_BINDING_2D;
+		case GL_TEXTURE_2D_ARRAY: return GL_TEXTURE_BINDING_2D_ARRAY;
+		case GL_TEXTURE_CUBE_MAP: return GL_TEXTURE_BINDING_CUBE_MAP;
+		default: return 0;
+		}
+	}
+
+	// Bytes per texel of what GL stores for a sized format; 0 for unsized ones
+	size_t texelBytes(GLint internalFormat)
+	{
+		switch (internalFormat)
+		{
+		case GL_R8: return 1;
+		case GL_RG8: case GL_R16F: return 2;
+		case GL_RGB8: case GL_SRGB8: return 3;
+		case GL_RGBA8: case GL_SRGB8_ALPHA8: case GL_RG16F: case GL_R32F: case GL_R11F_G11F_B10F: case GL_RGB10_A2: return 4;
+		case GL_DEPTH_COMPONENT16: return 2;
+		case GL_DEPTH_COMPONENT24: case GL_DEPTH24_STENCIL8: case GL_DEPTH_COMPONENT32F: return 4;
+		case GL_RGB16F: return 6;
+		case GL_RGBA16F: case GL_RG32F: return 8;
+		case GL_RGB32F: return 12;
+		case GL_RGBA32F: return 16;
+		default: return 0;
+		}
+	}
+
+	// Bytes per texel of client data, for unsized internal formats (GL_RGB...), which GL stores as given
+	size_t pixelBytes(GLenum format, GLenum type)
+	{
+		size_t components = 4;
+		switch (format)
+		{
+		case GL_RED: case GL_DEPTH_COMPONENT: components = 1; break;
+		case GL_RG: components = 2; break;
+		case GL_RGB: case GL_BGR: components = 3; break;
+		default: break;
+		}
+		switch (type)
+		{
+		case GL_HALF_FLOAT: case GL_UNSIGNED_SHORT: case GL_SHORT: return components * 2;
+		case GL_FLOAT: case GL_UNSIGNED_INT: case GL_INT: return components * 4;
+		default: return components;
+		}
+	}
+
+	// __FILE__ may be a full path, the file name is enough
+	const char* siteName(const char* site)
+	{
+		const char* slash = strrchr(site, '/');
+		const char* backslash = strrchr(site, '\\');
+		const char* separator = slash > backslash ? slash : backslash;
+		return separator != nullptr ? separator + 1 : site;
+	}
+
+	void printTotals(const char* name, const Totals& totals)
+	{
+		printf("  %-52s %6zu %12.1f KB\n", name, totals.count, totals.bytes / 1024.0);
+	}
+}
+
+void trackGenBuffers(GLsizei n, GLuint* buffers, const char* site)
+{
+	glGenBuffers(n, buffers);
+	add(RESOURCE_BUFFER, n, buffers, site);
+}
+
+void trackGenTextures(GLsizei n, GLuint* textures, const char* site)
+{
+	glGenTextures(n, textures);
+	add(RESOURCE_TEXTURE, n, textures, site);
+}
+
+void trackGenRenderbuffers(GLsizei n, GLuint* renderbuffers, const char* site)
+{
+	glGenRenderbuffers(n, renderbuffers);
+	add(RESOURCE_RENDERBUFFER, n, renderbuffers, site);
+}
+
+void trackGenVertexArrays(GLsizei n, GLuint* arrays, const char* site)
+{
+	glGenVertexArrays(n, arrays);
+	add(RESOURCE_VERTEX_ARRAY, n, arrays, site);
+}
+
+GLuint trackCreateProgram(const char* site)
+{
+	const GLuint program = glCreateProgram();
+	add(RESOURCE_PROGRAM, 1, &program, site);
+	return program;
+}
+
+const char* trackedSite(ResourceCategory category, GLuint id)
+{
+	Tracker& state = tracker();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	auto found = state.objects.find(std::make_pair((int)category, id));
+	return found != state.objects.end() ? found->second.site : nullptr;
+}
+
+void trackedDeleteBuffers(GLsizei n, const GLuint* buffers)
+{
+	remove(RESOURCE_BUFFER, n, buffers);
+	glDeleteBuffers(n, buffers);
+}
+
+void trackedDeleteTextures(GLsizei n, const GLuint* textures)
+{
+	remove(RESOURCE_TEXTURE, n, textures);
+	glDeleteTextures(n, textures);
+}
+
+void trackedDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers)
+{
+	remove(RESOURCE_RENDERBUFFER, n, renderbuffers);
+	glDeleteRenderbuffers(n, renderbuffers);
+}
+
+void trackedDeleteVertexArrays(GLsizei n, const GLuint* arrays)
+{
+	remove(RESOURCE_VERTEX_ARRAY, n, arrays);
+	glDeleteVertexArrays(n, arrays);
+}
+
+void trackedDeleteProgram(GLuint program)
+{
+	remove(RESOURCE_PROGRAM, 1, &program);
+	glDeleteProgram(program);
+}
+
+void trackedBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	glBufferData(target, size, data, usage);
+	trackBufferSize(target, (size_t)size);
+}
+
+void trackBufferSize(GLenum target, size_t size)
+{
+	setBytes(RESOURCE_BUFFER, boundObject(bufferBinding(target)), 0, size);
+}
+
+void trackedTexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels)
+{
+	glTexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+	size_t texel = texelBytes(internalFormat);
+	if (texel == 0) {
+		texel = pixelBytes(format, type);
+	}
+	setBytes(RESOURCE_TEXTURE, boundObject(textureBinding(target)), level, (size_t)width * height * texel);
+}
+
+void trackedCompressedTexImage2D(GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void* data)
+{
+	glCompressedTexImage2D(target, level, internalFormat, width, height, border, imageSize, data);
+	setBytes(RESOURCE_TEXTURE, boundObject(textureBinding(target)), level, (size_t)imageSize);
+}
+
+void trackedGenerateMipmap(GLenum target)
+{
+	glGenerateMipmap(target);
+
+	// every level is a quarter of the one above, a third of the base level together
+	const GLuint texture = boundObject(textureBinding(target));
+	Tracker& state = tracker();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	auto found = state.objects.find(std::make_pair((int)RESOURCE_TEXTURE, texture));
+	if (found != state.objects.end())
+	{
+		size_t bytes = found->second.levelBytes[0];
+		for (int level = 1; level < MAX_TEXTURE_LEVELS; level++)
+		{
+			bytes /= 4;
+			found->second.levelBytes[level] = bytes;
+		}
+	}
+}
+
+void trackedRenderbufferStorage(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height)
+{
+	glRenderbufferStorage(target, internalFormat, width, height);
+	setBytes(RESOURCE_RENDERBUFFER, boundObject(GL_RENDERBUFFER_BINDING), 0, (size_t)width * height * texelBytes(internalFormat));
+}
+
+void trackCpuMemory(const char* label, ptrdiff_t bytes)
+{
+	Tracker& state = tracker();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	state.cpuMemory[label] += bytes;
+}
+
+void printResourceReport()
+{
+	Totals categories[RESOURCE_CATEGORY_COUNT];
+	std::map<std::pair<int, std::string>, Totals> sites;
+	{
+		Tracker& state = tracker();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		for (const auto& tracked : state.objects)
+		{
+			const size_t bytes = objectBytes(tracked.second);
+			Totals& site = sites[std::make_pair(tracked.first.first, std::string(siteName(tracked.second.site)))];
+			site.count++;
+			site.bytes += bytes;
+			categories[tracked.first.first].count++;
+			categories[tracked.first.first].bytes += bytes;
+		}
+		for (const auto& held : state.cpuMemory)
+		{
+			if (held.second == 0) {
+				continue;
+			}
+			Totals& site = sites[std::make_pair((int)RESOURCE_CPU_MEMORY, held.first)];
+			site.count = 1;
+			site.bytes = (size_t)held.second;
+			categories[RESOURCE_CPU_MEMORY].count++;
+			categories[RESOURCE_CPU_MEMORY].bytes += site.bytes;
+		}
+	}
+
+	std::vector<std::pair<std::pair<int, std::string>, Totals>> bySize(sites.begin(), sites.end());
+	std::stable_sort(bySize.begin(), bySize.end(), [](const std::pair<std::pair<int, std::string>, Totals>& a, const std::pair<std::pair<int, std::string>, Totals>& b) {
+		return a.second.bytes > b.second.bytes;
+	});
+
+	size_t gpuBytes = 0;
+	for (int category = 0; category < RESOURCE_CPU_MEMORY; category++) {
+		gpuBytes += categories[category].bytes;
+	}
+	printf("Resources: %.1f MB on the GPU, %.1f MB on the CPU\n", gpuBytes / (1024.0 * 1024.0), categories[RESOURCE_CPU_MEMORY].bytes / (1024.0 * 1024.0));
+	for (int category = 0; category < RESOURCE_CATEGORY_COUNT; category++) {
+		printTotals(CATEGORY_NAMES[category], categories[category]);
+	}
+	printf(" by call site:\n");
+	for (const auto& site : bySize)
+	{
+		const std::string name = std::string(CATEGORY_NAMES[site.first.first]) + " " + site.first.second;
+		printTotals(name.c_str(), site.second);
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+// STL
+#include <cstddef>
+
+#include <glad/glad.h>
+
+/**
+  Keeps count of the GL objects and CPU memory the application holds: live objects and bytes per
+  category and per call site, printed by printResourceReport().
+  GL objects are created and sized through the tracked... macros below, used like the GL calls they
+  wrap; they record the file and line they are called from. Classes that create objects for their
+  caller (ShaderBatch, ShaderPermutations, VertexBufferObject, the program cache) take the site as
+  a parameter instead, so that the report names the owner rather than the helper. Sizes are what we asked GL for (the
+  driver may pad or keep copies), taken from the buffer or texture bound to the target.
+  Programs are counted only, the driver does not tell their size.
+  Thread-safe; the GL wrappers of course have to be called on the GL thread.
+*/
+
+enum ResourceCategory
+{
+	RESOURCE_BUFFER,
+	RESOURCE_TEXTURE,
+	RESOURCE_RENDERBUFFER,
+	RESOURCE_VERTEX_ARRAY,
+	RESOURCE_PROGRAM,
+	RESOURCE_CPU_MEMORY,
+	RESOURCE_CATEGORY_COUNT
+};
+
+#define RESOURCE_SITE_STRING(line) #line
+#define RESOURCE_SITE_LINE(line) RESOURCE_SITE_STRING(line)
+// "file:line" of the call, what the report groups by
+#define RESOURCE_SITE __FILE__ ":" RESOURCE_SITE_LINE(__LINE__)
+
+#define trackedGenBuffers(n, buffers) trackGenBuffers(n, buffers, RESOURCE_SITE)
+#define trackedGenTextures(n, textures) trackGenTextures(n, textures, RESOURCE_SITE)
+#define trackedGenRenderbuffers(n, renderbuffers) trackGenRenderbuffers(n, renderbuffers, RESOURCE_SITE)
+#define trackedGenVertexArrays(n, arrays) trackGenVertexArrays(n, arrays, RESOURCE_SITE)
+#define trackedCreateProgram() trackCreateProgram(RESOURCE_SITE)
+
+void trackGenBuffers(GLsizei n, GLuint* buffers, const char* site);
+void trackGenTextures(GLsizei n, GLuint* textures, const char* site);
+void trackGenRenderbuffers(GLsizei n, GLuint* renderbuffers, const char* site);
+void trackGenVertexArrays(GLsizei n, GLuint* arrays, const char* site);
+GLuint trackCreateProgram(const char* site);
+
+/** \brief Gets the call site an object was created at, e.g. to give a replacement of the object the same one.
+*   \param category Category of the object
+*   \param id       Its GL name
+*   \return The site, or nullptr if the object was created untracked
+*/
+const char* trackedSite(ResourceCategory category, GLuint id);
+
+void trackedDeleteBuffers(GLsizei n, const GLuint* buffers);
+void trackedDeleteTextures(GLsizei n, const GLuint* textures);
+void trackedDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers);
+void trackedDeleteVertexArrays(GLsizei n, const GLuint* arrays);
+void trackedDeleteProgram(GLuint program);
+
+//* \brief glBufferData, the size goes to the buffer bound to target.
+void trackedBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+
+/** \brief Records the size of the buffer bound to target, for storage not allocated through trackedBufferData (glBufferStorage).
+*   \param target Target the buffer is bound to
+*   \param size   Size of its storage, in bytes
+*/
+void trackBufferSize(GLenum target, size_t size);
+
+//* \brief glTexImage2D, the level's size goes to the texture bound to target.
+void trackedTexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels);
+
+//* \brief glCompressedTexImage2D, the level's size goes to the texture bound to target.
+void trackedCompressedTexImage2D(GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void* data);
+
+//* \brief glGenerateMipmap, the texture bound to target grows by a third of its base level.
+void trackedGenerateMipmap(GLenum target);
+
+//* \brief glRenderbufferStorage, the size goes to the bound renderbuffer.
+void trackedRenderbufferStorage(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height);
+
+/** \brief Records CPU memory held, e.g. a copy of data kept for the GPU.
+*   \param label What holds it, the report groups by it
+*   \param bytes Bytes allocated, negative when freed
+*/
+void trackCpuMemory(const char* label, ptrdiff_t bytes);
+
+/** \brief Prints live objects and bytes per category, then per call site, largest first. */
+void printResourceReport();
@@ -0,0 +1,374 @@
+// STL
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// Project
+#include "sceneFile.h"
+#include "mappedFile.h"
+
+namespace {
+
+	const uint32_t SCENE_MAGIC = 0x314E4353; // "SCN1"
+	const uint32_t SCENE_VERSION = 1; // bumped whenever the layout of the header or of an array element changes
+
+	struct SceneHeader
+	{
+		uint32_t magic;
+		uint32_t layerCount;
+		uint32_t meshCount;
+		uint32_t materialCount;
+		uint32_t objectCount;
+		uint32_t pointLightCount;
+		uint32_t hasSpotLight;
+		uint32_t version; //!< SCENE_VERSION
+		// followed by the DirLight, the SpotLight, then the arrays in the order above
+	};
+
+	const char* const SHAPE_NAMES[] = { "plane", "sphere", "cube-no-top", "rectangle", "pyramid", "open-pyramid", "torus", "cylinder" };
+
+	bool readVec3(std::istringstream& line, glm::vec3& v)
+	{
+		return (bool)(line >> v.x >> v.y >> v.z);
+	}
+
+	bool copyName(char* dst, size_t size, const std::string& src)
+	{
+		if (src.size() >= size) {
+			return false;
+		}
+		std::memcpy(dst, src.c_str(), src.size() + 1);
+		return true;
+	}
+
+	bool isCount(float value, float minimum, float maximum)
+	{
+		return value >= minimum && value <= maximum && std::floor(value) == value;
+	}
+
+	// Params the shape generators can build from: a plane or sphere grid of 2 to 256 vertices a side
+	// (its indices are 16-bit, 0 takes the default), a cylinder of positive radius and height and at least 3 slices
+	bool validMeshParams(const SceneMesh& mesh)
+	{
+		switch (mesh.shape)
+		{
+		case SCENE_PLANE:
+		case SCENE_SPHERE:
+			return mesh.params[0] == 0.0f || isCount(mesh.params[0], 2.0f, 256.0f);
+		case SCENE_CYLINDER:
+			return mesh.params[0] > 0.0f && isCount(mesh.params[1], 3.0f, 65536.0f) && mesh.params[2] > 0.0f;
+		default:
+			return mesh.shape < SCENE_CYLINDER;
+		}
+	}
+
+	bool parseScene(const char* path, const char* text, size_t size, Scene& scene)
+	{
+		std::map<std::string, uint32_t> layers, meshes, materials;
+		std::istringstream lines(std::string(text, size));
+		std::string rawLine;
+		int lineNumber = 0;
+		SceneObject* object = nullptr; // the one transforms apply to
+
+		while (std::getline(lines, rawLine))
+		{
+			lineNumber++;
+			std::istringstream line(rawLine.substr(0, rawLine.find('#')));
+			std::string keyword;
+			if (!(line >> keyword)) {
+				continue;
+			}
+
+			bool ok = true;
+			if (keyword == "layer")
+			{
+				std::string name;
+				SceneLayer layer = {};
+				ok = line >> name >> layer.depthShare && copyName(layer.name, sizeof(layer.name), name);
+				layers[name] = (uint32_t)scene.layers.size();
+				scene.layers.push_back(layer);
+			}
+			else if (keyword == "mesh")
+			{
+				std::string name, shape;
+				SceneMesh mesh = {};
+				ok = (bool)(line >> name >> shape);
+				const char* const* found = std::find(std::begin(SHAPE_NAMES), std::end(SHAPE_NAMES), shape);
+				ok = ok && found != std::end(SHAPE_NAMES);
+				mesh.shape = (uint32_t)(found - std::begin(SHAPE_NAMES));
+				for (float& param : mesh.params)
+				{
+					if (!(line >> param)) {
+						break;
+					}
+				}
+				ok = ok && validMeshParams(mesh);
+				meshes[name] = (uint32_t)scene.meshes.size();
+				scene.meshes.push_back(mesh);
+			}
+			else if (keyword == "material")
+			{
+				std::string name, texture, option;
+				SceneMaterial material = {};
+				ok = line >> name >> texture && copyName(material.texture, sizeof(material.texture), texture);
+				while (line >> option)
+				{
+					if (option == "translucent") {
+						material.flags |= SCENE_TRANSLUCENT;
+					}
+					else {
+						ok = false;
+					}
+				}
+				materials[name] = (uint32_t)scene.materials.size();
+				scene.materials.push_back(material);
+			}
+			else if (keyword == "object")
+			{
+				std::string mesh, material, layer, option;
+				ok = line >> mesh >> material >> layer && meshes.count(mesh) && materials.count(material) && layers.count(layer);
+				SceneObject added = {};
+				added.model = glm::mat4(1.0f);
+				if (ok)
+				{
+					added.mesh = meshes[mesh];
+					added.material = materials[material];
+					added.layer = layers[layer];
+				}
+				while (line >> option)
+				{
+					if (option == "occluder") {
+						added.flags |= SCENE_OCCLUDER;
+					}
+					else {
+						ok = false;
+					}
+				}
+				scene.objects.push_back(added);
+				object = &scene.objects.back();
+			}
+			else if (keyword == "scale" || keyword == "translate" || keyword == "rotate")
+			{
+				float degrees = 0.0f;
+				glm::vec3 v;
+				ok = object != nullptr && (keyword != "rotate" || line >> degrees) && readVec3(line, v);
+				if (ok && keyword == "scale") {
+					object->model = glm::scale(object->model, v);
+				}
+				else if (ok && keyword == "translate") {
+					object->model = glm::translate(object->model, v);
+				}
+				else if (ok) {
+					object->model = glm::rotate(object->model, glm::radians(degrees), v);
+				}
+			}
+			else if (keyword == "dirlight")
+			{
+				DirLight& light = scene.dirLight;
+				ok = readVec3(line, light.direction) && readVec3(line, light.ambient) && readVec3(line, light.diffuse) && readVec3(line, light.specular);
+			}
+			else if (keyword == "pointlight")
+			{
+				PointLight light = {};
+				ok = readVec3(line, light.position) && line >> light.constant >> light.linear >> light.quadratic
+					&& readVec3(line, light.ambient) && readVec3(line, light.diffuse) && readVec3(line, light.specular);
+				scene.pointLights.push_back(light);
+			}
+			else if (keyword == "spotlight")
+			{
+				SpotLight& light = scene.spotLight;
+				float inner = 0.0f, outer = 0.0f;
+				ok = line >> inner >> outer >> light.constant >> light.linear >> light.quadratic
+					&& readVec3(line, light.ambient) && readVec3(line, light.diffuse) && readVec3(line, light.specular);
+				light.cutOff = glm::cos(glm::radians(inner));
+				light.outerCutOff = glm::cos(glm::radians(outer));
+				scene.hasSpotLight = true;
+			}
+			else {
+				ok = false;
+			}
+
+			if (!ok)
+			{
+				std::cout << "ERROR::SCENE: " << path << ":" << lineNumber << ": cannot read '" << rawLine << "'" << std::endl;
+				return false;
+			}
+		}
+
+		// draws follow object order; grouped by material, then mesh, within each layer
+		std::stable_sort(scene.objects.begin(), scene.objects.end(), [](const SceneObject& a, const SceneObject& b) {
+			if (a.layer != b.layer) return a.layer < b.layer;
+			if (a.material != b.material) return a.material < b.material;
+			return a.mesh < b.mesh;
+		});
+		return true;
+	}
+
+	template <typename T>
+	bool readArray(const unsigned char*& cursor, const unsigned char* end, uint32_t count, std::vector<T>& array)
+	{
+		const size_t bytes = count * sizeof(T);
+		if ((size_t)(end - cursor) < bytes) {
+			return false;
+		}
+		array.resize(count);
+		if (bytes > 0) {
+			std::memcpy(array.data(), cursor, bytes);
+		}
+		cursor += bytes;
+		return true;
+	}
+
+	bool isTerminated(const char* name, size_t size)
+	{
+		return std::memchr(name, '\0', size) != nullptr;
+	}
+
+	// what the text parser guarantees, checked again as a compiled scene may be stale or corrupt
+	bool validateScene(const char* path, const Scene& scene)
+	{
+		for (const SceneLayer& layer : scene.layers)
+		{
+			if (!isTerminated(layer.name, sizeof(layer.name)))
+			{
+				std::cout << "ERROR::SCENE: " << path << ": layer name is not terminated" << std::endl;
+				return false;
+			}
+		}
+		for (const SceneMesh& mesh : scene.meshes)
+		{
+			if (!validMeshParams(mesh))
+			{
+				std::cout << "ERROR::SCENE: " << path << ": invalid mesh shape " << mesh.shape << " or params" << std::endl;
+				return false;
+			}
+		}
+		for (const SceneMaterial& material : scene.materials)
+		{
+			if (!isTerminated(material.texture, sizeof(material.texture)))
+			{
+				std::cout << "ERROR::SCENE: " << path << ": material texture path is not terminated" << std::endl;
+				return false;
+			}
+		}
+		for (size_t i = 0; i < scene.objects.size(); i++)
+		{
+			const SceneObject& object = scene.objects[i];
+			if (object.mesh >= scene.meshes.size() || object.material >= scene.materials.size() || object.layer >= scene.layers.size())
+			{
+				std::cout << "ERROR::SCENE: " << path << ": object " << i << " refers to mesh " << object.mesh << ", material "
+					<< object.material << ", layer " << object.layer << " out of " << scene.meshes.size() << ", "
+					<< scene.materials.size() << ", " << scene.layers.size() << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool readCompiledScene(const char* path, const unsigned char* data, size_t size, Scene& scene)
+	{
+		SceneHeader header;
+		if (size < sizeof(header) + sizeof(DirLight) + sizeof(SpotLight))
+		{
+			std::cout << "ERROR::SCENE: " << path << " is truncated" << std::endl;
+			return false;
+		}
+		std::memcpy(&header, data, sizeof(header));
+		if (header.version != SCENE_VERSION)
+		{
+			std::cout << "ERROR::SCENE: " << path << " is compiled scene version " << header.version << ", this build reads version "
+				<< SCENE_VERSION << "; compile it again with --bake-scene" << std::endl;
+			return false;
+		}
+		const unsigned char* cursor = data + sizeof(header);
+		const unsigned char* end = data + size;
+		std::memcpy(&scene.dirLight, cursor, sizeof(DirLight));
+		cursor += sizeof(DirLight);
+		std::memcpy(&scene.spotLight, cursor, sizeof(SpotLight));
+		cursor += sizeof(SpotLight);
+		scene.hasSpotLight = header.hasSpotLight != 0;
+
+		const bool complete = readArray(cursor, end, header.layerCount, scene.layers)
+			&& readArray(cursor, end, header.meshCount, scene.meshes)
+			&& readArray(cursor, end, header.materialCount, scene.materials)
+			&& readArray(cursor, end, header.objectCount, scene.objects)
+			&& readArray(cursor, end, header.pointLightCount, scene.pointLights);
+		if (!complete)
+		{
+			std::cout << "ERROR::SCENE: " << path << " is truncated" << std::endl;
+			return false;
+		}
+		return validateScene(path, scene);
+	}
+
+	template <typename T>
+	bool writeArray(FILE* fp, const std::vector<T>& array)
+	{
+		return array.empty() || fwrite(array.data(), sizeof(T), array.size(), fp) == array.size();
+	}
+}
+
+bool loadScene(const char* path, Scene& scene)
+{
+	MappedFile file;
+	if (!file.open(path))
+	{
+		std::cout << "ERROR::SCENE: cannot open " << path << std::endl;
+		return false;
+	}
+
+	scene = Scene();
+	uint32_t magic = 0;
+	if (file.size() >= sizeof(magic)) {
+		std::memcpy(&magic, file.data(), sizeof(magic));
+	}
+	if (magic != SCENE_MAGIC) {
+		return parseScene(path, (const char*)file.data(), file.size(), scene);
+	}
+	return readCompiledScene(path, file.data(), file.size(), scene);
+}
+
+bool compileScene(const char* srcPath, const char* dstPath)
+{
+	Scene scene;
+	if (!loadScene(srcPath, scene)) {
+		return false;
+	}
+
+	SceneHeader header = {};
+	header.magic = SCENE_MAGIC;
+	header.layerCount = (uint32_t)scene.layers.size();
+	header.meshCount = (uint32_t)scene.meshes.size();
+	header.materialCount = (uint32_t)scene.materials.size();
+	header.objectCount = (uint32_t)scene.objects.size();
+	header.pointLightCount = (uint32_t)scene.pointLights.size();
+	header.hasSpotLight = scene.hasSpotLight ? 1 : 0;
+	header.version = SCENE_VERSION;
+
+	FILE* fp = fopen(dstPath, "wb");
+	if (fp == nullptr)
+	{
+		std::cout << "ERROR::SCENE: cannot write " << dstPath << std::endl;
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+		&& fwrite(&scene.dirLight, sizeof(DirLight), 1, fp) == 1
+		&& fwrite(&scene.spotLight, sizeof(SpotLight), 1, fp) == 1
+		&& writeArray(fp, scene.layers)
+		&& writeArray(fp, scene.meshes)
+		&& writeArray(fp, scene.materials)
+		&& writeArray(fp, scene.objects)
+		&& writeArray(fp, scene.pointLights);
+	ok = fclose(fp) == 0 && ok;
+	if (!ok) {
+		std::cout << "ERROR::SCENE: cannot write " << dstPath << std::endl;
+	}
+	return ok;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+// STL
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Project
+#include "lighting.h"
+
+// Mesh generators a scene can use, the meshes themselves are built by the program
+enum SceneShape : uint32_t
+{
+	SCENE_PLANE, //!< params: divisions, 2 to 256 (0: 10)
+	SCENE_SPHERE, //!< params: tesselation, 2 to 256 (0: 20)
+	SCENE_CUBE_NO_TOP,
+	SCENE_RECTANGLE,
+	SCENE_PYRAMID,
+	SCENE_OPEN_PYRAMID,
+	SCENE_TORUS,
+	SCENE_CYLINDER, //!< params: radius > 0, slices >= 3, height > 0
+};
+
+// Material flags
+const uint32_t SCENE_TRANSLUCENT = 0x1; //!< Blended, drawn after the opaque draws
+
+// Object flags
+const uint32_t SCENE_OCCLUDER = 0x1; //!< Large enough to hide other objects (software occlusion culling)
+
+// Everything below is plain data, so that a compiled scene loads with one copy per array
+struct SceneLayer
+{
+	char name[24];
+	float depthShare; //!< See RenderLayers::addLayer()
+};
+
+struct SceneMesh
+{
+	uint32_t shape; //!< SceneShape
+	float params[3];
+};
+
+struct SceneMaterial
+{
+	char texture[120]; //!< Path of the diffuse texture
+	uint32_t flags;
+};
+
+struct SceneObject
+{
+	glm::mat4 model;
+	uint32_t mesh; //!< Index into Scene::meshes
+	uint32_t material; //!< Index into Scene::materials
+	uint32_t layer; //!< Index into Scene::layers, later layers are drawn over earlier ones
+	uint32_t flags;
+};
+
+/**
+  A scene: layers, meshes, materials, objects and lights, in contiguous arrays. Objects are
+  sorted by layer, material and mesh when the scene is read from text, so that draws built in
+  object order need the fewest state changes; an object's index is its index in the TransformTable.
+*/
+struct Scene
+{
+	std::vector<SceneLayer> layers;
+	std::vector<SceneMesh> meshes;
+	std::vector<SceneMaterial> materials;
+	std::vector<SceneObject> objects;
+	DirLight dirLight = {};
+	std::vector<PointLight> pointLights;
+	SpotLight spotLight = {}; //!< Follows the camera, position and direction are set every frame
+	bool hasSpotLight = false;
+};
+
+/** \brief Loads a scene, either compiled by compileScene() or in the text format:
+*
+*   layer <name> <depth share>
+*   mesh <name> <plane|sphere|cube-no-top|rectangle|pyramid|open-pyramid|torus|cylinder> [params]
+*   material <name> <texture path> [translucent]
+*   object <mesh> <material> <layer> [occluder]
+*     scale <x> <y> <z>                (applied to the last object, in order)
+*     translate <x> <y> <z>
+*     rotate <degrees> <x> <y> <z>
+*   dirlight <direction> <ambient> <diffuse> <specular>
+*   pointlight <position> <constant> <linear> <quadratic> <ambient> <diffuse> <specular>
+*   spotlight <inner degrees> <outer degrees> <constant> <linear> <quadratic> <ambient> <diffuse> <specular>
+*
+*   Vectors are 3 numbers, '#' starts a comment.
+*   \param path  Path to the scene file
+*   \param scene Receives the scene
+*   \return True if the scene has been loaded or false otherwise.
+*/
+bool loadScene(const char* path, Scene& scene);
+
+/** \brief Offline step: reads a text scene and writes it in the binary form loadScene() reads with a few bulk copies.
+*   \param srcPath Text scene
+*   \param dstPath Compiled scene
+*   \return True if the scene has been compiled or false otherwise.
+*/
+bool compileScene(const char* srcPath, const char* dstPath);
@@ -13,6 +13,8 @@ using namespace std;
 #include <GL/glew.h>
 
 #include "shader.hpp"
+#include "programCache.h"
+#include "resourceTracker.h"
 
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
 
@@ -44,6 +46,15 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 		FragmentShaderStream.close();
 	}
 
+	// Reuse the program binary from the last run if the driver still accepts it
+	const uint64_t CacheKey = programCacheKey(VertexShaderCode + '\0' + FragmentShaderCode);
+	GLuint CachedProgramID = loadCachedProgram(CacheKey, RESOURCE_SITE);
+	if (CachedProgramID != 0){
+		glDeleteShader(VertexShaderID);
+		glDeleteShader(FragmentShaderID);
+		return CachedProgramID;
+	}
+
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
 
@@ -84,9 +95,10 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 
 	// Link the program
 	printf("Linking program\n");
-	GLuint ProgramID = glCreateProgram();
+	GLuint ProgramID = trackedCreateProgram();
 	glAttachShader(ProgramID, VertexShaderID);
 	glAttachShader(ProgramID, FragmentShaderID);
+	prepareProgramForCache(ProgramID);
 	glLinkProgram(ProgramID);
 
 	// Check the program
@@ -97,6 +109,9 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
 		printf("%s\n", &ProgramErrorMessage[0]);
 	}
+	if ( Result == GL_TRUE ){
+		storeCachedProgram(CacheKey, ProgramID);
+	}
 
 	
 	glDetachShader(ProgramID, VertexShaderID);
@@ -10,14 +10,26 @@
 #include <sstream>
 #include <iostream>
 
+#include "programCache.h"
+#include "resourceTracker.h"
+
 class Shader
 {
 public:
 	unsigned int ID;
+	// empty shader, the program is built later (see ShaderBatch)
+	// ------------------------------------------------------------------------
+	Shader() : ID(0)
+	{
+	}
 	// constructor generates the shader on the fly
 	// ------------------------------------------------------------------------
-	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+	// site is what the resource tracker reports the program under (RESOURCE_SITE of the owner), this file if not given
+	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const char* site = nullptr)
 	{
+		if (site == nullptr) {
+			site = RESOURCE_SITE;
+		}
 		// 1. retrieve the vertex/fragment source code from filePath
 		std::string vertexCode;
 		std::string fragmentCode;
@@ -58,9 +70,14 @@ public:
 		{
 			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 		}
+		// 2. reuse the program binary from the last run if the driver still accepts it
+		const uint64_t cacheKey = programCacheKey(vertexCode + '\0' + fragmentCode + '\0' + geometryCode);
+		ID = loadCachedProgram(cacheKey, site);
+		if (ID != 0)
+			return;
 		const char* vShaderCode = vertexCode.c_str();
 		const char * fShaderCode = fragmentCode.c_str();
-		// 2. compile shaders
+		// 3. compile shaders
 		unsigned int vertex, fragment;
 		// vertex shader
 		vertex = glCreateShader(GL_VERTEX_SHADER);
@@ -83,13 +100,15 @@ public:
 			checkCompileErrors(geometry, "GEOMETRY");
 		}
 		// shader Program
-		ID = glCreateProgram();
+		ID = trackCreateProgram(site);
 		glAttachShader(ID, vertex);
 		glAttachShader(ID, fragment);
 		if (geometryPath != nullptr)
 			glAttachShader(ID, geometry);
+		prepareProgramForCache(ID);
 		glLinkProgram(ID);
-		checkCompileErrors(ID, "PROGRAM");
+		if (checkCompileErrors(ID, "PROGRAM"))
+			storeCachedProgram(cacheKey, ID);
 		// delete the shaders as they're linked into our program now and no longer necessery
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
@@ -97,6 +116,14 @@ public:
 			glDeleteShader(geometry);
 
 	}
+	// delete the program, the shader is empty again
+	// ------------------------------------------------------------------------
+	void deleteProgram()
+	{
+		if (ID != 0)
+			trackedDeleteProgram(ID);
+		ID = 0;
+	}
 	// activate the shader
 	// ------------------------------------------------------------------------
 	void use()
@@ -163,9 +190,9 @@ public:
 	}
 
 private:
-	// utility function for checking shader compilation/linking errors.
+	// utility function for checking shader compilation/linking errors, returns true on success.
 	// ------------------------------------------------------------------------
-	void checkCompileErrors(GLuint shader, std::string type)
+	bool checkCompileErrors(GLuint shader, std::string type)
 	{
 		GLint success;
 		GLchar infoLog[1024];
@@ -187,8 +214,25 @@ private:
 				std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
 			}
 		}
+		return success != 0;
 	}
 };
+
+// inserts "#define" lines right after the #version line of a shader source (used for permutations)
+// ------------------------------------------------------------------------
+inline std::string injectShaderDefines(const std::string& source, const std::string& defines)
+{
+	if (defines.empty())
+		return source;
+	size_t versionEnd = 0;
+	if (source.compare(0, 8, "#version") == 0)
+	{
+		versionEnd = source.find('\n');
+		versionEnd = versionEnd == std::string::npos ? source.size() : versionEnd + 1;
+	}
+	// #line keeps the line numbers of compile errors pointing into the file
+	return source.substr(0, versionEnd) + defines + "#line " + std::to_string(versionEnd > 0 ? 2 : 1) + "\n" + source.substr(versionEnd);
+}
 #endif
 //#ifndef SHADER_H
 //#define SHADER_H
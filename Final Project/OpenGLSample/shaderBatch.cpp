@@ -0,0 +1,312 @@
+// STL
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <GLFW/glfw3.h>
+
+// Project
+#include "shaderBatch.h"
+#include "parallel.h"
+#include "programCache.h"
+#include "resourceTracker.h"
+
+// GL_KHR_parallel_shader_compile (GL_ARB_parallel_shader_compile has the same values), not in our glad
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR           0x91B1
+#endif
+
+namespace {
+
+	typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+
+	// Returns true if the driver can report completion without blocking
+	bool enableParallelCompile()
+	{
+		static const bool enabled = [] {
+			PFNGLMAXSHADERCOMPILERTHREADSPROC maxShaderCompilerThreads = nullptr;
+			if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+				maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+			}
+			else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile")) {
+				maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+			}
+			if (maxShaderCompilerThreads == nullptr) {
+				return false;
+			}
+
+			// let the driver pick the number of compiler threads
+			maxShaderCompilerThreads(0xFFFFFFFF);
+			return true;
+		}();
+		return enabled;
+	}
+
+	void printShaderLog(GLuint shader, const std::string& path)
+	{
+		GLchar infoLog[1024];
+		glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+		std::cout << "ERROR::SHADER_COMPILATION_ERROR of file: " << path << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+	}
+
+	void printProgramLog(GLuint program, const std::string& path)
+	{
+		GLchar infoLog[1024];
+		glGetProgramInfoLog(program, 1024, NULL, infoLog);
+		std::cout << "ERROR::PROGRAM_LINKING_ERROR of program: " << path << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+	}
+}
+
+ShaderBatch::ShaderBatch(const char* site)
+	: _site(site)
+{
+}
+
+void ShaderBatch::add(Shader& target, const char* vertexPath, const char* fragmentPath, const char* geometryPath)
+{
+	Program program;
+	program.target = &target;
+
+	Stage stage;
+	stage.type = GL_VERTEX_SHADER;
+	stage.path = vertexPath;
+	program.stages.push_back(stage);
+	stage.type = GL_FRAGMENT_SHADER;
+	stage.path = fragmentPath;
+	program.stages.push_back(stage);
+	if (geometryPath != nullptr)
+	{
+		stage.type = GL_GEOMETRY_SHADER;
+		stage.path = geometryPath;
+		program.stages.push_back(stage);
+	}
+
+	_programs.push_back(std::move(program));
+}
+
+void ShaderBatch::addPermutation(Shader& target, const char* vertexPath, const char* fragmentPath, const std::string& defines)
+{
+	add(target, vertexPath, fragmentPath);
+	_programs.back().defines = defines;
+}
+
+bool ShaderBatch::build()
+{
+	if (_programs.empty()) {
+		return true;
+	}
+
+	const double batchStart = glfwGetTime();
+	const bool parallelCompile = enableParallelCompile();
+	readSources();
+
+	// 1. programs in the binary cache are done right away, using the same key as Shader
+	for (auto& program : _programs)
+	{
+		if (program.readFailed) {
+			continue;
+		}
+
+		const std::string geometrySource = program.stages.size() > 2 ? program.stages[2].source : std::string();
+		program.cacheKey = programCacheKey(program.stages[0].source + '\0' + program.stages[1].source + '\0' + geometrySource);
+		program.program = loadCachedProgram(program.cacheKey, _site);
+		program.cached = program.program != 0;
+	}
+
+	// 2. issue every compile, then every link, without asking for any status in between
+	const double compileStart = glfwGetTime();
+	for (auto& program : _programs)
+	{
+		if (program.cached || program.readFailed) {
+			continue;
+		}
+
+		for (auto& stage : program.stages)
+		{
+			const char* source = stage.source.c_str();
+			stage.shader = glCreateShader(stage.type);
+			glShaderSource(stage.shader, 1, &source, NULL);
+			glCompileShader(stage.shader);
+		}
+	}
+	for (auto& program : _programs)
+	{
+		if (program.cached || program.readFailed) {
+			continue;
+		}
+
+		program.program = trackCreateProgram(_site);
+		for (const auto& stage : program.stages) {
+			glAttachShader(program.program, stage.shader);
+		}
+		prepareProgramForCache(program.program);
+		glLinkProgram(program.program);
+	}
+
+	// 3. collect the results
+	if (parallelCompile) {
+		waitForCompletion(compileStart);
+	}
+
+	bool success = true;
+	for (auto& program : _programs)
+	{
+		if (!program.cached && !program.readFailed && !parallelCompile)
+		{
+			// without the extension the first status query blocks until that program is done
+			GLint linked;
+			glGetProgramiv(program.program, GL_LINK_STATUS, &linked);
+			program.buildMilliseconds = (glfwGetTime() - compileStart) * 1000.0;
+		}
+		success = finishProgram(program) && success;
+
+		std::cout << "Shader program " << program.stages[0].path << ": ";
+		if (program.readFailed)
+			std::cout << "not built" << std::endl;
+		else if (program.cached)
+			std::cout << "from cache" << std::endl;
+		else
+			std::cout << program.buildMilliseconds << " ms" << std::endl;
+	}
+	std::cout << "Built " << _programs.size() << " shader programs in " << (glfwGetTime() - batchStart) * 1000.0 << " ms" << (parallelCompile ? " (parallel compile)" : "") << std::endl;
+
+	_programs.clear();
+	return success;
+}
+
+void ShaderBatch::readSources()
+{
+	size_t numStages = 0;
+	for (const auto& program : _programs) {
+		numStages += program.stages.size();
+	}
+
+	std::vector<Stage*> stages;
+	stages.reserve(numStages);
+	for (auto& program : _programs)
+	{
+		for (auto& stage : program.stages) {
+			stages.push_back(&stage);
+		}
+	}
+
+	std::vector<char> failed(stages.size(), 0);
+	parallelFor(stages.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			std::ifstream file(stages[i]->path);
+			if (!file.is_open())
+			{
+				failed[i] = 1;
+				continue;
+			}
+			std::stringstream stream;
+			stream << file.rdbuf();
+			stages[i]->source = stream.str();
+		}
+	});
+	for (auto& program : _programs)
+	{
+		for (auto& stage : program.stages) {
+			stage.source = injectShaderDefines(stage.source, program.defines);
+		}
+	}
+
+	size_t index = 0;
+	for (auto& program : _programs)
+	{
+		for (const auto& stage : program.stages)
+		{
+			if (failed[index++])
+			{
+				std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << stage.path << std::endl;
+				program.readFailed = true;
+			}
+		}
+	}
+}
+
+void ShaderBatch::waitForCompletion(double startSeconds)
+{
+	size_t pending = 0;
+	for (const auto& program : _programs)
+	{
+		if (!program.cached && !program.readFailed) {
+			pending++;
+		}
+	}
+
+	std::vector<char> done(_programs.size(), 0);
+	while (pending > 0)
+	{
+		for (size_t i = 0; i < _programs.size(); i++)
+		{
+			Program& program = _programs[i];
+			if (done[i] || program.cached || program.readFailed) {
+				continue;
+			}
+
+			GLint complete = GL_FALSE;
+			glGetProgramiv(program.program, GL_COMPLETION_STATUS_KHR, &complete);
+			if (complete)
+			{
+				program.buildMilliseconds = (glfwGetTime() - startSeconds) * 1000.0;
+				done[i] = 1;
+				pending--;
+			}
+		}
+		if (pending > 0) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool ShaderBatch::finishProgram(Program& program)
+{
+	if (program.readFailed)
+	{
+		program.target->ID = 0;
+		return false;
+	}
+	if (program.cached)
+	{
+		program.target->ID = program.program;
+		return true;
+	}
+
+	GLint success;
+	for (const auto& stage : program.stages)
+	{
+		glGetShaderiv(stage.shader, GL_COMPILE_STATUS, &success);
+		if (!success) {
+			printShaderLog(stage.shader, stage.path);
+		}
+	}
+
+	GLint linked;
+	glGetProgramiv(program.program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		printProgramLog(program.program, program.stages[0].path);
+	}
+
+	// the shaders are linked into our program now and no longer necessary
+	for (auto& stage : program.stages)
+	{
+		glDetachShader(program.program, stage.shader);
+		glDeleteShader(stage.shader);
+		stage.shader = 0;
+	}
+
+	if (!linked)
+	{
+		trackedDeleteProgram(program.program);
+		program.target->ID = 0;
+		return false;
+	}
+
+	storeCachedProgram(program.cacheKey, program.program);
+	program.target->ID = program.program;
+	return true;
+}
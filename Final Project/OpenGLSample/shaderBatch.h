@@ -0,0 +1,76 @@
+#pragma once
+
+// STL
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Project
+#include "shader.h"
+
+/**
+  Builds several shader programs at once. All files are read concurrently, then every stage
+  of every program is compiled and every program linked before the first status query, so
+  drivers that compile in the background (GL_KHR_parallel_shader_compile, or simply a deferred
+  compile as most drivers do) overlap the work instead of being serialized by glGetShaderiv.
+  Programs found in the program binary cache skip compilation entirely.
+*/
+class ShaderBatch
+{
+public:
+	/** \brief Creates an empty batch.
+	*   \param site Call site the programs are tracked under (RESOURCE_SITE of their owner), see resourceTracker.h
+	*/
+	explicit ShaderBatch(const char* site);
+
+	/** \brief Queues a program. The target is filled in by build().
+	*   \param target       Shader that receives the program ID (must outlive build())
+	*   \param vertexPath   Vertex shader file
+	*   \param fragmentPath Fragment shader file
+	*   \param geometryPath Optional geometry shader file
+	*/
+	void add(Shader& target, const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr);
+
+	/** \brief Queues a permutation of a program, the defines are inserted after the #version line of every stage.
+	*   \param target       Shader that receives the program ID (must outlive build())
+	*   \param vertexPath   Vertex shader file
+	*   \param fragmentPath Fragment shader file
+	*   \param defines      "#define NAME value" lines
+	*/
+	void addPermutation(Shader& target, const char* vertexPath, const char* fragmentPath, const std::string& defines);
+
+	/** \brief Builds every queued program, reports per-program build times and clears the queue.
+	*   \return True if every program linked or false otherwise (failed programs get ID 0, errors are printed).
+	*/
+	bool build();
+
+private:
+	struct Stage
+	{
+		GLenum type;
+		std::string path;
+		std::string source;
+		GLuint shader = 0;
+	};
+
+	struct Program
+	{
+		Shader* target;
+		std::vector<Stage> stages;
+		std::string defines;
+		uint64_t cacheKey = 0;
+		GLuint program = 0;
+		bool cached = false;
+		bool readFailed = false;
+		double buildMilliseconds = 0.0; //!< From issuing the compiles until the link status is known
+	};
+
+	void readSources();
+	void waitForCompletion(double startSeconds);
+	bool finishProgram(Program& program);
+
+	std::vector<Program> _programs;
+	const char* _site;
+};
@@ -0,0 +1,91 @@
+// Project
+#include "shaderPermutations.h"
+#include "shaderBatch.h"
+#include "shaderReloader.h"
+
+namespace {
+
+	unsigned int lowestSetBit(uint32_t mask)
+	{
+		unsigned int shift = 0;
+		while (mask != 0 && (mask & 1) == 0)
+		{
+			mask >>= 1;
+			shift++;
+		}
+		return shift;
+	}
+}
+
+ShaderPermutations::ShaderPermutations(const char* vertexPath, const char* fragmentPath, const std::vector<Define>& defines, const char* site, ShaderReloader* reloader)
+	: _vertexPath(vertexPath)
+	, _fragmentPath(fragmentPath)
+	, _defines(defines)
+	, _site(site)
+	, _reloader(reloader)
+{
+}
+
+void ShaderPermutations::precompile(const std::vector<uint32_t>& featureMasks)
+{
+	ShaderBatch batch(_site);
+	std::vector<uint32_t> added;
+	for (uint32_t features : featureMasks)
+	{
+		if (_variants.count(features) != 0) {
+			continue;
+		}
+		Variant& variant = _variants[features];
+		batch.addPermutation(variant.shader, _vertexPath.c_str(), _fragmentPath.c_str(), definesFor(features));
+		added.push_back(features);
+	}
+	batch.build();
+
+	for (uint32_t features : added) {
+		addToReloader(_variants[features], features);
+	}
+}
+
+ShaderPermutations::Variant& ShaderPermutations::get(uint32_t features)
+{
+	auto it = _variants.find(features);
+	if (it != _variants.end()) {
+		return it->second;
+	}
+
+	// a variant nobody asked for up front, this stalls the frame it first shows up in
+	Variant& variant = _variants[features];
+	ShaderBatch batch(_site);
+	batch.addPermutation(variant.shader, _vertexPath.c_str(), _fragmentPath.c_str(), definesFor(features));
+	batch.build();
+	addToReloader(variant, features);
+	return variant;
+}
+
+size_t ShaderPermutations::size() const
+{
+	return _variants.size();
+}
+
+std::string ShaderPermutations::definesFor(uint32_t features) const
+{
+	std::string defines;
+	for (const auto& define : _defines)
+	{
+		const uint32_t value = (features & define.mask) >> lowestSetBit(define.mask);
+		defines += std::string("#define ") + define.name + " " + std::to_string(value) + "\n";
+	}
+	return defines;
+}
+
+void ShaderPermutations::addToReloader(Variant& variant, uint32_t features)
+{
+	if (_reloader != nullptr && variant.shader.ID != 0)
+	{
+		// uniforms are gone with the old program, have them set again on the next use
+		_reloader->watch(variant.shader, _vertexPath.c_str(), _fragmentPath.c_str(), [&variant](Shader&) {
+			variant.lastFrame = ~0u;
+			variant.stateKey = ~0ull;
+		}, definesFor(features));
+	}
+}
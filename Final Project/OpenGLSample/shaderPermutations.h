@@ -0,0 +1,71 @@
+#pragma once
+
+// STL
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Project
+#include "shader.h"
+
+class ShaderReloader;
+
+/**
+  Compile-time specialised variants of one shader program. A feature bitmask selects the
+  variant, every define of the program takes its value from a bit field of the mask, e.g.
+  { "NR_POINT_LIGHTS", 0x7 } turns mask 0x1B into "#define NR_POINT_LIGHTS 3". Variants are
+  compiled the first time they are requested (or up front with precompile()) and kept for the
+  lifetime of the object, so the draw loop only pays for a hash lookup.
+*/
+class ShaderPermutations
+{
+public:
+	struct Define
+	{
+		const char* name;
+		uint32_t mask; //!< Contiguous bits of the feature mask holding the value
+	};
+
+	struct Variant
+	{
+		Shader shader;
+		// free for the caller, e.g. to set per-frame uniforms once and skip re-setting unchanged ones
+		unsigned int lastFrame = ~0u;
+		uint64_t stateKey = ~0ull;
+	};
+
+	/** \brief Describes the permuted program, nothing is compiled yet.
+	*   \param vertexPath   Vertex shader file
+	*   \param fragmentPath Fragment shader file
+	*   \param defines      Defines driven by the feature mask
+	*   \param site         Call site the variants are tracked under (RESOURCE_SITE of the owner), see resourceTracker.h
+	*   \param reloader     Optional, compiled variants are hot-reloaded when their files change
+	*/
+	ShaderPermutations(const char* vertexPath, const char* fragmentPath, const std::vector<Define>& defines, const char* site, ShaderReloader* reloader = nullptr);
+
+	/** \brief Compiles several variants as one batch, use it at startup for the variants every frame needs.
+	*   \param featureMasks Masks of the variants to build
+	*/
+	void precompile(const std::vector<uint32_t>& featureMasks);
+
+	/** \brief Gets the variant for a feature mask, compiling it first if this is the first request.
+	*   \param features Feature bitmask
+	*   \return The variant, references stay valid for the lifetime of this object.
+	*/
+	Variant& get(uint32_t features);
+
+	/** \brief Gets the number of variants compiled so far. */
+	size_t size() const;
+
+private:
+	std::string definesFor(uint32_t features) const;
+	void addToReloader(Variant& variant, uint32_t features);
+
+	std::string _vertexPath;
+	std::string _fragmentPath;
+	std::vector<Define> _defines;
+	const char* _site;
+	ShaderReloader* _reloader;
+	std::unordered_map<uint32_t, Variant> _variants;
+};
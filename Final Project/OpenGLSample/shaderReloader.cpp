@@ -0,0 +1,272 @@
+// STL
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Project
+#include "shaderReloader.h"
+#include "resourceTracker.h"
+
+namespace {
+
+	// Editors save in several steps (truncate, write, rename), wait for them to settle
+	const std::chrono::milliseconds SETTLE_TIME(50);
+	const int WAIT_TIMEOUT_MS = 100;
+
+	bool readFile(const std::string& path, std::string& contents)
+	{
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			return false;
+		}
+		std::stringstream stream;
+		stream << file.rdbuf();
+		contents = stream.str();
+		return true;
+	}
+
+	size_t hashSources(const std::string& vertexCode, const std::string& fragmentCode)
+	{
+		return std::hash<std::string>()(vertexCode + '\0' + fragmentCode);
+	}
+
+	bool checkShader(GLuint shader, const std::string& path)
+	{
+		GLint success;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			GLchar infoLog[1024];
+			glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+			std::cout << "ERROR::SHADER_COMPILATION_ERROR of file: " << path << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+		}
+		return success != 0;
+	}
+}
+
+ShaderReloader::ShaderReloader(GLFWwindow* mainWindow, const char* directory)
+	: _directory(directory)
+	, _quit(false)
+{
+	// the hidden window only exists for its context, the other hints (version, profile) still apply
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	_context = glfwCreateWindow(1, 1, "Shader reloader", NULL, mainWindow);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	if (_context == NULL)
+	{
+		std::cout << "Failed to create shared context, shader hot-reload is disabled" << std::endl;
+		return;
+	}
+
+#ifdef _WIN32
+	HANDLE changeHandle = FindFirstChangeNotificationA(directory, FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+	_changeHandle = changeHandle != INVALID_HANDLE_VALUE ? changeHandle : nullptr;
+	const bool watching = _changeHandle != nullptr;
+#else
+	_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	const bool watching = _inotifyFd >= 0 && inotify_add_watch(_inotifyFd, directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) >= 0;
+#endif
+	if (!watching)
+	{
+		std::cout << "Failed to watch directory: " << directory << ", shader hot-reload is disabled" << std::endl;
+		return;
+	}
+
+	_worker = std::thread(&ShaderReloader::workerLoop, this);
+}
+
+ShaderReloader::~ShaderReloader()
+{
+	_quit = true;
+	if (_worker.joinable()) {
+		_worker.join();
+	}
+
+#ifdef _WIN32
+	if (_changeHandle != nullptr) {
+		FindCloseChangeNotification(_changeHandle);
+	}
+#else
+	if (_inotifyFd >= 0) {
+		close(_inotifyFd);
+	}
+#endif
+
+	// programs that were never swapped in, their jobs see _quit and delete them
+	JobSystem::instance().wait(_swaps);
+
+	if (_context != NULL) {
+		glfwDestroyWindow(_context);
+	}
+}
+
+void ShaderReloader::watch(Shader& target, const char* vertexPath, const char* fragmentPath, std::function<void(Shader&)> onReload, const std::string& defines)
+{
+	WatchedProgram watched;
+	watched.target = &target;
+	watched.vertexPath = vertexPath;
+	watched.fragmentPath = fragmentPath;
+	watched.defines = defines;
+	watched.onReload = std::move(onReload);
+	watched.site = trackedSite(RESOURCE_PROGRAM, target.ID);
+
+	std::string vertexCode, fragmentCode;
+	readFile(watched.vertexPath, vertexCode);
+	readFile(watched.fragmentPath, fragmentCode);
+	watched.sourceHash = hashSources(vertexCode, fragmentCode);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_watched.push_back(std::move(watched));
+}
+
+void ShaderReloader::swapJob(void* data, size_t index, size_t program)
+{
+	static_cast<ShaderReloader*>(data)->swap(index, (GLuint)program);
+}
+
+void ShaderReloader::swap(size_t index, GLuint program)
+{
+	if (_quit)
+	{
+		trackedDeleteProgram(program);
+		return;
+	}
+
+	// only the main thread adds to _watched, and the worker only writes source hashes
+	WatchedProgram& watched = _watched[index];
+	watched.target->deleteProgram();
+	watched.target->ID = program;
+	if (watched.onReload) {
+		watched.onReload(*watched.target);
+	}
+	std::cout << "Reloaded shader program " << watched.vertexPath << " / " << watched.fragmentPath << std::endl;
+}
+
+void ShaderReloader::workerLoop()
+{
+	glfwMakeContextCurrent(_context);
+
+	while (!_quit)
+	{
+		if (!waitForChange()) {
+			continue;
+		}
+
+		std::vector<WatchedProgram> watched;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			watched = _watched;
+		}
+
+		for (size_t i = 0; i < watched.size() && !_quit; i++)
+		{
+			std::string vertexCode, fragmentCode;
+			if (!readFile(watched[i].vertexPath, vertexCode) || !readFile(watched[i].fragmentPath, fragmentCode)) {
+				continue;
+			}
+			const size_t sourceHash = hashSources(vertexCode, fragmentCode);
+			if (sourceHash == watched[i].sourceHash) {
+				continue;
+			}
+
+			// remember the sources even if they don't compile, so they aren't retried until saved again
+			const GLuint program = compileProgram(watched[i], vertexCode, fragmentCode);
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_watched[i].sourceHash = sourceHash;
+			}
+			if (program != 0) {
+				JobSystem::instance().runOnMainThread(&ShaderReloader::swapJob, this, i, program, &_swaps);
+			}
+		}
+	}
+
+	glfwMakeContextCurrent(NULL);
+}
+
+bool ShaderReloader::waitForChange()
+{
+#ifdef _WIN32
+	if (WaitForSingleObject(_changeHandle, WAIT_TIMEOUT_MS) != WAIT_OBJECT_0) {
+		return false;
+	}
+	FindNextChangeNotification(_changeHandle);
+	std::this_thread::sleep_for(SETTLE_TIME);
+	while (WaitForSingleObject(_changeHandle, 0) == WAIT_OBJECT_0) {
+		FindNextChangeNotification(_changeHandle);
+	}
+#else
+	pollfd pollFd = { _inotifyFd, POLLIN, 0 };
+	if (poll(&pollFd, 1, WAIT_TIMEOUT_MS) <= 0) {
+		return false;
+	}
+	std::this_thread::sleep_for(SETTLE_TIME);
+
+	// which files changed doesn't matter, the sources of every watched program are compared anyway
+	char events[4096];
+	while (read(_inotifyFd, events, sizeof(events)) > 0) {
+	}
+#endif
+	return true;
+}
+
+GLuint ShaderReloader::compileProgram(const WatchedProgram& watched, const std::string& vertexCode, const std::string& fragmentCode)
+{
+	const std::string vertexSource = injectShaderDefines(vertexCode, watched.defines);
+	const std::string fragmentSource = injectShaderDefines(fragmentCode, watched.defines);
+	const char* vShaderCode = vertexSource.c_str();
+	const char* fShaderCode = fragmentSource.c_str();
+
+	GLuint vertex = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(vertex, 1, &vShaderCode, NULL);
+	glCompileShader(vertex);
+	GLuint fragment = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(fragment, 1, &fShaderCode, NULL);
+	glCompileShader(fragment);
+
+	GLuint program = 0;
+	const bool vertexCompiled = checkShader(vertex, watched.vertexPath);
+	const bool fragmentCompiled = checkShader(fragment, watched.fragmentPath);
+	if (vertexCompiled && fragmentCompiled)
+	{
+		// the reloaded program replaces the target's, report it under the same owner
+		program = watched.site != nullptr ? trackCreateProgram(watched.site) : trackedCreateProgram();
+		glAttachShader(program, vertex);
+		glAttachShader(program, fragment);
+		glLinkProgram(program);
+		glDetachShader(program, vertex);
+		glDetachShader(program, fragment);
+
+		GLint success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			GLchar infoLog[1024];
+			glGetProgramInfoLog(program, 1024, NULL, infoLog);
+			std::cout << "ERROR::PROGRAM_LINKING_ERROR of program: " << watched.vertexPath << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+			trackedDeleteProgram(program);
+			program = 0;
+		}
+	}
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+
+	if (program == 0)
+	{
+		std::cout << "Failed to reload shader program " << watched.vertexPath << " / " << watched.fragmentPath << ", keeping the previous one" << std::endl;
+	}
+	// the render thread's context may only use the program once it is complete on ours
+	glFinish();
+	return program;
+}
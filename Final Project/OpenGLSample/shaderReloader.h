@@ -0,0 +1,76 @@
+#pragma once
+
+// STL
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+// Project
+#include "jobSystem.h"
+#include "shader.h"
+
+/**
+  Hot-reloads shader programs while the application runs. A worker thread waits for changes in
+  the shader directory (inotify on Linux, change notifications on Windows), recompiles affected
+  programs on a hidden context shared with the main window and hands them over as main thread
+  jobs (JobSystem::runOnMainThread()): the render thread swaps them in at its job point of the
+  frame, or while it waits for jobs before drawing, and never waits on the worker.
+  A program that fails to compile or link is reported and the previous one stays in use.
+*/
+class ShaderReloader
+{
+public:
+	/** \brief Creates the shared context and starts watching. Must be called on the main thread.
+	*   \param mainWindow Window whose context the reloaded programs are used in
+	*   \param directory  Directory containing the watched shader files
+	*/
+	ShaderReloader(GLFWwindow* mainWindow, const char* directory);
+	~ShaderReloader();
+
+	/** \brief Reloads a program whenever one of its files changes.
+	*   \param target       Shader that receives the new program ID (must outlive the reloader)
+	*   \param vertexPath   Vertex shader file
+	*   \param fragmentPath Fragment shader file
+	*   \param onReload     Called on the render thread after a swap, e.g. to set uniforms that are set only once
+	*   \param defines      Permutation defines the program was built with (see injectShaderDefines())
+	*/
+	void watch(Shader& target, const char* vertexPath, const char* fragmentPath, std::function<void(Shader&)> onReload = nullptr, const std::string& defines = std::string());
+
+private:
+	struct WatchedProgram
+	{
+		Shader* target;
+		std::string vertexPath;
+		std::string fragmentPath;
+		std::string defines;
+		size_t sourceHash; //!< Of both sources as last compiled, saves that don't change them are ignored
+		const char* site; //!< Resource tracker site of the watched program, reloaded ones are reported under it too
+		std::function<void(Shader&)> onReload;
+	};
+
+	static void swapJob(void* data, size_t index, size_t program);
+	void swap(size_t index, GLuint program);
+	void workerLoop();
+	bool waitForChange();
+	GLuint compileProgram(const WatchedProgram& watched, const std::string& vertexCode, const std::string& fragmentCode);
+
+	GLFWwindow* _context = nullptr; //! Hidden window sharing objects with the main window
+	std::string _directory;
+	std::thread _worker;
+	std::mutex _mutex;
+	std::vector<WatchedProgram> _watched;
+	JobCounter _swaps; //! Linked programs handed to the main thread and not swapped in yet
+	std::atomic<bool> _quit;
+
+#ifdef _WIN32
+	void* _changeHandle = nullptr;
+#else
+	int _inotifyFd = -1;
+#endif
+};
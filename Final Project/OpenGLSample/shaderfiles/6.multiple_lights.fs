@@ -27,9 +27,7 @@ struct PointLight {
     vec3 specular;
 };
 
-struct SpotLight {
-    vec3 position;
-    vec3 direction;
+struct SpotLight { // position and direction come from the Camera block
     float cutOff;
     float outerCutOff;
   
@@ -42,22 +40,62 @@ struct SpotLight {
     vec3 specular;       
 };
 
+// permutation defines, injected by ShaderPermutations (these defaults give the full shader)
+#ifndef NR_POINT_LIGHTS
 #define NR_POINT_LIGHTS 4
+#endif
+#ifndef USE_SPOT_LIGHT
+#define USE_SPOT_LIGHT 1
+#endif
+#ifndef HAS_SPECULAR_MAP
+#define HAS_SPECULAR_MAP 1
+#endif
+#ifndef CLUSTERED_LIGHTING
+#define CLUSTERED_LIGHTING 0
+#endif
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
-uniform vec3 viewPos;
+// written by CameraBlock right before the draws, with the latest mouse input
+layout(std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 inverseView;
+    vec3 viewPos;
+    vec3 spotLightPosition; // the flashlight follows the camera
+    vec3 spotLightDirection;
+};
+
 uniform DirLight dirLight;
+#if NR_POINT_LIGHTS > 0
 uniform PointLight pointLights[NR_POINT_LIGHTS];
+#endif
+#if USE_SPOT_LIGHT
 uniform SpotLight spotLight;
+#endif
 uniform Material material;
+#if CLUSTERED_LIGHTING
+// point lights binned per cluster by LightClusters
+uniform samplerBuffer clusterLights;        // 4 texels per light
+uniform usamplerBuffer clusterGrid;         // (offset, count) into clusterLightIndices per cluster
+uniform usamplerBuffer clusterLightIndices;
+uniform mat4 clusterView;                   // view matrix the lights were binned with
+uniform vec2 clusterSliceScaleBias;         // slice = log(view depth) * x + y
+const int CLUSTER_TILES_X = 16;
+const int CLUSTER_TILES_Y = 9;
+const int CLUSTER_SLICES = 24;
+#endif
 
 // function prototypes
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+#if CLUSTERED_LIGHTING
+vec3 CalcClusterLights(vec3 normal, vec3 fragPos, vec3 viewDir);
+#endif
 
 void main()
 {    
@@ -74,10 +112,17 @@ void main()
     // phase 1: directional lighting
     vec3 result = CalcDirLight(dirLight, norm, viewDir);
     // phase 2: point lights
+#if NR_POINT_LIGHTS > 0
     for(int i = 0; i < NR_POINT_LIGHTS; i++)
         result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);    
+#endif
+#if CLUSTERED_LIGHTING
+    result += CalcClusterLights(norm, FragPos, viewDir);
+#endif
     // phase 3: spot light
+#if USE_SPOT_LIGHT
     result += CalcSpotLight(spotLight, norm, FragPos, viewDir);    
+#endif
     
     FragColor = vec4(result, 1.0);
 }
@@ -88,13 +133,19 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 lightDir = normalize(-light.direction);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
+#if HAS_SPECULAR_MAP
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+#endif
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
+#if HAS_SPECULAR_MAP
     vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+#else
+    vec3 specular = vec3(0.0); // no specular map is bound, it would sample as black
+#endif
     return (ambient + diffuse + specular);
 }
 
@@ -104,16 +155,22 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
+#if HAS_SPECULAR_MAP
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+#endif
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
+#if HAS_SPECULAR_MAP
     vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+#else
+    vec3 specular = vec3(0.0); // no specular map is bound, it would sample as black
+#endif
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -123,25 +180,69 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 // calculates the color when using a spot light.
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
-    vec3 lightDir = normalize(light.position - fragPos);
+    vec3 lightDir = normalize(spotLightPosition - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
+#if HAS_SPECULAR_MAP
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+#endif
     // attenuation
-    float distance = length(light.position - fragPos);
+    float distance = length(spotLightPosition - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
     // spotlight intensity
-    float theta = dot(lightDir, normalize(-light.direction)); 
+    float theta = dot(lightDir, normalize(-spotLightDirection)); 
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
+#if HAS_SPECULAR_MAP
     vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+#else
+    vec3 specular = vec3(0.0); // no specular map is bound, it would sample as black
+#endif
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
     return (ambient + diffuse + specular);
-}
\ No newline at end of file
+}
+
+#if CLUSTERED_LIGHTING
+PointLight fetchPointLight(int index)
+{
+    vec4 positionConstant = texelFetch(clusterLights, index * 4);
+    vec4 ambientLinear = texelFetch(clusterLights, index * 4 + 1);
+    vec4 diffuseQuadratic = texelFetch(clusterLights, index * 4 + 2);
+    vec4 specular = texelFetch(clusterLights, index * 4 + 3);
+    return PointLight(positionConstant.xyz, positionConstant.w, ambientLinear.w, diffuseQuadratic.w,
+                      ambientLinear.xyz, diffuseQuadratic.xyz, specular.xyz);
+}
+
+// index of the cluster a world space position fell in when the lights were binned: with the view of the frame start,
+// the Camera block may hold a newer one (late latch). Positions that turned into view since fall in the edge clusters
+int clusterIndex(vec3 worldPos)
+{
+    vec4 binnedPos = clusterView * vec4(worldPos, 1.0);
+    vec4 clip = projection * binnedPos;
+    vec2 ndc = clip.xy / max(clip.w, 1e-6);
+    ivec2 tile = clamp(ivec2(floor((ndc * 0.5 + 0.5) * vec2(CLUSTER_TILES_X, CLUSTER_TILES_Y))), ivec2(0), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+    int slice = clamp(int(floor(log(max(-binnedPos.z, 1e-6)) * clusterSliceScaleBias.x + clusterSliceScaleBias.y)), 0, CLUSTER_SLICES - 1);
+    return (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x;
+}
+
+// sums the point lights of the cluster this fragment falls in
+vec3 CalcClusterLights(vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    uvec2 range = texelFetch(clusterGrid, clusterIndex(fragPos)).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        int index = int(texelFetch(clusterLightIndices, int(range.x + i)).r);
+        result += CalcPointLight(fetchPointLight(index), normal, fragPos, viewDir);
+    }
+    return result;
+}
+#endif
@@ -7,15 +7,29 @@ out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 
+// written by CameraBlock right before the draws, with the latest mouse input
+layout(std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 inverseView;
+    vec3 viewPos;
+    vec3 spotLightPosition; // the flashlight follows the camera
+    vec3 spotLightDirection;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3 normalMatrix; // transpose(inverse(mat3(model))), computed on the CPU once per object
+
+// depth_prepass.vs lays down depth with the same computation, shading then tests with GL_EQUAL
+invariant gl_Position;
 
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    Normal = normalMatrix * aNormal;
     TexCoords = aTexCoords;
     
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    vec4 viewSpacePos = view * vec4(FragPos, 1.0);
+    gl_Position = projection * viewSpacePos;
 }
\ No newline at end of file
@@ -0,0 +1,181 @@
+#version 330 core
+out vec4 FragColor;
+
+// the light types of 6.multiple_lights.fs
+struct DirLight {
+    vec3 direction;
+	
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+    
+    float constant;
+    float linear;
+    float quadratic;
+	
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct SpotLight { // position and direction come from the Camera block
+    float cutOff;
+    float outerCutOff;
+  
+    float constant;
+    float linear;
+    float quadratic;
+  
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;       
+};
+
+// what the G-buffer holds for one pixel
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    vec3 albedo;
+    float specular;
+};
+
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gViewDepth;
+uniform mat4 inverseProjection;
+uniform vec2 viewportSize;
+
+// written by CameraBlock right before the draws, with the latest mouse input
+layout(std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 inverseView;
+    vec3 viewPos;
+    vec3 spotLightPosition; // the flashlight follows the camera
+    vec3 spotLightDirection;
+};
+
+uniform float shininess;
+uniform DirLight dirLight;
+uniform bool spotLightOn;
+uniform SpotLight spotLight;
+
+// point lights binned per cluster by LightClusters
+uniform samplerBuffer clusterLights;        // 4 texels per light
+uniform usamplerBuffer clusterGrid;         // (offset, count) into clusterLightIndices per cluster
+uniform usamplerBuffer clusterLightIndices;
+uniform mat4 clusterView;                   // view matrix the lights were binned with
+uniform vec2 clusterSliceScaleBias;         // slice = log(view depth) * x + y
+const int CLUSTER_TILES_X = 16;
+const int CLUSTER_TILES_Y = 9;
+const int CLUSTER_SLICES = 24;
+
+vec3 decodeNormal(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+// world position of the pixel from its view depth, works for perspective and orthographic projections
+vec3 reconstructPosition(vec2 ndc, float viewDepth)
+{
+    vec4 nearPoint = inverseProjection * vec4(ndc, -1.0, 1.0);
+    vec4 farPoint = inverseProjection * vec4(ndc, 1.0, 1.0);
+    vec3 from = nearPoint.xyz / nearPoint.w;
+    vec3 to = farPoint.xyz / farPoint.w;
+    vec3 viewPosition = mix(from, to, (-viewDepth - from.z) / (to.z - from.z));
+    return vec3(inverseView * vec4(viewPosition, 1.0));
+}
+
+vec3 CalcDirLight(DirLight light, Surface surface, vec3 viewDir)
+{
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, surface.normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    return light.ambient * surface.albedo + light.diffuse * diff * surface.albedo + light.specular * spec * surface.specular;
+}
+
+vec3 CalcPointLight(PointLight light, Surface surface, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - surface.position);
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, surface.normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    float distance = length(light.position - surface.position);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    return (light.ambient * surface.albedo + light.diffuse * diff * surface.albedo + light.specular * spec * surface.specular) * attenuation;
+}
+
+vec3 CalcSpotLight(SpotLight light, Surface surface, vec3 viewDir)
+{
+    vec3 lightDir = normalize(spotLightPosition - surface.position);
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, surface.normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    float distance = length(spotLightPosition - surface.position);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float theta = dot(lightDir, normalize(-spotLightDirection));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    return (light.ambient * surface.albedo + light.diffuse * diff * surface.albedo + light.specular * spec * surface.specular) * attenuation * intensity;
+}
+
+PointLight fetchPointLight(int index)
+{
+    vec4 positionConstant = texelFetch(clusterLights, index * 4);
+    vec4 ambientLinear = texelFetch(clusterLights, index * 4 + 1);
+    vec4 diffuseQuadratic = texelFetch(clusterLights, index * 4 + 2);
+    vec4 specular = texelFetch(clusterLights, index * 4 + 3);
+    return PointLight(positionConstant.xyz, positionConstant.w, ambientLinear.w, diffuseQuadratic.w,
+                      ambientLinear.xyz, diffuseQuadratic.xyz, specular.xyz);
+}
+
+// index of the cluster a world space position fell in when the lights were binned: with the view of the frame start,
+// the Camera block may hold a newer one (late latch). Positions that turned into view since fall in the edge clusters
+int clusterIndex(vec3 worldPos)
+{
+    vec4 binnedPos = clusterView * vec4(worldPos, 1.0);
+    vec4 clip = projection * binnedPos;
+    vec2 ndc = clip.xy / max(clip.w, 1e-6);
+    ivec2 tile = clamp(ivec2(floor((ndc * 0.5 + 0.5) * vec2(CLUSTER_TILES_X, CLUSTER_TILES_Y))), ivec2(0), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+    int slice = clamp(int(floor(log(max(-binnedPos.z, 1e-6)) * clusterSliceScaleBias.x + clusterSliceScaleBias.y)), 0, CLUSTER_SLICES - 1);
+    return (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x;
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float viewDepth = texelFetch(gViewDepth, pixel, 0).r;
+    if (viewDepth <= 0.0)
+        discard; // nothing was drawn here, keep the clear colour
+
+    Surface surface;
+    surface.position = reconstructPosition(gl_FragCoord.xy / viewportSize * 2.0 - 1.0, viewDepth);
+    vec4 albedoSpecular = texelFetch(gAlbedoSpecular, pixel, 0);
+    surface.normal = decodeNormal(texelFetch(gNormal, pixel, 0).xy);
+    surface.albedo = albedoSpecular.rgb;
+    surface.specular = albedoSpecular.a;
+    vec3 viewDir = normalize(viewPos - surface.position);
+
+    vec3 result = CalcDirLight(dirLight, surface, viewDir);
+    if (spotLightOn)
+        result += CalcSpotLight(spotLight, surface, viewDir);
+
+    // only the point lights of this pixel's cluster
+    uvec2 range = texelFetch(clusterGrid, clusterIndex(surface.position)).xy;
+    for (uint i = 0u; i < range.y; i++)
+    {
+        int index = int(texelFetch(clusterLightIndices, int(range.x + i)).r);
+        result += CalcPointLight(fetchPointLight(index), surface, viewDir);
+    }
+
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,41 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedoSpecular; // rgb: diffuse colour, a: specular intensity
+layout (location = 1) out vec2 gNormal;         // octahedral normal
+layout (location = 2) out float gViewDepth;     // full float, half precision would band the lighting at a distance
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+};
+
+// permutation define, injected by ShaderPermutations
+#ifndef HAS_SPECULAR_MAP
+#define HAS_SPECULAR_MAP 1
+#endif
+
+in vec3 Normal;
+in vec2 TexCoords;
+in float ViewDepth;
+
+uniform Material material;
+
+// unit vector to two components, the octahedron is unfolded onto [-1, 1]^2
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+}
+
+void main()
+{
+#if HAS_SPECULAR_MAP
+    float specular = texture(material.specular, TexCoords).r;
+#else
+    float specular = 0.0; // no specular map is bound, it would sample as black
+#endif
+    gAlbedoSpecular = vec4(texture(material.diffuse, TexCoords).rgb, specular);
+    gNormal = encodeNormal(normalize(Normal));
+    // view depth is stored instead of read back from the depth buffer, whose layers each map to their own depth slice
+    gViewDepth = ViewDepth;
+}
@@ -0,0 +1,32 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec3 Normal;
+out vec2 TexCoords;
+out float ViewDepth;
+
+// written by CameraBlock right before the draws, with the latest mouse input
+layout(std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 inverseView;
+    vec3 viewPos;
+    vec3 spotLightPosition; // the flashlight follows the camera
+    vec3 spotLightDirection;
+};
+
+uniform mat4 model;
+uniform mat3 normalMatrix; // transpose(inverse(mat3(model))), computed on the CPU once per object
+
+void main()
+{
+    vec4 viewSpacePos = view * model * vec4(aPos, 1.0);
+    Normal = normalMatrix * aNormal;
+    TexCoords = aTexCoords;
+    ViewDepth = -viewSpacePos.z;
+
+    gl_Position = projection * viewSpacePos;
+}
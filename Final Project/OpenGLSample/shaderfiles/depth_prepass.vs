@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// written by CameraBlock right before the draws, with the latest mouse input
+layout(std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 inverseView;
+    vec3 viewPos;
+    vec3 spotLightPosition; // the flashlight follows the camera
+    vec3 spotLightDirection;
+};
+
+uniform mat4 model;
+
+// the shading pass tests depth with GL_EQUAL, so this has to be computed exactly as in 6.multiple_lights.vs
+invariant gl_Position;
+
+void main()
+{
+    vec3 FragPos = vec3(model * vec4(aPos, 1.0));
+    vec4 viewSpacePos = view * vec4(FragPos, 1.0);
+    gl_Position = projection * viewSpacePos;
+}
@@ -0,0 +1,6 @@
+#version 330 core
+
+// only counts samples, colour and depth writes are masked off while the box is drawn
+void main()
+{
+}
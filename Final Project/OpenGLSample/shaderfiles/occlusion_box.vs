@@ -0,0 +1,31 @@
+#version 330 core
+
+// written by CameraBlock right before the draws, the box is tested against depth drawn with the same camera
+layout(std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 inverseView;
+    vec3 viewPos;
+    vec3 spotLightPosition; // the flashlight follows the camera
+    vec3 spotLightDirection;
+};
+
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+
+// the 12 triangles of a box, no vertex buffer; bit 0 of a corner picks max x, bit 1 max y, bit 2 max z
+const int corners[36] = int[36](
+    0, 2, 6, 0, 6, 4,
+    1, 5, 7, 1, 7, 3,
+    0, 4, 5, 0, 5, 1,
+    2, 3, 7, 2, 7, 6,
+    0, 1, 3, 0, 3, 2,
+    4, 6, 7, 4, 7, 5);
+
+void main()
+{
+    int corner = corners[gl_VertexID];
+    vec3 t = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+    gl_Position = projection * view * vec4(mix(boxMin, boxMax, t), 1.0);
+}
@@ -0,0 +1,330 @@
+// STL
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+// Project
+#include "softwareOcclusion.h"
+#include "parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+	// Rows per worker, fewer are not worth a thread
+	const size_t MIN_ROWS_PER_THREAD = 16;
+
+	// Below this many objects threads cost more than they save
+	const size_t MIN_OBJECTS_PER_THREAD = 256;
+
+	// Vertices closer to the eye plane than this (clip space w) are treated as behind the camera
+	const float MIN_W = 1.0e-4f;
+
+	// Largest screen rectangle, in texels of the level it is tested at
+	const int MAX_TEST_TEXELS = 8;
+
+	int levelWidth(int level)
+	{
+		return SoftwareOcclusion::WIDTH >> level;
+	}
+
+	int levelHeight(int level)
+	{
+		return SoftwareOcclusion::HEIGHT >> level;
+	}
+}
+
+bool SoftwareOcclusion::addOccluder(const MeshDraw& mesh, size_t object)
+{
+	Occluder occluder;
+	occluder.object = object;
+	if (!readMeshTriangles(mesh, occluder.positions, occluder.triangles)) {
+		return false;
+	}
+	if (object >= _isOccluder.size()) {
+		_isOccluder.resize(object + 1, 0);
+	}
+	_isOccluder[object] = 1;
+	_occluders.push_back(std::move(occluder));
+	return true;
+}
+
+void SoftwareOcclusion::setDepthRange(size_t object, float nearDepth, float farDepth)
+{
+	if (object >= _depthRanges.size()) {
+		_depthRanges.resize(object + 1, glm::vec2(0.0f, 1.0f));
+	}
+	_depthRanges[object] = glm::vec2(nearDepth, farDepth);
+}
+
+void SoftwareOcclusion::render(const glm::mat4& viewProjection, const TransformTable& transforms)
+{
+	const auto start = std::chrono::steady_clock::now();
+	_viewProjection = viewProjection;
+
+	// set up the triangles in buffer space (pixel centers at +0.5), counter-clockwise on screen
+	_triangles.clear();
+	std::vector<glm::vec4> clip;
+	for (const Occluder& occluder : _occluders)
+	{
+		const glm::mat4 toClip = viewProjection * transforms[occluder.object].model;
+		const glm::vec2 range = occluder.object < _depthRanges.size() ? _depthRanges[occluder.object] : glm::vec2(0.0f, 1.0f);
+		const float depthScale = (range.y - range.x) * 0.5f;
+		const float depthBias = range.x + depthScale;
+		clip.resize(occluder.positions.size());
+		for (size_t i = 0; i < clip.size(); i++) {
+			clip[i] = toClip * glm::vec4(occluder.positions[i], 1.0f);
+		}
+
+		for (size_t i = 0; i + 2 < occluder.triangles.size(); i += 3)
+		{
+			const glm::vec4* vertices[3] = { &clip[occluder.triangles[i]], &clip[occluder.triangles[i + 1]], &clip[occluder.triangles[i + 2]] };
+			// a triangle reaching in front of the near plane would need clipping (the GPU draws less of it), leaving it out only culls less
+			bool clipped = false;
+			for (const glm::vec4* vertex : vertices) {
+				clipped = clipped || vertex->w < MIN_W || vertex->z < -vertex->w;
+			}
+			if (clipped) {
+				continue;
+			}
+
+			ScreenTriangle triangle;
+			for (int v = 0; v < 3; v++)
+			{
+				const float inverseW = 1.0f / vertices[v]->w;
+				triangle.x[v] = (vertices[v]->x * inverseW * 0.5f + 0.5f) * WIDTH;
+				triangle.y[v] = (vertices[v]->y * inverseW * 0.5f + 0.5f) * HEIGHT;
+				triangle.depth[v] = vertices[v]->z * inverseW * depthScale + depthBias;
+			}
+			const float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+			if (area == 0.0f) {
+				continue;
+			}
+			if (area < 0.0f)
+			{
+				std::swap(triangle.x[1], triangle.x[2]);
+				std::swap(triangle.y[1], triangle.y[2]);
+				std::swap(triangle.depth[1], triangle.depth[2]);
+			}
+
+			// pixels whose center is inside, clamped to the buffer
+			triangle.minX = std::max((int)std::ceil(std::min(std::min(triangle.x[0], triangle.x[1]), triangle.x[2]) - 0.5f), 0);
+			triangle.maxX = std::min((int)std::floor(std::max(std::max(triangle.x[0], triangle.x[1]), triangle.x[2]) - 0.5f), WIDTH - 1);
+			triangle.minY = std::max((int)std::ceil(std::min(std::min(triangle.y[0], triangle.y[1]), triangle.y[2]) - 0.5f), 0);
+			triangle.maxY = std::min((int)std::floor(std::max(std::max(triangle.y[0], triangle.y[1]), triangle.y[2]) - 0.5f), HEIGHT - 1);
+			if (triangle.minX <= triangle.maxX && triangle.minY <= triangle.maxY) {
+				_triangles.push_back(triangle);
+			}
+		}
+	}
+
+	// every worker owns a band of rows and rasterises all triangles over it, no two write the same pixel
+	_raster.assign(WIDTH * HEIGHT, 1.0f);
+	parallelFor(HEIGHT, MIN_ROWS_PER_THREAD, [this](size_t begin, size_t end) {
+		rasteriseRows((int)begin, (int)end);
+	});
+
+	// shrunk by a pixel into level 0, rows in bands again
+	_levels[0].resize(WIDTH * HEIGHT);
+	parallelFor(HEIGHT, MIN_ROWS_PER_THREAD, [this](size_t begin, size_t end) {
+		shrinkRows((int)begin, (int)end);
+	});
+
+	// each level up keeps the farthest of the 2x2 texels below it
+	for (int level = 1; level < LEVEL_COUNT; level++)
+	{
+		const std::vector<float>& below = _levels[level - 1];
+		std::vector<float>& depths = _levels[level];
+		const int width = levelWidth(level), height = levelHeight(level), belowWidth = levelWidth(level - 1);
+		depths.resize(width * height);
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				const float* texels = &below[(2 * y) * belowWidth + 2 * x];
+				depths[y * width + x] = std::max(std::max(texels[0], texels[1]), std::max(texels[belowWidth], texels[belowWidth + 1]));
+			}
+		}
+	}
+	_lastRenderMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void SoftwareOcclusion::rasteriseRows(int firstRow, int endRow)
+{
+	float* depths = _raster.data();
+	for (const ScreenTriangle& triangle : _triangles)
+	{
+		const int minY = std::max(triangle.minY, firstRow);
+		const int maxY = std::min(triangle.maxY, endRow - 1);
+		if (minY > maxY) {
+			continue;
+		}
+
+		// edge functions of the edges opposite each vertex, E(x, y) = a * x + b * y + c, positive inside;
+		// divided by the area they are the barycentric weights of that vertex
+		const float* x = triangle.x;
+		const float* y = triangle.y;
+		float a[3], b[3], c[3];
+		for (int v = 0; v < 3; v++)
+		{
+			const int from = (v + 1) % 3, to = (v + 2) % 3;
+			a[v] = y[from] - y[to];
+			b[v] = x[to] - x[from];
+			c[v] = x[from] * y[to] - x[to] * y[from];
+		}
+		const float inverseArea = 1.0f / (c[0] + c[1] + c[2]);
+		// depth is linear in screen space: depth(x, y) = depthX * x + depthY * y + depth0
+		const float depthX = (a[0] * triangle.depth[0] + a[1] * triangle.depth[1] + a[2] * triangle.depth[2]) * inverseArea;
+		const float depthY = (b[0] * triangle.depth[0] + b[1] * triangle.depth[1] + b[2] * triangle.depth[2]) * inverseArea;
+		const float depth0 = (c[0] * triangle.depth[0] + c[1] * triangle.depth[1] + c[2] * triangle.depth[2]) * inverseArea;
+
+		// four pixels at a time from a multiple of four, the buffer width is one too
+		const int firstX = triangle.minX & ~3;
+		for (int row = minY; row <= maxY; row++)
+		{
+			const float centerY = row + 0.5f;
+			float* line = depths + row * WIDTH;
+#ifdef OCCLUSION_USE_SSE2
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+			const __m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]);
+			const __m128 rowEdge0 = _mm_set1_ps(b[0] * centerY + c[0]);
+			const __m128 rowEdge1 = _mm_set1_ps(b[1] * centerY + c[1]);
+			const __m128 rowEdge2 = _mm_set1_ps(b[2] * centerY + c[2]);
+			const __m128 slope = _mm_set1_ps(depthX);
+			const __m128 rowDepth = _mm_set1_ps(depthY * centerY + depth0);
+			for (int column = firstX; column <= triangle.maxX; column += 4)
+			{
+				const __m128 centerX = _mm_add_ps(_mm_set1_ps((float)column), laneOffsets);
+				const __m128 edge0 = _mm_add_ps(_mm_mul_ps(a0, centerX), rowEdge0);
+				const __m128 edge1 = _mm_add_ps(_mm_mul_ps(a1, centerX), rowEdge1);
+				const __m128 edge2 = _mm_add_ps(_mm_mul_ps(a2, centerX), rowEdge2);
+				const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, zero), _mm_cmpge_ps(edge1, zero)), _mm_cmpge_ps(edge2, zero));
+				if (_mm_movemask_ps(inside) == 0) {
+					continue;
+				}
+				const __m128 depth = _mm_add_ps(_mm_mul_ps(slope, centerX), rowDepth);
+				const __m128 stored = _mm_loadu_ps(line + column);
+				const __m128 nearer = _mm_min_ps(stored, depth);
+				_mm_storeu_ps(line + column, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, stored)));
+			}
+#else
+			for (int column = firstX; column <= triangle.maxX; column++)
+			{
+				const float centerX = column + 0.5f;
+				if (a[0] * centerX + b[0] * centerY + c[0] >= 0.0f && a[1] * centerX + b[1] * centerY + c[1] >= 0.0f && a[2] * centerX + b[2] * centerY + c[2] >= 0.0f) {
+					line[column] = std::min(line[column], depthX * centerX + depthY * centerY + depth0);
+				}
+			}
+#endif
+		}
+	}
+}
+
+void SoftwareOcclusion::shrinkRows(int firstRow, int endRow)
+{
+	// the farthest of the 3x3 pixel centers around a texel: where all nine are covered, so is the texel (the centers
+	// surround it), and a plane is no farther inside the texel than at the corners of the 3x3 centers.
+	// Pixels past the buffer edge repeat the edge, nothing outside is drawn anyway
+	const float* raster = _raster.data();
+	float* depths = _levels[0].data();
+	float columnMax[WIDTH];
+	for (int row = firstRow; row < endRow; row++)
+	{
+		const float* above = raster + std::max(row - 1, 0) * WIDTH;
+		const float* line = raster + row * WIDTH;
+		const float* below = raster + std::min(row + 1, HEIGHT - 1) * WIDTH;
+		for (int x = 0; x < WIDTH; x++) {
+			columnMax[x] = std::max(std::max(above[x], line[x]), below[x]);
+		}
+		float* out = depths + row * WIDTH;
+		out[0] = std::max(columnMax[0], columnMax[1]);
+		for (int x = 1; x < WIDTH - 1; x++) {
+			out[x] = std::max(std::max(columnMax[x - 1], columnMax[x]), columnMax[x + 1]);
+		}
+		out[WIDTH - 1] = std::max(columnMax[WIDTH - 2], columnMax[WIDTH - 1]);
+	}
+}
+
+bool SoftwareOcclusion::isVisible(const glm::vec3& boxMin, const glm::vec3& boxMax, float nearDepth, float farDepth) const
+{
+	if (_levels[0].empty()) {
+		return true;
+	}
+
+	// screen rectangle and nearest depth (in NDC, then window depth) of the box's corners
+	float minX = (float)WIDTH, maxX = 0.0f, minY = (float)HEIGHT, maxY = 0.0f, nearest = 1.0f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		const glm::vec4 point((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y, (corner & 4) ? boxMax.z : boxMin.z, 1.0f);
+		const glm::vec4 clip = _viewProjection * point;
+		// reaching behind the camera, the box covers the eye plane and can't be hidden
+		if (clip.w < MIN_W) {
+			return true;
+		}
+		const float inverseW = 1.0f / clip.w;
+		const float x = (clip.x * inverseW * 0.5f + 0.5f) * WIDTH;
+		const float y = (clip.y * inverseW * 0.5f + 0.5f) * HEIGHT;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.z * inverseW);
+	}
+	nearest = nearDepth + (farDepth - nearDepth) * (nearest * 0.5f + 0.5f);
+	if (maxX < 0.0f || minY > HEIGHT || maxY < 0.0f || minX > WIDTH) {
+		return true;
+	}
+
+	// the lowest level where the rectangle spans a few texels
+	const int x0 = std::max((int)minX, 0), x1 = std::min((int)maxX, WIDTH - 1);
+	const int y0 = std::max((int)minY, 0), y1 = std::min((int)maxY, HEIGHT - 1);
+	int level = 0;
+	while (level + 1 < LEVEL_COUNT && std::max((x1 >> level) - (x0 >> level), (y1 >> level) - (y0 >> level)) >= MAX_TEST_TEXELS) {
+		level++;
+	}
+
+	const std::vector<float>& depths = _levels[level];
+	const int width = levelWidth(level);
+	for (int y = y0 >> level; y <= y1 >> level; y++)
+	{
+		for (int x = x0 >> level; x <= x1 >> level; x++)
+		{
+			if (nearest <= depths[y * width + x]) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+size_t SoftwareOcclusion::cull(const TransformTable& transforms, std::vector<char>& visible) const
+{
+	std::atomic<size_t> hidden(0);
+	parallelFor(transforms.size(), MIN_OBJECTS_PER_THREAD, [&](size_t begin, size_t end) {
+		size_t rangeHidden = 0;
+		for (size_t object = begin; object < end; object++)
+		{
+			if (!visible[object] || (object < _isOccluder.size() && _isOccluder[object])) {
+				continue;
+			}
+			const glm::vec2 range = object < _depthRanges.size() ? _depthRanges[object] : glm::vec2(0.0f, 1.0f);
+			if (!isVisible(transforms[object].boundsMin, transforms[object].boundsMax, range.x, range.y))
+			{
+				visible[object] = 0;
+				rangeHidden++;
+			}
+		}
+		hidden += rangeHidden;
+	});
+	return hidden;
+}
+
+double SoftwareOcclusion::lastRenderMilliseconds() const
+{
+	return _lastRenderMilliseconds;
+}
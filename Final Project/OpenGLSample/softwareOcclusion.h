@@ -0,0 +1,100 @@
+#pragma once
+
+// STL
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Project
+#include "meshDraw.h"
+#include "transformTable.h"
+
+/**
+  Occlusion culling on the CPU. A few large occluder meshes are rasterised into a low resolution
+  depth buffer, with SSE2 four pixels at a time and the rows split across worker threads; a
+  max-depth pyramid is built over it. An object is hidden when the nearest point of its box is
+  behind the farthest occluder depth everywhere its screen rectangle covers, which takes a
+  handful of reads at the pyramid level matching the rectangle's size. No GPU work, so it works
+  the same on software OpenGL.
+  Depths are window depths, so that objects drawn in their own slice of the depth range (see
+  RenderLayers) are compared the way the GPU will compare them.
+  Occluders are sampled at pixel centers, then shrunk by a pixel: a texel keeps the farthest depth
+  of the 3x3 pixels around it, so it is only covered where the occluders cover it entirely, never
+  nearer than they are anywhere inside it. Occluders thus hide a little less than they do on
+  screen, not more. Triangles reaching in front of the near plane are left out, the GPU clips them.
+*/
+class SoftwareOcclusion
+{
+public:
+	static const int WIDTH = 256;
+	static const int HEIGHT = 128;
+
+	/** \brief Registers an occluder. Its triangles are read back from the buffers of its vertex array once.
+	*   \param mesh   How the mesh is drawn, vertex attribute 0 has to hold 3 float positions
+	*   \param object Index of the object in the TransformTable, for its model matrix
+	*   \return True if the mesh has been read or false otherwise.
+	*/
+	bool addOccluder(const MeshDraw& mesh, size_t object);
+
+	/** \brief Sets the window depth range an object is drawn with, [0, 1] unless set.
+	*   \param object    Index of the object in the TransformTable
+	*   \param nearDepth Depth the near plane maps to
+	*   \param farDepth  Depth the far plane maps to
+	*/
+	void setDepthRange(size_t object, float nearDepth, float farDepth);
+
+	/** \brief Rasterises the occluders for a view and builds the depth pyramid.
+	*   \param viewProjection projection * view
+	*   \param transforms     Transforms of the objects, for the occluders' model matrices
+	*/
+	void render(const glm::mat4& viewProjection, const TransformTable& transforms);
+
+	/** \brief Tests a world space box against the last render().
+	*   \param boxMin    Lowest corner
+	*   \param boxMax    Highest corner
+	*   \param nearDepth Window depth the near plane maps to for this box
+	*   \param farDepth  Window depth the far plane maps to for this box
+	*   \return False if the box is certainly hidden behind the occluders.
+	*/
+	bool isVisible(const glm::vec3& boxMin, const glm::vec3& boxMax, float nearDepth = 0.0f, float farDepth = 1.0f) const;
+
+	/** \brief Clears the visible flag of objects hidden behind the occluders. Occluders themselves are not tested.
+	*   \param transforms Transforms of the objects, for their world space boxes
+	*   \param visible    Per object, 1 for the objects to test (e.g. after frustum culling)
+	*   \return Number of objects found hidden.
+	*/
+	size_t cull(const TransformTable& transforms, std::vector<char>& visible) const;
+
+	/** \brief Gets how long the last render() took on the CPU, in milliseconds. */
+	double lastRenderMilliseconds() const;
+
+private:
+	static const int LEVEL_COUNT = 8;
+
+	struct Occluder
+	{
+		size_t object;
+		std::vector<glm::vec3> positions;
+		std::vector<GLuint> triangles;
+	};
+
+	// a triangle in buffer space, set up for rasterisation
+	struct ScreenTriangle
+	{
+		float x[3], y[3], depth[3];
+		int minX, maxX, minY, maxY;
+	};
+
+	void rasteriseRows(int firstRow, int endRow);
+	void shrinkRows(int firstRow, int endRow);
+
+	std::vector<Occluder> _occluders;
+	std::vector<char> _isOccluder; //! Per object
+	std::vector<glm::vec2> _depthRanges; //! Per object, window depth of the near and far planes
+	std::vector<ScreenTriangle> _triangles; //! Of the current render()
+	std::vector<float> _raster; //! WIDTH x HEIGHT depths sampled at pixel centers, before shrinking into level 0
+	std::vector<float> _levels[LEVEL_COUNT]; //! Depth pyramid, level 0 is WIDTH x HEIGHT, farthest depth of 2x2 texels per level up
+	glm::mat4 _viewProjection = glm::mat4(1.0f);
+	double _lastRenderMilliseconds = 0.0;
+};
@@ -1,7 +1,8 @@
 // GLM
 
 // Project
-#include "common/staticMesh3D.h"
+#include "staticMesh3D.h"
+#include "resourceTracker.h"
 #include <glm/glm.hpp>
 
 
@@ -27,7 +28,7 @@ void StaticMesh3D::deleteMesh()
         return;
     }
 
-    glDeleteVertexArrays(1, &_vao);
+    trackedDeleteVertexArrays(1, &_vao);
     _vbo.deleteVBO();
 
     _isInitialized = false;
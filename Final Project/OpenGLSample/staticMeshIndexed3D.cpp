@@ -1,5 +1,5 @@
 // Project
-#include "common/staticMeshIndexed3D.h"
+#include "staticMeshIndexed3D.h"
 
 namespace static_meshes_3D {
 
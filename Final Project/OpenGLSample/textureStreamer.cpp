@@ -0,0 +1,353 @@
+// STL
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// Project
+#include "textureStreamer.h"
+#include "mipGenerator.h"
+#include "stb_image.h"
+#include "resourceTracker.h"
+
+// S3TC is an extension, so glad (core profile, no extensions) doesn't define these
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+#define FOURCC_DXT1 0x31545844 // Equivalent to "DXT1" in ASCII
+#define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
+#define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
+#define DDPF_FOURCC 0x4
+#define DDPF_RGB    0x40
+
+namespace {
+
+	unsigned int readU32(const unsigned char* p)
+	{
+		return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+	}
+
+} // namespace
+
+TextureStreamer::TextureStreamer()
+{
+	_worker = std::thread(&TextureStreamer::workerLoop, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_wakeWorker.notify_one();
+	_worker.join();
+}
+
+GLuint TextureStreamer::load(const char* path)
+{
+	GLuint textureID;
+	trackedGenTextures(1, &textureID);
+
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_requests.push_back({ textureID, path });
+		_texturesInFlight++;
+	}
+	_wakeWorker.notify_one();
+
+	return textureID;
+}
+
+void TextureStreamer::update(size_t uploadBudgetBytes)
+{
+	size_t bytesUploaded = 0;
+	while (true)
+	{
+		MipLevel level;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_readyLevels.empty()) {
+				break;
+			}
+
+			// Always make progress, even if a single level is bigger than the whole budget
+			const auto levelSize = _readyLevels.front().data.size();
+			if (bytesUploaded > 0 && bytesUploaded + levelSize > uploadBudgetBytes) {
+				break;
+			}
+
+			level = std::move(_readyLevels.front());
+			_readyLevels.pop_front();
+		}
+
+		uploadLevel(level);
+		bytesUploaded += level.data.size();
+		trackCpuMemory("texture levels waiting for upload", -(ptrdiff_t)level.data.size());
+
+		if (level.level == 0)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_texturesInFlight--;
+		}
+	}
+}
+
+bool TextureStreamer::isIdle()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _texturesInFlight == 0;
+}
+
+void TextureStreamer::finish()
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_levelReady.wait(lock, [this] { return !_readyLevels.empty() || _texturesInFlight == 0; });
+			if (_readyLevels.empty()) {
+				return;
+			}
+		}
+		update(SIZE_MAX);
+	}
+}
+
+void TextureStreamer::workerLoop()
+{
+	stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis
+
+	while (true)
+	{
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wakeWorker.wait(lock, [this] { return _quit || !_requests.empty(); });
+			if (_quit) {
+				return;
+			}
+
+			request = std::move(_requests.front());
+			_requests.pop_front();
+		}
+
+		const auto extension = request.path.substr(request.path.find_last_of('.') + 1);
+		const bool isDDS = extension == "dds" || extension == "DDS";
+		if (!(isDDS ? streamDDS(request) : streamImage(request)))
+		{
+			std::cout << "Texture failed to load at path: " << request.path << std::endl;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_texturesInFlight--;
+			}
+			_levelReady.notify_all();
+		}
+	}
+}
+
+bool TextureStreamer::streamDDS(const Request& request)
+{
+	FILE* fp = fopen(request.path.c_str(), "rb");
+	if (fp == NULL) {
+		return false;
+	}
+
+	// verify the type of file and get the surface desc
+	char filecode[4];
+	unsigned char header[124];
+	if (fread(filecode, 1, 4, fp) != 4 || strncmp(filecode, "DDS ", 4) != 0 || fread(header, 124, 1, fp) != 1)
+	{
+		fclose(fp);
+		return false;
+	}
+
+	const int height = (int)readU32(&header[8]);
+	const int width = (int)readU32(&header[12]);
+	const int mipMapCount = std::max((int)readU32(&header[24]), 1);
+	const unsigned int pixelFlags = readU32(&header[76]);
+	const unsigned int fourCC = readU32(&header[80]);
+	const unsigned int bitCount = readU32(&header[84]);
+	const unsigned int redMask = readU32(&header[88]);
+
+	GLenum internalFormat = 0;
+	GLenum format = 0;
+	unsigned int blockSize = 0; // compressed block size in bytes, 0 for uncompressed data
+	unsigned int bytesPerPixel = 0;
+	if (pixelFlags & DDPF_FOURCC)
+	{
+		switch (fourCC)
+		{
+		case FOURCC_DXT1: internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; blockSize = 8; break;
+		case FOURCC_DXT3: internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; blockSize = 16; break;
+		case FOURCC_DXT5: internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; blockSize = 16; break;
+		default: break;
+		}
+	}
+	else if ((pixelFlags & DDPF_RGB) && (bitCount == 24 || bitCount == 32))
+	{
+		// baked chains are written as plain RGB(A), but accept the usual BGR(A) layout too
+		bytesPerPixel = bitCount / 8;
+		internalFormat = bytesPerPixel == 4 ? GL_RGBA8 : GL_RGB8;
+		if (redMask == 0x000000ff) {
+			format = bytesPerPixel == 4 ? GL_RGBA : GL_RGB;
+		}
+		else {
+			format = bytesPerPixel == 4 ? GL_BGRA : GL_BGR;
+		}
+	}
+
+	if (internalFormat == 0)
+	{
+		fclose(fp);
+		return false;
+	}
+
+	// Work out where every level lives in the file, so that the tail can be read first
+	std::vector<long> offsets(mipMapCount);
+	std::vector<size_t> sizes(mipMapCount);
+	long offset = 4 + 124;
+	for (int level = 0; level < mipMapCount; level++)
+	{
+		const int levelWidth = std::max(width >> level, 1);
+		const int levelHeight = std::max(height >> level, 1);
+		sizes[level] = blockSize > 0
+			? (size_t)((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockSize
+			: (size_t)levelWidth * levelHeight * bytesPerPixel;
+		offsets[level] = offset;
+		offset += (long)sizes[level];
+	}
+
+	for (int level = mipMapCount - 1; level >= 0; level--)
+	{
+		MipLevel mip;
+		mip.textureID = request.textureID;
+		mip.level = level;
+		mip.isFirst = level == mipMapCount - 1;
+		mip.width = std::max(width >> level, 1);
+		mip.height = std::max(height >> level, 1);
+		mip.internalFormat = internalFormat;
+		mip.format = format;
+		mip.data.resize(sizes[level]);
+
+		if (fseek(fp, offsets[level], SEEK_SET) != 0 || fread(mip.data.data(), 1, sizes[level], fp) != sizes[level])
+		{
+			fclose(fp);
+			// Levels already published stay valid, just stop streaming this texture
+			if (!mip.isFirst)
+			{
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					_texturesInFlight--;
+				}
+				_levelReady.notify_all();
+				return true;
+			}
+			return false;
+		}
+
+		publish(std::move(mip));
+	}
+
+	fclose(fp);
+	return true;
+}
+
+bool TextureStreamer::streamImage(const Request& request)
+{
+	int width, height, nrComponents;
+	unsigned char* data = stbi_load(request.path.c_str(), &width, &height, &nrComponents, 0);
+	if (!data) {
+		return false;
+	}
+
+	GLenum format = GL_RGBA;
+	GLenum internalFormat = GL_RGBA8;
+	if (nrComponents == 1)
+	{
+		format = GL_RED;
+		internalFormat = GL_R8;
+	}
+	else if (nrComponents == 2)
+	{
+		format = GL_RG;
+		internalFormat = GL_RG8;
+	}
+	else if (nrComponents == 3)
+	{
+		format = GL_RGB;
+		internalFormat = GL_RGB8;
+	}
+
+	// Build the whole chain on this thread (colour images are filtered in linear space), then hand it over smallest level first
+	MipImage base;
+	base.width = width;
+	base.height = height;
+	base.channels = nrComponents;
+	base.pixels.assign(data, data + (size_t)width * height * nrComponents);
+	stbi_image_free(data);
+
+	auto levels = generateMipChain(std::move(base), nrComponents >= 3);
+	const int numLevels = (int)levels.size();
+
+	for (int level = numLevels - 1; level >= 0; level--)
+	{
+		MipLevel mip;
+		mip.textureID = request.textureID;
+		mip.level = level;
+		mip.isFirst = level == numLevels - 1;
+		mip.width = std::max(width >> level, 1);
+		mip.height = std::max(height >> level, 1);
+		mip.internalFormat = internalFormat;
+		mip.format = format;
+		mip.data = std::move(levels[level].pixels);
+		publish(std::move(mip));
+	}
+
+	return true;
+}
+
+void TextureStreamer::publish(MipLevel&& level)
+{
+	trackCpuMemory("texture levels waiting for upload", (ptrdiff_t)level.data.size());
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_readyLevels.push_back(std::move(level));
+	}
+	_levelReady.notify_all();
+}
+
+void TextureStreamer::uploadLevel(const MipLevel& level)
+{
+	glBindTexture(GL_TEXTURE_2D, level.textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	if (level.format == 0)
+	{
+		trackedCompressedTexImage2D(GL_TEXTURE_2D, level.level, level.internalFormat, level.width, level.height,
+			0, (GLsizei)level.data.size(), level.data.data());
+	}
+	else {
+		trackedTexImage2D(GL_TEXTURE_2D, level.level, level.internalFormat, level.width, level.height,
+			0, level.format, GL_UNSIGNED_BYTE, level.data.data());
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// Only levels [BASE_LEVEL, MAX_LEVEL] count for completeness, so the texture is
+	// complete (and sampled at the best resolution uploaded so far) after every level
+	if (level.isFirst) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level.level);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level.level);
+}
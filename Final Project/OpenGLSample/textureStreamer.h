@@ -0,0 +1,78 @@
+#pragma once
+
+// STL
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+
+/**
+  Streams textures to the GPU smallest mip level first. Files are read and decoded on a
+  worker thread, the render thread uploads finished levels under a per-frame byte budget
+  and lowers GL_TEXTURE_BASE_LEVEL as every larger level lands. A texture is therefore
+  usable (at reduced resolution) as soon as its mip tail is resident, and the time to
+  the first frame does not depend on texture size.
+*/
+class TextureStreamer
+{
+public:
+	TextureStreamer();
+	~TextureStreamer();
+
+	/** \brief Creates the texture object and queues the file for streaming. Returns immediately.
+	*   \param path DDS file with a baked mip chain (read tail first), or any image stb_image can decode
+	*   \return OpenGL texture ID, it samples as black until its first (smallest) level is uploaded
+	*/
+	GLuint load(const char* path);
+
+	/** \brief Uploads ready mip levels until the budget is spent. Must be called on the GL thread, once per frame.
+	*   \param uploadBudgetBytes Maximum number of bytes to upload (at least one level is always uploaded)
+	*/
+	void update(size_t uploadBudgetBytes);
+
+	/** \brief Checks, if every queued texture is fully resident.
+	*   \return True if there is nothing left to stream or false otherwise.
+	*/
+	bool isIdle();
+
+	//* \brief Blocks until every queued texture is fully resident (ignores upload budget).
+	void finish();
+
+private:
+	struct Request
+	{
+		GLuint textureID;
+		std::string path;
+	};
+
+	struct MipLevel
+	{
+		GLuint textureID;
+		int level; //!< Mip level index, levels of one texture arrive in decreasing order
+		bool isFirst; //!< True for the first (smallest) level published for the texture
+		int width;
+		int height;
+		GLenum internalFormat;
+		GLenum format; //!< Pixel format for uncompressed data, 0 for compressed data
+		std::vector<unsigned char> data;
+	};
+
+	void workerLoop();
+	bool streamDDS(const Request& request);
+	bool streamImage(const Request& request);
+	void publish(MipLevel&& level);
+	void uploadLevel(const MipLevel& level);
+
+	std::thread _worker;
+	std::mutex _mutex;
+	std::condition_variable _wakeWorker; //! Signalled when a request is queued or on shutdown
+	std::condition_variable _levelReady; //! Signalled when a level is published or a texture fails
+	std::deque<Request> _requests; //! Files waiting to be read by the worker
+	std::deque<MipLevel> _readyLevels; //! Levels read / decoded, waiting for upload
+	int _texturesInFlight = 0; //! Textures queued but not fully uploaded yet
+	bool _quit = false;
+};
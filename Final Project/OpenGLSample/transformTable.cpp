@@ -0,0 +1,133 @@
+// STL
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+
+// Project
+#include "transformTable.h"
+#include "parallel.h"
+
+namespace {
+
+	// Below this many objects threads cost more than they save
+	const size_t MIN_OBJECTS_PER_THREAD = 1024;
+
+	// transpose(inverse(m)) of the upper 3x3: the cofactor matrix divided by the determinant
+	glm::mat3 normalMatrix(const glm::mat4& m)
+	{
+		const float a00 = m[0][0], a01 = m[0][1], a02 = m[0][2];
+		const float a10 = m[1][0], a11 = m[1][1], a12 = m[1][2];
+		const float a20 = m[2][0], a21 = m[2][1], a22 = m[2][2];
+
+		glm::mat3 cofactors;
+		cofactors[0][0] = a11 * a22 - a12 * a21;
+		cofactors[0][1] = a12 * a20 - a10 * a22;
+		cofactors[0][2] = a10 * a21 - a11 * a20;
+		cofactors[1][0] = a02 * a21 - a01 * a22;
+		cofactors[1][1] = a00 * a22 - a02 * a20;
+		cofactors[1][2] = a01 * a20 - a00 * a21;
+		cofactors[2][0] = a01 * a12 - a02 * a11;
+		cofactors[2][1] = a02 * a10 - a00 * a12;
+		cofactors[2][2] = a00 * a11 - a01 * a10;
+
+		// a singular model (zero scale) keeps the cofactors, the shader normalizes anyway
+		const float determinant = a00 * cofactors[0][0] + a01 * cofactors[0][1] + a02 * cofactors[0][2];
+		const float scale = determinant != 0.0f ? 1.0f / determinant : 1.0f;
+		for (int column = 0; column < 3; column++) {
+			cofactors[column] *= scale;
+		}
+		return cofactors;
+	}
+
+	float maxScale(const glm::mat4& m)
+	{
+		const float x = m[0][0] * m[0][0] + m[0][1] * m[0][1] + m[0][2] * m[0][2];
+		const float y = m[1][0] * m[1][0] + m[1][1] * m[1][1] + m[1][2] * m[1][2];
+		const float z = m[2][0] * m[2][0] + m[2][1] * m[2][1] + m[2][2] * m[2][2];
+		return std::sqrt(std::max(x, std::max(y, z)));
+	}
+}
+
+size_t TransformTable::add(const glm::mat4& model, const LocalBounds& bounds)
+{
+	ObjectTransform object;
+	object.model = model;
+	_objects.push_back(object);
+	_localBounds.push_back(bounds);
+	_isDirty.push_back(0);
+
+	const size_t padded = (_objects.size() + WorldBoxes::WIDTH - 1) / WorldBoxes::WIDTH * WorldBoxes::WIDTH;
+	for (std::vector<float>* axis : { &_worldBoxes.centerX, &_worldBoxes.centerY, &_worldBoxes.centerZ, &_worldBoxes.extentX, &_worldBoxes.extentY, &_worldBoxes.extentZ }) {
+		axis->resize(padded, 0.0f);
+	}
+
+	const size_t index = _objects.size() - 1;
+	setModel(index, model);
+	return index;
+}
+
+void TransformTable::setModel(size_t index, const glm::mat4& model)
+{
+	_objects[index].model = model;
+	if (!_isDirty[index])
+	{
+		_isDirty[index] = 1;
+		_dirty.push_back(index);
+	}
+}
+
+void TransformTable::update()
+{
+	if (_dirty.empty()) {
+		return;
+	}
+
+	parallelFor(_dirty.size(), MIN_OBJECTS_PER_THREAD, [this](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			const size_t index = _dirty[i];
+			ObjectTransform& object = _objects[index];
+			const LocalBounds& bounds = _localBounds[index];
+			object.normalMatrix = normalMatrix(object.model);
+			object.center = glm::vec3(object.model * glm::vec4(bounds.center, 1.0f));
+			object.radius = bounds.radius * maxScale(object.model);
+
+			// the box around the transformed box: the half extent on each world axis is |M| times the local one
+			const glm::vec3 localCenter = (bounds.min + bounds.max) * 0.5f;
+			const glm::vec3 localExtent = (bounds.max - bounds.min) * 0.5f;
+			const glm::vec3 center = glm::vec3(object.model * glm::vec4(localCenter, 1.0f));
+			glm::vec3 extent(0.0f);
+			for (int column = 0; column < 3; column++)
+			{
+				for (int row = 0; row < 3; row++) {
+					extent[row] += std::abs(object.model[column][row]) * localExtent[column];
+				}
+			}
+			object.boundsMin = center - extent;
+			object.boundsMax = center + extent;
+			_worldBoxes.centerX[index] = center.x;
+			_worldBoxes.centerY[index] = center.y;
+			_worldBoxes.centerZ[index] = center.z;
+			_worldBoxes.extentX[index] = extent.x;
+			_worldBoxes.extentY[index] = extent.y;
+			_worldBoxes.extentZ[index] = extent.z;
+			_isDirty[index] = 0;
+		}
+	});
+	_dirty.clear();
+}
+
+const ObjectTransform& TransformTable::operator[](size_t index) const
+{
+	return _objects[index];
+}
+
+size_t TransformTable::size() const
+{
+	return _objects.size();
+}
+
+const WorldBoxes& TransformTable::worldBoxes() const
+{
+	return _worldBoxes;
+}
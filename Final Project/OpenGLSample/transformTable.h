@@ -0,0 +1,76 @@
+#pragma once
+
+// STL
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Project
+#include "bounds.h"
+
+struct ObjectTransform
+{
+	glm::mat4 model;
+	glm::mat3 normalMatrix; //!< transpose(inverse(mat3(model))), transforms normals to world space
+	glm::vec3 center; //!< World space bounding sphere
+	float radius;
+	glm::vec3 boundsMin; //!< World space axis aligned box
+	glm::vec3 boundsMax;
+};
+
+/**
+  World space boxes of all objects as structure of arrays (center and half extent, one array
+  per axis), so that culling loads the same coordinate of four objects at once. The arrays are
+  padded with empty boxes to a multiple of WIDTH.
+*/
+struct WorldBoxes
+{
+	static const size_t WIDTH = 4;
+
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+};
+
+/**
+  World transforms of the objects in the scene and the data derived from them. Everything that
+  depends on the model matrix (normal matrix, world space bounds) is recomputed in one batch in
+  update() for the objects that changed, instead of per vertex on the GPU or per draw.
+*/
+class TransformTable
+{
+public:
+	/** \brief Adds an object. Its derived data is valid after the next update().
+	*   \param model  Model (local to world) matrix
+	*   \param bounds Bounds of its mesh in local space
+	*   \return Index of the object.
+	*/
+	size_t add(const glm::mat4& model, const LocalBounds& bounds);
+
+	/** \brief Moves an object. Its derived data is valid after the next update().
+	*   \param index Index returned by add()
+	*   \param model New model matrix
+	*/
+	void setModel(size_t index, const glm::mat4& model);
+
+	//* \brief Recomputes normal matrices and bounds of every object added or moved since the last call.
+	void update();
+
+	/** \brief Gets an object's transform.
+	*   \param index Index returned by add()
+	*/
+	const ObjectTransform& operator[](size_t index) const;
+
+	/** \brief Gets number of objects. */
+	size_t size() const;
+
+	//* \brief Gets the world space boxes of all objects, for culling. Valid after update().
+	const WorldBoxes& worldBoxes() const;
+
+private:
+	std::vector<ObjectTransform> _objects;
+	std::vector<LocalBounds> _localBounds;
+	WorldBoxes _worldBoxes;
+	std::vector<size_t> _dirty; //! Objects added or moved since the last update()
+	std::vector<char> _isDirty;
+};
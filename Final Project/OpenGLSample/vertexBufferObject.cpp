@@ -2,10 +2,44 @@
 #include <iostream>
 #include <cstring>
 
+#include <GLFW/glfw3.h>
+
 // Project
-#include "common/vertexBufferObject.h"
+#include "vertextBufferObject.h"
+#include "resourceTracker.h"
+
+// ARB_buffer_storage (core in 4.4), not in our glad
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT   0x0080
+#endif
+
+namespace {
 
-void VertexBufferObject::createVBO(size_t reserveSizeBytes)
+    typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+    // Returns glBufferStorage, or nullptr if the context has no ARB_buffer_storage
+    PFNGLBUFFERSTORAGEPROC bufferStorage()
+    {
+        static const PFNGLBUFFERSTORAGEPROC function = []() -> PFNGLBUFFERSTORAGEPROC {
+            if (!glfwExtensionSupported("GL_ARB_buffer_storage")) {
+                return nullptr;
+            }
+            return (PFNGLBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+        }();
+        return function;
+    }
+
+    void waitForFence(GLsync fence)
+    {
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        while (result == GL_TIMEOUT_EXPIRED) {
+            result = glClientWaitSync(fence, 0, 1000000);
+        }
+    }
+}
+
+void VertexBufferObject::createVBO(size_t reserveSizeBytes, const char* site)
 {
     if (_isBufferCreated)
     {
@@ -13,17 +47,17 @@ void VertexBufferObject::createVBO(size_t reserveSizeBytes)
         return;
     }
 
-    glGenBuffers(1, &_bufferID);
-    _rawData.reserve(reserveSizeBytes > 0 ? reserveSizeBytes : 1024);
+    trackGenBuffers(1, &_bufferID, site != nullptr ? site : RESOURCE_SITE);
+    _arena = &Arena::threadArena();
+    _arenaMark = _arena->mark();
+    _rawDataCapacity = reserveSizeBytes > 0 ? reserveSizeBytes : 1024;
+    _rawData = _arena->allocateArray<unsigned char>(_rawDataCapacity);
+    _arenaEnd = _arena->mark();
 
-    std::cout << "Created vertex buffer object with ID " << _bufferID << " and initial reserved size " << _rawData.capacity() << " bytes" << std::endl;
+    std::cout << "Created vertex buffer object with ID " << _bufferID << " and initial reserved size " << _rawDataCapacity << " bytes" << std::endl;
     _isBufferCreated = true;
 }
 
-//void VertexBufferObject::createVBO(uint32_t reserveSizeBytes)
-//{
-//}
-
 void VertexBufferObject::bindVBO(GLenum bufferType)
 {
     if (!_isBufferCreated)
@@ -36,37 +70,48 @@ void VertexBufferObject::bindVBO(GLenum bufferType)
     glBindBuffer(_bufferType, _bufferID);
 }
 
-//void VertexBufferObject::addRawData(const void* ptrData, uint32_t dataSizeBytes, int repeat)
-//{
-//}
-
 void VertexBufferObject::addRawData(const void* ptrData, size_t dataSize, int repeat)
 {
     const auto bytesToAdd = dataSize * repeat;
     const auto requiredCapacity = _bytesAdded + bytesToAdd;
-    if (requiredCapacity > _rawData.capacity())
+    if (requiredCapacity > _rawDataCapacity)
     {
-        auto newCapacity = _rawData.capacity() * 2;
+        auto newCapacity = _rawDataCapacity > 0 ? _rawDataCapacity * 2 : 1024;
         while (newCapacity < requiredCapacity) {
             newCapacity *= 2;
         }
 
-        std::vector<unsigned char> newRawData;
-        newRawData.reserve(newCapacity);
-        memcpy(newRawData.data(), _rawData.data(), _bytesAdded);
-        _rawData = std::move(newRawData);
+        if (_arena == nullptr) {
+            _arena = &Arena::threadArena();
+        }
+
+        // if nothing came after the data in the arena and its block has room, it grows in place; otherwise the new
+        // capacity is allocated first and the data copied over, the old copy goes with the data's arena mark
+        if (_rawData == nullptr || !_arena->growLast(_rawData, _rawDataCapacity, newCapacity))
+        {
+            if (_rawData == nullptr || _arena->mark() != _arenaEnd) {
+                _arenaMark = _arena->mark();
+            }
+            unsigned char* newRawData = _arena->allocateArray<unsigned char>(newCapacity);
+            if (_bytesAdded > 0) {
+                memcpy(newRawData, _rawData, _bytesAdded);
+            }
+            _rawData = newRawData;
+        }
+        _rawDataCapacity = newCapacity;
+        _arenaEnd = _arena->mark();
     }
 
     for (int i = 0; i < repeat; i++)
     {
-        memcpy(_rawData.data() + _bytesAdded, ptrData, dataSize);
+        memcpy(_rawData + _bytesAdded, ptrData, dataSize);
         _bytesAdded += dataSize;
     }
 }
 
 void* VertexBufferObject::getRawDataPointer()
 {
-    return _rawData.data();
+    return _rawData;
 }
 
 void VertexBufferObject::uploadDataToGPU(GLenum usageHint)
@@ -77,10 +122,11 @@ void VertexBufferObject::uploadDataToGPU(GLenum usageHint)
         return;
     }
 
-    glBufferData(_bufferType, _bytesAdded, _rawData.data(), usageHint);
+    trackedBufferData(_bufferType, _bytesAdded, _rawData, usageHint);
     _isDataUploaded = true;
     _uploadedDataSize = _bytesAdded;
     _bytesAdded = 0;
+    releaseRawData();
 }
 
 void* VertexBufferObject::mapBufferToMemory(GLenum usageHint) const
@@ -111,28 +157,139 @@ GLuint VertexBufferObject::getBufferID() const
     return _bufferID;
 }
 
-void* VertexBufferObject::mapBufferToMemory(GLenum usageHint)
+size_t VertexBufferObject::getBufferSize()
+{
+    return _isDataUploaded || _isStreaming ? _uploadedDataSize : _bytesAdded;
+}
+
+void VertexBufferObject::createStreamingVBO(GLenum bufferType, size_t frameSizeBytes, int frames, const char* site)
 {
-    return nullptr;
+    if (_isBufferCreated)
+    {
+        std::cerr << "This buffer is already created! You need to delete it before re-creating it!" << std::endl;
+        return;
+    }
+
+    _frameSizeBytes = (frameSizeBytes + STREAMING_ALIGNMENT - 1) / STREAMING_ALIGNMENT * STREAMING_ALIGNMENT;
+    _frameFences.assign(frames > 1 ? frames : 2, nullptr);
+    const size_t ringSize = _frameSizeBytes * _frameFences.size();
+    trackGenBuffers(1, &_bufferID, site != nullptr ? site : RESOURCE_SITE);
+    _bufferType = bufferType;
+    glBindBuffer(_bufferType, _bufferID);
+
+    // immutable storage can stay mapped while the GPU reads it; coherent, so writes need no flush
+    if (PFNGLBUFFERSTORAGEPROC storage = bufferStorage())
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        storage(_bufferType, ringSize, nullptr, flags);
+        trackBufferSize(_bufferType, ringSize);
+        _persistentData = static_cast<unsigned char*>(glMapBufferRange(_bufferType, 0, ringSize, flags));
+    }
+    if (_persistentData == nullptr) {
+        trackedBufferData(_bufferType, ringSize, nullptr, GL_STREAM_DRAW);
+    }
+
+    std::cout << "Created streaming vertex buffer object with ID " << _bufferID << " and " << _frameFences.size() << " x " << _frameSizeBytes
+        << " bytes" << (_persistentData != nullptr ? ", persistently mapped" : "") << std::endl;
+    _streamingFrame = (int)_frameFences.size() - 1;
+    _frameBytesUsed = _frameSizeBytes; // nothing can be allocated before beginStreamingFrame()
+    _uploadedDataSize = ringSize;
+    _isStreaming = true;
+    _isBufferCreated = true;
+}
+
+void VertexBufferObject::beginStreamingFrame()
+{
+    if (!_isStreaming)
+    {
+        std::cerr << "This buffer is not a streaming one! Call createStreamingVBO before streaming data!" << std::endl;
+        return;
+    }
+
+    flushStreamingData();
+    _streamingFrame = (_streamingFrame + 1) % (int)_frameFences.size();
+    _frameBytesUsed = 0;
+    GLsync& fence = _frameFences[_streamingFrame];
+    if (fence == nullptr) {
+        return;
+    }
+
+    if (_persistentData != nullptr) {
+        waitForFence(fence);
+    }
+    else if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        // the GPU still reads this region: rather than waiting for it, get fresh storage and let the driver
+        // release the old one once it is done
+        glBindBuffer(_bufferType, _bufferID);
+        trackedBufferData(_bufferType, _frameSizeBytes * _frameFences.size(), nullptr, GL_STREAM_DRAW);
+        for (GLsync& frameFence : _frameFences)
+        {
+            glDeleteSync(frameFence);
+            frameFence = nullptr;
+        }
+        return;
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
 }
 
-void* VertexBufferObject::mapSubBufferToMemory(GLenum usageHint, uint32_t offset, uint32_t length)
+void* VertexBufferObject::allocateStreamingData(size_t sizeBytes, size_t alignment, size_t& offset)
 {
-    return nullptr;
+    const size_t frameOffset = (_frameBytesUsed + alignment - 1) / alignment * alignment;
+    if (!_isStreaming || frameOffset + sizeBytes > _frameSizeBytes) {
+        return nullptr;
+    }
+
+    const size_t frameStart = _frameSizeBytes * _streamingFrame;
+    _frameBytesUsed = frameOffset + sizeBytes;
+    offset = frameStart + frameOffset;
+    if (_persistentData != nullptr) {
+        return _persistentData + offset;
+    }
+
+    // the rest of the region is mapped at once; the fence (or orphaning) already made sure the GPU is done with it
+    if (_mappedData == nullptr)
+    {
+        glBindBuffer(_bufferType, _bufferID);
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+        _mappedData = static_cast<unsigned char*>(glMapBufferRange(_bufferType, frameStart + frameOffset, _frameSizeBytes - frameOffset, flags));
+        _mappedFrom = frameOffset;
+        if (_mappedData == nullptr) {
+            return nullptr;
+        }
+    }
+    return _mappedData + (frameOffset - _mappedFrom);
 }
 
-void VertexBufferObject::unmapBuffer()
+void VertexBufferObject::flushStreamingData()
 {
+    if (_mappedData == nullptr) {
+        return;
+    }
+
+    glBindBuffer(_bufferType, _bufferID);
+    glUnmapBuffer(_bufferType);
+    _mappedData = nullptr;
 }
 
-GLuint VertexBufferObject::getBufferID()
+void VertexBufferObject::endStreamingFrame()
 {
-    return GLuint();
+    if (!_isStreaming) {
+        return;
+    }
+
+    flushStreamingData();
+    GLsync& fence = _frameFences[_streamingFrame];
+    if (fence != nullptr) {
+        glDeleteSync(fence);
+    }
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 }
 
-size_t VertexBufferObject::getBufferSize()
+bool VertexBufferObject::isPersistentlyMapped() const
 {
-    return _isDataUploaded ? _uploadedDataSize : _bytesAdded;
+    return _persistentData != nullptr;
 }
 
 void VertexBufferObject::deleteVBO()
@@ -142,7 +299,58 @@ void VertexBufferObject::deleteVBO()
     }
 
     std::cout << "Deleting vertex buffer object with ID " << _bufferID << "..." << std::endl;
-    glDeleteBuffers(1, &_bufferID);
+    trackedDeleteBuffers(1, &_bufferID); // unmaps it too
+    for (GLsync& fence : _frameFences)
+    {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+        }
+        fence = nullptr;
+    }
+    releaseRawData();
+    _bytesAdded = 0;
+    _persistentData = nullptr;
+    _mappedData = nullptr;
+    _isStreaming = false;
     _isDataUploaded = false;
     _isBufferCreated = false;
 }
+
+void VertexBufferObject::releaseRawData()
+{
+    // only the newest arena allocation can be released early, anything else goes with its ArenaScope
+    if (_rawData != nullptr && _arena->mark() == _arenaEnd) {
+        _arena->rewind(_arenaMark);
+    }
+    _rawData = nullptr;
+    _rawDataCapacity = 0;
+}
+bool testRawDataGrowth()
+{
+    Arena& arena = Arena::threadArena();
+    const size_t CHUNK_SIZE = 4096, CHUNKS = 8000; // ~32 MB, the first block of a thread's arena is 4 MB
+    std::vector<unsigned char> chunk(CHUNK_SIZE);
+    bool passed = true;
+
+    // twice: the second time runs in the block the first one's blocks were merged into
+    for (int pass = 0; pass < 2 && passed; pass++)
+    {
+        ArenaScope scope(arena);
+        arena.allocate(16); // the data does not start at the arena's beginning
+        const size_t blocksBefore = arena.blockAllocations();
+
+        VertexBufferObject vbo;
+        for (size_t i = 0; i < CHUNKS; i++)
+        {
+            memset(chunk.data(), (int)(i * 31 + pass), CHUNK_SIZE);
+            vbo.addRawData(chunk.data(), CHUNK_SIZE);
+        }
+        const unsigned char* data = static_cast<const unsigned char*>(vbo.getRawDataPointer());
+        for (size_t i = 0; i < CHUNKS * CHUNK_SIZE && passed; i++) {
+            passed = data[i] == (unsigned char)((i / CHUNK_SIZE) * 31 + pass);
+        }
+        std::cout << "VBO growth, pass " << pass + 1 << ": " << vbo.getBufferSize() << " bytes, "
+            << arena.blockAllocations() - blocksBefore << " arena blocks added, " << (passed ? "data intact" : "data CORRUPTED") << std::endl;
+    }
+    return passed;
+}
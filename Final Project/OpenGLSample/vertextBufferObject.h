@@ -1,21 +1,33 @@
 #pragma once
 
 // STL
+#include <cstring>
 #include <vector>
 
 #include <glad\glad.h>
 
+// Project
+#include "arena.h"
+
 /**
   Wraps OpenGL's vertex buffer object to a higher level class.
+  Besides static data gathered and uploaded once, a VBO can stream per-frame data (instance
+  matrices, text vertices, uniform blocks...): it is then a ring of regions (STREAMING_FRAMES by default), one
+  written per frame while the GPU may still read the ones before, each guarded by a fence sync.
+  With ARB_buffer_storage the ring is mapped once, persistently and coherently; without it, every
+  frame's region is mapped unsynchronised and the storage is orphaned if the GPU is behind.
 */
 
 class VertexBufferObject
 {
 public:
 	/** \brief Creates a new VBO, with optional reserved buffer size.
-	*   \param size Buffer size reservation, in bytes (so that memory allocations don't take place while adding data)
+	*   Data is gathered in the calling thread's arena until it is uploaded. Uploading releases it if nothing was
+	*   allocated from the arena since, otherwise it goes with the ArenaScope the mesh is built in.
+	*   \param size Buffer size reservation, in bytes (the exact size, so that nothing moves while adding data)
+	*   \param site Call site the buffer is tracked under (RESOURCE_SITE of the owner), this file if not given
 	*/
-	void createVBO(uint32_t reserveSizeBytes = 0);
+	void createVBO(size_t reserveSizeBytes = 0, const char* site = nullptr);
 
 	/** \brief Binds this vertex buffer object (makes current).
 	*   \param bufferType Type of the bound buffer (usually GL_ARRAY_BUFFER, but can be also GL_ELEMENT_BUFFER for instance)
@@ -27,7 +39,7 @@ public:
 	*   \param dataSize Size of the added data (in bytes)
 	*   \param repeat How many times to repeat same data in the buffer (default is 1)
 	*/
-	void addRawData(const void* ptrData, uint32_t dataSizeBytes, int repeat = 1);
+	void addRawData(const void* ptrData, size_t dataSize, int repeat = 1);
 
 	/** \brief Adds arbitrary data to the in-memory buffer, before they get uploaded.
 	*   \param ptrData Data to be added
@@ -53,7 +65,7 @@ public:
 	*   \param usageHint Hint for OpenGL, how is the data intended to be used (GL_STATIC_DRAW, GL_DYNAMIC_DRAW)
 	*   \return Pointer to the mapped data, or nullptr, if something fails.
 	*/
-	void* mapBufferToMemory(GLenum usageHint);
+	void* mapBufferToMemory(GLenum usageHint) const;
 
 	/** \brief Maps buffer sub-data to a memory pointer.
 	*   \param  usageHint Hint for OpenGL, how is the data intended to be used (GL_READ_ONLY, GL_WRITE_ONLY...`)
@@ -61,20 +73,69 @@ public:
 	*   \param  length    Byte length of the mapped data
 	*   \return Pointer to the mapped data, or nullptr, if something fails.
 	*/
-	void* mapSubBufferToMemory(GLenum usageHint, uint32_t offset, uint32_t length);
+	void* mapSubBufferToMemory(GLenum usageHint, size_t offset, size_t length) const;
 
 	//* \brief Unmaps buffer (must have been mapped previously).
-	void unmapBuffer();
+	void unmapBuffer() const;
 
 	/** \brief Gets OpenGL-assigned buffer ID.
 	*   \return Buffer ID.
 	*/
-	GLuint getBufferID();
+	GLuint getBufferID() const;
 
 	/** \brief Gets buffer size, in bytes.
 	*   \return Buffer size in bytes.
 	*/
-	uint32_t getBufferSize();
+	size_t getBufferSize();
+
+	/** \brief Creates a new VBO for streaming per-frame data, see beginStreamingFrame().
+	*   \param bufferType     Type of the buffer (GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER...)
+	*   \param frameSizeBytes Most data one frame streams, in bytes (rounded up to STREAMING_ALIGNMENT)
+	*   \param frames         Regions of the ring, one more than the frames the GPU may be behind, or writing a region waits
+	*   \param site           Call site the buffer is tracked under (RESOURCE_SITE of the owner), this file if not given
+	*/
+	void createStreamingVBO(GLenum bufferType, size_t frameSizeBytes, int frames = STREAMING_FRAMES, const char* site = nullptr);
+
+	//* \brief Starts a frame of streamed data, waits if the GPU still reads the region the frame reuses. Binds the buffer.
+	void beginStreamingFrame();
+
+	/** \brief Sub-allocates streamed data for the current frame.
+	*   \param sizeBytes Size of the data, in bytes
+	*   \param alignment Alignment of the data in the buffer, in bytes (e.g. GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT)
+	*   \param offset    Set to the byte offset of the data in the buffer, to bind or draw from
+	*   \return Pointer to write the data to, valid until flushStreamingData(); nullptr if the frame's region is full.
+	*/
+	void* allocateStreamingData(size_t sizeBytes, size_t alignment, size_t& offset);
+
+	/** \brief Allocates streamed data for the current frame and copies it in.
+	*   \param obj    Data to be streamed
+	*   \param offset Set to the byte offset of the data in the buffer
+	*   \return True on success, false if the frame's region is full.
+	*/
+	template<typename T>
+	bool addStreamingData(const T& obj, size_t& offset)
+	{
+		void* destination = allocateStreamingData(sizeof(T), alignof(T), offset);
+		if (destination == nullptr) {
+			return false;
+		}
+		memcpy(destination, &obj, sizeof(T));
+		return true;
+	}
+
+	//* \brief Makes the data allocated so far usable by the GPU; call it before drawing from them. Binds the buffer.
+	void flushStreamingData();
+
+	//* \brief Ends a frame of streamed data, after the last draw that reads them.
+	void endStreamingFrame();
+
+	/** \brief Gets whether the streaming ring is persistently mapped (ARB_buffer_storage).
+	*   \return True if it is, false if frames are mapped one by one.
+	*/
+	bool isPersistentlyMapped() const;
+
+	static const int STREAMING_FRAMES = 3; //!< Default regions of the streaming ring, for two frames in flight
+	static const size_t STREAMING_ALIGNMENT = 256; //!< Every region starts at a multiple of this, as large as any offset alignment GL asks for
 
 	//* \brief Deletes VBO and frees memory and internal structures.
 	void deleteVBO();
@@ -83,10 +144,30 @@ private:
 	GLuint _bufferID = 0; //! OpenGL assigned buffer ID
 	int _bufferType; //! Buffer type (GL_ARRAY_BUFFER, GL_ELEMENT_BUFFER...)
 
-	std::vector<unsigned char> _rawData; //! In-memory raw data buffer, used to gather the data for VBO.
+	void releaseRawData();
+
+	Arena* _arena = nullptr; //! Arena the in-memory data comes from
+	unsigned char* _rawData = nullptr; //! In-memory raw data buffer, used to gather the data for VBO.
+	size_t _rawDataCapacity = 0; //! Size of _rawData, in bytes
+	size_t _arenaMark = 0; //! Arena position before _rawData
+	size_t _arenaEnd = 0; //! Arena position right after _rawData
 	size_t _bytesAdded = 0; //! Number of bytes added to the buffer so far
-	uint32_t _uploadedDataSize; //! Holds buffer data size after uploading to GPU
+	size_t _uploadedDataSize = 0; //! Holds buffer data size after uploading to GPU
 
 	bool _isBufferCreated = false;
 	bool _isDataUploaded = false; //! Flag telling, if data has been uploaded to GPU already.
-};
\ No newline at end of file
+
+	bool _isStreaming = false; //! Flag telling, if the buffer is a streaming ring
+	size_t _frameSizeBytes = 0; //! Size of one region of the ring
+	int _streamingFrame = 0; //! Region the current frame writes to
+	size_t _frameBytesUsed = 0; //! Bytes allocated in the current region so far
+	unsigned char* _persistentData = nullptr; //! The whole ring, while persistently mapped
+	unsigned char* _mappedData = nullptr; //! Mapped part of the current region, starting at _mappedFrom
+	size_t _mappedFrom = 0; //! Offset of _mappedData in the current region
+	std::vector<GLsync> _frameFences; //! Per region, signalled once the GPU is done with it
+};
+/** \brief Checks that data gathered in a VBO survives growing across arena blocks: fills buffers far past the first block
+*   of the thread's arena, so they move to new blocks several times, and compares every byte. Prints the outcome.
+*   \return True if every byte came through.
+*/
+bool testRawDataGrowth();